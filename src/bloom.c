@@ -0,0 +1,147 @@
+/**
+ * @file bloom.c
+ * @brief Bloom filter over read IDs used to quickly reject read IDs that are not in a SLOW5/BLOW5 file
+ * @date 18/10/2026
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <sys/stat.h>
+#include "bloom.h"
+#include "idx_utils.h"
+#include "error.h"
+
+extern int slow5tools_verbosity_level;
+
+// FNV-1a followed by the splitmix64 finaliser for a well mixed 64-bit hash
+static inline uint64_t bloom_hash(const char *key, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t) key[i];
+        h *= 0x100000001b3ULL;
+    }
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
+
+std::string bloom_get_path(const char *slow5_path) {
+    return idx_get_path(slow5_path) + BLOOM_EXT;
+}
+
+// return 1 if the bloom filter exists and is not older than the slow5 file, 0 otherwise
+int bloom_is_fresh(const char *slow5_path) {
+    struct stat st_slow5;
+    struct stat st_bloom;
+    std::string path = bloom_get_path(slow5_path);
+    if (stat(slow5_path, &st_slow5) != 0 || stat(path.c_str(), &st_bloom) != 0) {
+        return 0;
+    }
+    return st_bloom.st_mtime >= st_slow5.st_mtime ? 1 : 0;
+}
+
+// size the filter for num_items keys at the given false positive rate
+bloom_t *bloom_init(uint64_t num_items, double fp_rate) {
+    bloom_t *bloom = (bloom_t *) malloc(sizeof *bloom);
+    MALLOC_CHK(bloom);
+    uint64_t n = num_items > 0 ? num_items : 1;
+    double bits = -(double) n * log(fp_rate) / (M_LN2 * M_LN2);
+    bloom->num_bits = ((uint64_t) ceil(bits) + 63) / 64 * 64;
+    bloom->num_hashes = (uint32_t) round((double) bloom->num_bits / n * M_LN2);
+    if (bloom->num_hashes == 0) {
+        bloom->num_hashes = 1;
+    }
+    bloom->num_items = 0;
+    bloom->bits = (uint64_t *) calloc(bloom->num_bits / 64, sizeof(uint64_t));
+    MALLOC_CHK(bloom->bits);
+    return bloom;
+}
+
+// the k bit positions are derived from two halves of a single hash (Kirsch-Mitzenmacher)
+void bloom_add(bloom_t *bloom, const char *key, size_t len) {
+    uint64_t h = bloom_hash(key, len);
+    uint64_t h1 = h & 0xffffffffULL;
+    uint64_t h2 = (h >> 32) | 1;
+    for (uint32_t i = 0; i < bloom->num_hashes; i++) {
+        uint64_t bit = (h1 + i * h2) % bloom->num_bits;
+        bloom->bits[bit / 64] |= 1ULL << (bit % 64);
+    }
+    bloom->num_items++;
+}
+
+// return 0 if key is definitely not in the set, 1 if it may be
+int bloom_check(const bloom_t *bloom, const char *key, size_t len) {
+    uint64_t h = bloom_hash(key, len);
+    uint64_t h1 = h & 0xffffffffULL;
+    uint64_t h2 = (h >> 32) | 1;
+    for (uint32_t i = 0; i < bloom->num_hashes; i++) {
+        uint64_t bit = (h1 + i * h2) % bloom->num_bits;
+        if (!(bloom->bits[bit / 64] & (1ULL << (bit % 64)))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int bloom_write(const bloom_t *bloom, const char *path) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        ERROR("Bloom filter file %s could not be opened - %s.", path, strerror(errno));
+        return -1;
+    }
+    const char magic[] = BLOOM_MAGIC;
+    fwrite(magic, 1, sizeof magic, fp);
+    fwrite(&bloom->num_bits, sizeof bloom->num_bits, 1, fp);
+    fwrite(&bloom->num_hashes, sizeof bloom->num_hashes, 1, fp);
+    fwrite(&bloom->num_items, sizeof bloom->num_items, 1, fp);
+    fwrite(bloom->bits, sizeof(uint64_t), bloom->num_bits / 64, fp);
+    if (ferror(fp) || fclose(fp) != 0) {
+        ERROR("Could not write the bloom filter file %s.", path);
+        return -1;
+    }
+    return 0;
+}
+
+bloom_t *bloom_load(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return NULL;
+    }
+    const char magic[] = BLOOM_MAGIC;
+    char buf[sizeof magic];
+    bloom_t *bloom = (bloom_t *) malloc(sizeof *bloom);
+    MALLOC_CHK(bloom);
+    bloom->bits = NULL;
+    if (fread(buf, 1, sizeof buf, fp) != sizeof buf || memcmp(buf, magic, sizeof magic) != 0 ||
+        fread(&bloom->num_bits, sizeof bloom->num_bits, 1, fp) != 1 ||
+        fread(&bloom->num_hashes, sizeof bloom->num_hashes, 1, fp) != 1 ||
+        fread(&bloom->num_items, sizeof bloom->num_items, 1, fp) != 1 ||
+        bloom->num_bits == 0 || bloom->num_bits % 64 != 0 || bloom->num_hashes == 0) {
+        goto malformed;
+    }
+    bloom->bits = (uint64_t *) malloc(bloom->num_bits / 8);
+    MALLOC_CHK(bloom->bits);
+    if (fread(bloom->bits, sizeof(uint64_t), bloom->num_bits / 64, fp) != bloom->num_bits / 64) {
+        goto malformed;
+    }
+    fclose(fp);
+    return bloom;
+
+malformed:
+    WARNING("Bloom filter file %s is malformed and will be ignored. Recreate it using slow5tools index --bloom.", path);
+    fclose(fp);
+    bloom_free(bloom);
+    return NULL;
+}
+
+void bloom_free(bloom_t *bloom) {
+    if (bloom) {
+        free(bloom->bits);
+        free(bloom);
+    }
+}
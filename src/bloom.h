@@ -0,0 +1,30 @@
+// Bloom filter over read IDs used to quickly reject read IDs that are not in a SLOW5/BLOW5 file
+
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+#define BLOOM_MAGIC { 'S', 'L', 'O', 'W', '5', 'B', 'L', 'M', '\1' }
+#define BLOOM_EXT ".bloom"
+#define BLOOM_DEFAULT_FP_RATE (0.01)
+
+typedef struct {
+    uint64_t num_bits;
+    uint32_t num_hashes;
+    uint64_t num_items;
+    uint64_t *bits;
+} bloom_t;
+
+std::string bloom_get_path(const char *slow5_path);
+int bloom_is_fresh(const char *slow5_path);
+bloom_t *bloom_init(uint64_t num_items, double fp_rate);
+void bloom_add(bloom_t *bloom, const char *key, size_t len);
+int bloom_check(const bloom_t *bloom, const char *key, size_t len);
+int bloom_write(const bloom_t *bloom, const char *path);
+bloom_t *bloom_load(const char *path);
+void bloom_free(bloom_t *bloom);
+
+#endif
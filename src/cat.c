@@ -7,12 +7,16 @@
 
 #include <getopt.h>
 #include <sys/wait.h>
+#include <fcntl.h>
 #include <string>
+#include <unordered_set>
 #include "error.h"
 #include "cmd.h"
 #include "slow5_extra.h"
 #include "read_fast5.h"
 #include "misc.h"
+#include "thread.h"
+#include "idx_utils.h"
 #include <slow5/slow5_press.h>
 
 #define USAGE_MSG "Usage: %s [SLOW5_FILE/DIR]\n"
@@ -22,10 +26,70 @@
     "\n" \
     "OPTIONS:\n"       \
     HELP_MSG_OUTPUT_FILE \
+    "        --index                   also write the index of the output file by merging the indexes of the input files\n" \
+    HELP_MSG_THREADS \
+
+#define CAT_OPEN_WINDOW 256 // input files opened at once to check their headers
 
 extern int slow5tools_verbosity_level;
 int close_files_and_exit(slow5_file_t *slow5_file, slow5_file_t *slow5_file_i, char *arg_fname_out);
 
+// the records of an input file and where they go in the output
+typedef struct {
+    off_t records_start;
+    off_t records_end;
+    off_t dest;
+} cat_span_t;
+
+typedef struct {
+    const std::vector<std::string> *files;
+    size_t start;
+    const std::vector<cat_span_t> *spans;
+    std::vector<int> ret;
+    int fd_out;
+} cat_param_t;
+
+static void cat_open_file(core_t *core, db_t *db, int32_t i) {
+    cat_param_t *param = (cat_param_t *) core->param;
+    db->slow5_file_pointers[i] = slow5_open((*param->files)[param->start + i].c_str(), "r");
+}
+
+static void cat_copy_file(core_t *core, db_t *db, int32_t i) {
+    cat_param_t *param = (cat_param_t *) core->param;
+    const char *path = (*param->files)[i].c_str();
+    const cat_span_t *span = &(*param->spans)[i];
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        ERROR("File '%s' could not be opened - %s.", path, strerror(errno));
+        param->ret[i] = -1;
+        return;
+    }
+    if (copy_range(fd, span->records_start, param->fd_out, span->dest, span->records_end - span->records_start) < 0) {
+        ERROR("Could not copy the records of %s - %s.", path, strerror(errno));
+        param->ret[i] = -1;
+    }
+    close(fd);
+}
+
+// whether out can be written at an offset: not a pipe, nor a file opened for appending (stdout redirected with >>)
+static int cat_positional(FILE *out) {
+    int flags = fcntl(fileno(out), F_GETFL);
+    return ftello(out) >= 0 && flags >= 0 && !(flags & O_APPEND);
+}
+
+// copy len bytes at offset of the input file descriptor to the end of out, without going through stdio
+// copy_file_range is used for an output file and sendfile for a pipe such as stdout
+static int cat_copy(int fd_in, off_t offset, FILE *out, off_t len) {
+    off_t out_start = ftello(out);
+    if (!cat_positional(out)) {
+        return copy_stream(fd_in, offset, fileno(out), len);
+    }
+    if (copy_range(fd_in, offset, fileno(out), out_start, len) < 0) {
+        return -1;
+    }
+    return fseeko(out, out_start + len, SEEK_SET);
+}
+
 // return 0 if no warnings
 // return 1 if warnings are found
 int compare_headers(slow5_hdr_t *output_header, slow5_hdr_t *input_header, int64_t output_g, int64_t input_g, const char *i_file_path, const char *j_run_id) {
@@ -121,6 +185,8 @@ int cat_main(int argc, char **argv, struct program_meta *meta){
     static struct option long_opts[] = {
             {"help", no_argument, NULL, 'h' }, //0
             {"output", required_argument, NULL, 'o'}, //1
+            {"index", no_argument, NULL, 0}, //2
+            {"threads", required_argument, NULL, 't'}, //3
             {NULL, 0, NULL, 0 }
     };
 
@@ -136,13 +202,23 @@ int cat_main(int argc, char **argv, struct program_meta *meta){
     int opt;
 
     // Parse options
-    while ((opt = getopt_long(argc, argv, "ho:", long_opts, &longindex)) != -1) {
+    while ((opt = getopt_long(argc, argv, "ho:t:", long_opts, &longindex)) != -1) {
         DEBUG("opt='%c', optarg=\"%s\", optind=%d, opterr=%d, optopt='%c'",
                   opt, optarg, optind, opterr, optopt);
         switch (opt) {
             case 'o':
                 user_opts.arg_fname_out = optarg;
                 break;
+            case 't':
+                user_opts.arg_num_threads = optarg;
+                break;
+            case 0  :
+                switch (longindex) {
+                    case 2:
+                        user_opts.flag_index = 1;
+                        break;
+                }
+                break;
             case 'h':
                 DEBUG("displaying large help message%s","");
                 fprintf(stdout, HELP_LARGE_MSG, argv[0]);
@@ -154,10 +230,19 @@ int cat_main(int argc, char **argv, struct program_meta *meta){
                 return EXIT_FAILURE;
         }
     }
+    if(parse_num_threads(&user_opts,argc,argv,meta) < 0){
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
     if(auto_detect_formats(&user_opts) < 0){
         EXIT_MSG(EXIT_FAILURE, argv, meta);
         return EXIT_FAILURE;
     }
+    if (user_opts.flag_index && user_opts.arg_fname_out == NULL) {
+        ERROR("--index requires an output file (-o)%s", "");
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
 
     // Check for remaining files to parse
     if (optind >= argc) {
@@ -201,13 +286,34 @@ int cat_main(int argc, char **argv, struct program_meta *meta){
 
     WARNING("%s","slow5tools cat is much faster than merge, but performs minimal input validation. Use with caution.");
 
+    // the inputs are opened and their headers parsed by a pool of threads a window at a time, then checked in order
+    // against the first one. When the output can be written at an offset, the place of every input in the output is
+    // known from the sizes of their records, so all of them are copied in parallel once they are checked
     slow5_file_t* slow5File = NULL;
     int first_iteration = 1;
     uint32_t num_read_groups = 1;
     std::vector<std::string> run_ids;
+    std::vector<idx_rec_t> idx_entries;
+    std::unordered_set<std::string> idx_read_ids;
     size_t num_files = slow5_files.size();
+    std::vector<cat_span_t> spans;
+    off_t out_offset = -1;
+    int flag_parallel = 0;
+    cat_param_t param;
+    param.files = &slow5_files;
+    core_t core;
+    core.num_thread = user_opts.num_threads;
+    core.param = &param;
+    db_t db = { 0 };
+    db.slow5_file_pointers = (slow5_file_t **) malloc(CAT_OPEN_WINDOW * sizeof *db.slow5_file_pointers);
+    MALLOC_CHK(db.slow5_file_pointers);
     for(size_t i=0; i<num_files; i++) { //iterate over slow5files
-        slow5_file_t *slow5File_i = slow5_open(slow5_files[i].c_str(), "r");
+        if (i % CAT_OPEN_WINDOW == 0) {
+            param.start = i;
+            db.n_batch = num_files - i < CAT_OPEN_WINDOW ? num_files - i : CAT_OPEN_WINDOW;
+            work_db(&core, &db, cat_open_file);
+        }
+        slow5_file_t *slow5File_i = db.slow5_file_pointers[i % CAT_OPEN_WINDOW];
         if (!slow5File_i) {
             ERROR("[Skip file]: cannot open %s. skipping...\n", slow5_files[i].c_str());
             return close_files_and_exit(slow5File, slow5File_i, user_opts.arg_fname_out);
@@ -284,6 +390,8 @@ int cat_main(int argc, char **argv, struct program_meta *meta){
                 ERROR("Could not write the header to %s\n", user_opts.arg_fname_out);
                 return close_files_and_exit(slow5File, slow5File_i, user_opts.arg_fname_out);
             }
+            out_offset = ftello(slow5File->fp);
+            flag_parallel = cat_positional(slow5File->fp);
             first_iteration = 0;
         }else {
             if (lossy == 0 && slow5File_i->header->aux_meta == NULL) {
@@ -343,19 +451,88 @@ int cat_main(int argc, char **argv, struct program_meta *meta){
         }
 
         //writing to reads to the output
-        // BUFSIZE default is 8192 bytes
-        // BUFSIZE of 1 means one chareter at time
-        // good values should fit to blocksize, like 1024 or 4096
-        // higher values reduce number of system calls
-        char buf[BUFSIZ];
-        size_t size;
-        while ((size = fread(buf, 1, BUFSIZ, slow5File_i->fp))) {
-            fwrite(buf, 1, size, slow5File->fp);
+        if (user_opts.flag_index) {
+            // the records of this file start at in_start and are copied to out_start of the output, so its index
+            // entries only have to be shifted. Files without an up-to-date index are indexed here
+            off_t in_start = ftello(slow5File_i->fp);
+            off_t out_start = out_offset;
+            std::vector<idx_rec_t> entries;
+            int ret;
+            if (idx_is_fresh(slow5_files[i].c_str())) {
+                ret = idx_read(idx_get_path(slow5_files[i].c_str()).c_str(), entries, NULL);
+            } else {
+                VERBOSE("No up-to-date index for %s, indexing it", slow5_files[i].c_str());
+                ret = idx_build(slow5File_i, user_opts.num_threads, user_opts.read_id_batch_capacity, entries);
+                if (ret == 0 && fseeko(slow5File_i->fp, in_start, SEEK_SET) != 0) {
+                    ERROR("Could not seek in %s", slow5_files[i].c_str());
+                    ret = -1;
+                }
+            }
+            if (ret < 0) {
+                idx_entries_free(entries);
+                idx_entries_free(idx_entries);
+                return close_files_and_exit(slow5File, slow5File_i, user_opts.arg_fname_out);
+            }
+            for (size_t k = 0; k < entries.size(); k++) {
+                if (!idx_read_ids.insert(entries[k].read_id).second) {
+                    ERROR("Duplicate read id '%s' found in %s. The output cannot be indexed.", entries[k].read_id, slow5_files[i].c_str());
+                    idx_entries_free(entries);
+                    idx_entries_free(idx_entries);
+                    return close_files_and_exit(slow5File, slow5File_i, user_opts.arg_fname_out);
+                }
+                entries[k].offset = entries[k].offset - in_start + out_start;
+                idx_entries.push_back(entries[k]);
+            }
+        }
+
+        // only the records are copied, leaving the end of file marker of the input behind
+        off_t records_start = ftello(slow5File_i->fp);
+        struct stat st;
+        if (fstat(fileno(slow5File_i->fp), &st) != 0) {
+            ERROR("Could not stat %s - %s.", slow5_files[i].c_str(), strerror(errno));
+            idx_entries_free(idx_entries);
+            return close_files_and_exit(slow5File, slow5File_i, user_opts.arg_fname_out);
+        }
+        const char eof[] = SLOW5_BINARY_EOF;
+        off_t records_end = st.st_size - (format_out == SLOW5_FORMAT_BINARY ? sizeof eof : 0);
+        cat_span_t span = { records_start, records_end, out_offset };
+        if (flag_parallel) {
+            spans.push_back(span);
+        } else if (fflush(slow5File->fp) == EOF || cat_copy(fileno(slow5File_i->fp), records_start, slow5File->fp, records_end - records_start) < 0) {
+            ERROR("Could not copy the records of %s - %s.", slow5_files[i].c_str(), strerror(errno));
+            idx_entries_free(idx_entries);
+            return close_files_and_exit(slow5File, slow5File_i, user_opts.arg_fname_out);
         }
+        out_offset += records_end - records_start;
         slow5_close(slow5File_i);
+    }
+    free(db.slow5_file_pointers);
 
-        if(format_out==SLOW5_FORMAT_BINARY){
-            fseek(slow5File->fp, -5, SEEK_END); //slow5 EOF file "5WOLB"
+    if (flag_parallel) {
+        if (fflush(slow5File->fp) == EOF) {
+            ERROR("Could not write to %s - %s.", user_opts.arg_fname_out ? user_opts.arg_fname_out : "stdout", strerror(errno));
+            idx_entries_free(idx_entries);
+            return close_files_and_exit(slow5File, NULL, user_opts.arg_fname_out);
+        }
+        param.spans = &spans;
+        param.ret.assign(num_files, 0);
+        param.fd_out = fileno(slow5File->fp);
+#ifdef __linux__
+        // reserve the space of all the records at once; the copies work without it if the filesystem cannot
+        off_t records_start = spans.empty() ? out_offset : spans[0].dest;
+        if (out_offset > records_start && fallocate(param.fd_out, 0, records_start, out_offset - records_start) != 0) {
+            DEBUG("fallocate failed - %s", strerror(errno));
+        }
+#endif
+        db.n_batch = num_files;
+        work_db(&core, &db, cat_copy_file);
+        int ret = 0;
+        for (size_t i = 0; i < num_files; i++) {
+            ret |= param.ret[i];
+        }
+        if (ret < 0 || fseeko(slow5File->fp, out_offset, SEEK_SET) != 0) {
+            idx_entries_free(idx_entries);
+            return close_files_and_exit(slow5File, NULL, user_opts.arg_fname_out);
         }
     }
 
@@ -364,6 +541,10 @@ int cat_main(int argc, char **argv, struct program_meta *meta){
     }
     slow5_close(slow5File);
 
+    if (user_opts.flag_index && idx_finish(user_opts.arg_fname_out, idx_entries) < 0) {
+        return EXIT_FAILURE;
+    }
+
     return EXIT_SUCCESS;
 }
 
@@ -0,0 +1,483 @@
+/**
+ * @file catalog.c
+ * @brief multi-file catalog index that maps read IDs to records in many SLOW5/BLOW5 files
+ * @date 18/10/2026
+ */
+#include <sys/stat.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <algorithm>
+#include "catalog.h"
+#include "idx_utils.h"
+#include "thread.h"
+#include "error.h"
+#include "slow5_extra.h"
+
+extern int slow5tools_verbosity_level;
+
+typedef struct {
+    const std::vector<std::string> *files;
+    std::vector<std::vector<idx_rec_t>> entries;
+    std::vector<std::vector<std::string>> run_ids;
+    std::vector<std::vector<std::string>> aux_attrs;
+    std::vector<int> lossy;
+    std::vector<struct stat> stats;
+    std::vector<int> failed;
+} catalog_build_t;
+
+// collect the run_ids, auxiliary fields and index entries of the ith file
+static void catalog_index_file(core_t *core, db_t *db, int32_t i) {
+    catalog_build_t *build = (catalog_build_t *) core->param;
+    const char *path = (*build->files)[i].c_str();
+
+    slow5_file_t *slow5_file = slow5_open(path, "r");
+    if (!slow5_file) {
+        ERROR("File '%s' could not be opened - %s.", path, strerror(errno));
+        build->failed[i] = 1;
+        return;
+    }
+    if (fstat(fileno(slow5_file->fp), &build->stats[i]) != 0) {
+        ERROR("Could not stat file %s - %s.", path, strerror(errno));
+        build->failed[i] = 1;
+        slow5_close(slow5_file);
+        return;
+    }
+    for (uint32_t j = 0; j < slow5_file->header->num_read_groups; j++) {
+        char *run_id = slow5_hdr_get("run_id", j, slow5_file->header);
+        if (!run_id) {
+            ERROR("No run_id information found in %s.", path);
+            build->failed[i] = 1;
+            slow5_close(slow5_file);
+            return;
+        }
+        build->run_ids[i].push_back(std::string(run_id));
+    }
+    slow5_aux_meta_t *aux_meta = slow5_file->header->aux_meta;
+    build->lossy[i] = (aux_meta == NULL) ? 1 : 0;
+    if (aux_meta) {
+        for (uint32_t r = 0; r < aux_meta->num; r++) {
+            build->aux_attrs[i].push_back(std::string(aux_meta->attrs[r]) + "\t" + std::to_string(aux_meta->types[r]));
+        }
+    }
+
+    int ret;
+    if (idx_is_fresh(path)) {
+        ret = idx_read(idx_get_path(path).c_str(), build->entries[i], NULL);
+    } else {
+        ret = idx_scan(slow5_file, build->entries[i]);
+    }
+    if (ret < 0) {
+        build->failed[i] = 1;
+    }
+    slow5_close(slow5_file);
+}
+
+// index all the given files (one file per thread) and combine them into a single catalog
+int catalog_build(const std::vector<std::string> &slow5_files, int32_t num_threads, catalog_t *catalog) {
+    size_t num_files = slow5_files.size();
+
+    catalog_build_t build;
+    build.files = &slow5_files;
+    build.entries.resize(num_files);
+    build.run_ids.resize(num_files);
+    build.aux_attrs.resize(num_files);
+    build.lossy.resize(num_files, 0);
+    build.stats.resize(num_files);
+    build.failed.resize(num_files, 0);
+
+    core_t core;
+    core.num_thread = (num_threads > (int32_t) num_files) ? (int32_t) num_files : num_threads;
+    core.param = &build;
+    db_t db = { 0 };
+    db.n_batch = num_files;
+    work_db(&core, &db, catalog_index_file);
+
+    int ret = 0;
+    for (size_t i = 0; i < num_files; i++) {
+        if (build.failed[i]) {
+            ret = -1;
+            continue;
+        }
+        if (build.lossy[i] != build.lossy[0] || build.aux_attrs[i] != build.aux_attrs[0]) {
+            ERROR("%s has different auxiliary fields from %s. Files in a catalog must have the same auxiliary fields.", slow5_files[i].c_str(), slow5_files[0].c_str());
+            ret = -1;
+            continue;
+        }
+        char *abs_path = realpath(slow5_files[i].c_str(), NULL);
+        if (!abs_path) {
+            ERROR("Could not resolve the path of %s - %s.", slow5_files[i].c_str(), strerror(errno));
+            ret = -1;
+            continue;
+        }
+        uint32_t file_id = catalog->files.size();
+        catalog->files.push_back(std::string(abs_path));
+        catalog->file_sizes.push_back(build.stats[i].st_size);
+        catalog->file_mtimes.push_back(build.stats[i].st_mtime);
+        catalog->run_ids.push_back(build.run_ids[i]);
+        free(abs_path);
+
+        for (size_t k = 0; k < build.entries[i].size(); k++) {
+            const idx_rec_t &entry = build.entries[i][k];
+            catalog_rec_t rec = {file_id, entry.offset, entry.size};
+            if (!catalog->recs.emplace(std::string(entry.read_id), rec).second) {
+                uint32_t prev_file_id = catalog->recs[std::string(entry.read_id)].file_id;
+                ERROR("Duplicate read id '%s' found in %s and %s.", entry.read_id, catalog->files[prev_file_id].c_str(), slow5_files[i].c_str());
+                ret = -1;
+                break;
+            }
+        }
+        idx_entries_free(build.entries[i]);
+    }
+    for (size_t i = 0; i < num_files; i++) {
+        idx_entries_free(build.entries[i]);
+    }
+    return ret;
+}
+
+int catalog_write(const char *path, const catalog_t *catalog) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        ERROR("Catalog file %s could not be opened - %s.", path, strerror(errno));
+        return -1;
+    }
+
+    const char magic[] = SLOW5_CAT_MAGIC;
+    fwrite(magic, 1, sizeof magic, fp);
+    uint32_t num_files = catalog->files.size();
+    fwrite(&num_files, sizeof num_files, 1, fp);
+    for (uint32_t i = 0; i < num_files; i++) {
+        uint32_t path_len = catalog->files[i].size();
+        fwrite(&path_len, sizeof path_len, 1, fp);
+        fwrite(catalog->files[i].c_str(), 1, path_len, fp);
+        fwrite(&catalog->file_sizes[i], sizeof catalog->file_sizes[i], 1, fp);
+        fwrite(&catalog->file_mtimes[i], sizeof catalog->file_mtimes[i], 1, fp);
+        uint32_t num_read_groups = catalog->run_ids[i].size();
+        fwrite(&num_read_groups, sizeof num_read_groups, 1, fp);
+        for (uint32_t j = 0; j < num_read_groups; j++) {
+            uint16_t run_id_len = catalog->run_ids[i][j].size();
+            fwrite(&run_id_len, sizeof run_id_len, 1, fp);
+            fwrite(catalog->run_ids[i][j].c_str(), 1, run_id_len, fp);
+        }
+    }
+
+    // records are written in file and offset order so that the output is deterministic
+    std::vector<const std::pair<const std::string, catalog_rec_t> *> recs;
+    recs.reserve(catalog->recs.size());
+    for (const auto &rec : catalog->recs) {
+        recs.push_back(&rec);
+    }
+    std::sort(recs.begin(), recs.end(), [](const std::pair<const std::string, catalog_rec_t> *a, const std::pair<const std::string, catalog_rec_t> *b) {
+        return a->second.file_id != b->second.file_id ? a->second.file_id < b->second.file_id : a->second.offset < b->second.offset;
+    });
+
+    uint64_t num_recs = recs.size();
+    fwrite(&num_recs, sizeof num_recs, 1, fp);
+    for (uint64_t i = 0; i < num_recs; i++) {
+        slow5_rid_len_t read_id_len = recs[i]->first.size();
+        fwrite(&read_id_len, sizeof read_id_len, 1, fp);
+        fwrite(recs[i]->first.c_str(), 1, read_id_len, fp);
+        fwrite(&recs[i]->second.file_id, sizeof recs[i]->second.file_id, 1, fp);
+        fwrite(&recs[i]->second.offset, sizeof recs[i]->second.offset, 1, fp);
+        fwrite(&recs[i]->second.size, sizeof recs[i]->second.size, 1, fp);
+    }
+    const char eof[] = SLOW5_CAT_EOF;
+    fwrite(eof, 1, sizeof eof, fp);
+
+    if (ferror(fp) || fclose(fp) != 0) {
+        ERROR("Could not write the catalog file %s.", path);
+        return -1;
+    }
+    return 0;
+}
+
+#define CAT_READ(dst, len) { \
+    if (pos + (len) > end) goto malformed; \
+    memcpy((dst), buf + pos, (len)); \
+    pos += (len); \
+}
+
+int catalog_load(const char *path, catalog_t *catalog) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        ERROR("Catalog file %s could not be opened - %s.", path, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fileno(fp), &st) != 0) {
+        ERROR("Could not stat catalog file %s - %s.", path, strerror(errno));
+        fclose(fp);
+        return -1;
+    }
+    size_t file_size = st.st_size;
+    char *buf = (char *) malloc(file_size + 1);
+    MALLOC_CHK(buf);
+    if (fread(buf, 1, file_size, fp) != file_size) {
+        ERROR("Could not read catalog file %s.", path);
+        free(buf);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+
+    const char magic[] = SLOW5_CAT_MAGIC;
+    const char eof[] = SLOW5_CAT_EOF;
+    size_t pos = sizeof magic;
+    size_t end = file_size - sizeof eof;
+    uint32_t num_files = 0;
+    uint64_t num_recs = 0;
+    if (file_size < sizeof magic + sizeof eof || memcmp(buf, magic, sizeof magic) != 0 || memcmp(buf + end, eof, sizeof eof) != 0) {
+        goto malformed;
+    }
+
+    CAT_READ(&num_files, sizeof num_files);
+    for (uint32_t i = 0; i < num_files; i++) {
+        uint32_t path_len;
+        CAT_READ(&path_len, sizeof path_len);
+        if (pos + path_len > end) goto malformed;
+        catalog->files.push_back(std::string(buf + pos, path_len));
+        pos += path_len;
+        uint64_t file_size;
+        int64_t file_mtime;
+        CAT_READ(&file_size, sizeof file_size);
+        CAT_READ(&file_mtime, sizeof file_mtime);
+        catalog->file_sizes.push_back(file_size);
+        catalog->file_mtimes.push_back(file_mtime);
+        uint32_t num_read_groups;
+        CAT_READ(&num_read_groups, sizeof num_read_groups);
+        std::vector<std::string> run_ids;
+        for (uint32_t j = 0; j < num_read_groups; j++) {
+            uint16_t run_id_len;
+            CAT_READ(&run_id_len, sizeof run_id_len);
+            if (pos + run_id_len > end) goto malformed;
+            run_ids.push_back(std::string(buf + pos, run_id_len));
+            pos += run_id_len;
+        }
+        catalog->run_ids.push_back(run_ids);
+    }
+
+    CAT_READ(&num_recs, sizeof num_recs);
+    catalog->recs.reserve(num_recs);
+    for (uint64_t i = 0; i < num_recs; i++) {
+        slow5_rid_len_t read_id_len;
+        CAT_READ(&read_id_len, sizeof read_id_len);
+        if (pos + read_id_len > end) goto malformed;
+        std::string read_id(buf + pos, read_id_len);
+        pos += read_id_len;
+        catalog_rec_t rec;
+        CAT_READ(&rec.file_id, sizeof rec.file_id);
+        CAT_READ(&rec.offset, sizeof rec.offset);
+        CAT_READ(&rec.size, sizeof rec.size);
+        if (rec.file_id >= num_files) goto malformed;
+        catalog->recs.emplace(read_id, rec);
+    }
+    if (pos != end) goto malformed;
+
+    free(buf);
+    return 0;
+
+malformed:
+    ERROR("Catalog file %s is malformed. Recreate it using slow5tools index --catalog.", path);
+    free(buf);
+    return -1;
+}
+
+// check that the opened ith file of the catalog has the size and modification time it had when it was catalogued
+// a file rewritten in place would otherwise be read at stale offsets
+static int catalog_file_check(const catalog_t *catalog, size_t i, slow5_file_t *slow5_file) {
+    struct stat st;
+    if (fstat(fileno(slow5_file->fp), &st) != 0) {
+        ERROR("Could not stat file %s - %s.", catalog->files[i].c_str(), strerror(errno));
+        return -1;
+    }
+    if ((uint64_t) st.st_size != catalog->file_sizes[i] || (int64_t) st.st_mtime != catalog->file_mtimes[i]) {
+        ERROR("File '%s' has changed since it was catalogued. Recreate the catalog using slow5tools index --catalog.", catalog->files[i].c_str());
+        return -1;
+    }
+    return 0;
+}
+
+// add the auxiliary fields and the read groups (one per unique run_id) of the catalog to an initialised header
+// rg_map[i][j] is set to the output read group of the jth read group of the ith file
+int catalog_init_hdr(const catalog_t *catalog, slow5_hdr_t *header, int lossy, std::vector<std::vector<uint32_t>> &rg_map) {
+    size_t num_files = catalog->files.size();
+    if (num_files == 0) {
+        ERROR("The catalog does not have any files%s", "");
+        return -1;
+    }
+    rg_map.resize(num_files);
+
+    slow5_file_t *slow5_file = slow5_open(catalog->files[0].c_str(), "r");
+    if (!slow5_file) {
+        ERROR("File '%s' could not be opened - %s.", catalog->files[0].c_str(), strerror(errno));
+        return -1;
+    }
+    if (catalog_file_check(catalog, 0, slow5_file) != 0) {
+        slow5_close(slow5_file);
+        return -1;
+    }
+    size_t open_file_id = 0;
+
+    if (slow5_file->header->aux_meta == NULL && header->aux_meta) { // the catalogued files are lossy
+        slow5_aux_meta_free(header->aux_meta);
+        header->aux_meta = NULL;
+    }
+    if (lossy == 0 && slow5_file->header->aux_meta) {
+        slow5_aux_meta_t *aux_ptr = slow5_file->header->aux_meta;
+        for (uint32_t r = 0; r < aux_ptr->num; r++) {
+            int aux_add_fail = 0;
+            if (aux_ptr->types[r] == SLOW5_ENUM || aux_ptr->types[r] == SLOW5_ENUM_ARRAY) {
+                uint8_t n;
+                const char **enum_labels = (const char **) slow5_get_aux_enum_labels(slow5_file->header, aux_ptr->attrs[r], &n);
+                if (!enum_labels || slow5_aux_meta_add_enum(header->aux_meta, aux_ptr->attrs[r], aux_ptr->types[r], enum_labels, n)) {
+                    aux_add_fail = 1;
+                }
+            } else if (slow5_aux_meta_add(header->aux_meta, aux_ptr->attrs[r], aux_ptr->types[r])) {
+                aux_add_fail = 1;
+            }
+            if (aux_add_fail) {
+                ERROR("Could not initialize the record attribute '%s'", aux_ptr->attrs[r]);
+                slow5_close(slow5_file);
+                return -1;
+            }
+        }
+    }
+
+    std::unordered_map<std::string, uint32_t> run_id_to_group;
+    for (size_t i = 0; i < num_files; i++) {
+        size_t num_read_groups = catalog->run_ids[i].size();
+        rg_map[i].resize(num_read_groups);
+        for (size_t j = 0; j < num_read_groups; j++) {
+            auto it = run_id_to_group.find(catalog->run_ids[i][j]);
+            if (it != run_id_to_group.end()) {
+                rg_map[i][j] = it->second;
+                continue;
+            }
+            if (open_file_id != i) { // header data of a new run_id is taken from the first file it was seen
+                slow5_close(slow5_file);
+                slow5_file = slow5_open(catalog->files[i].c_str(), "r");
+                if (!slow5_file) {
+                    ERROR("File '%s' could not be opened - %s.", catalog->files[i].c_str(), strerror(errno));
+                    return -1;
+                }
+                if (catalog_file_check(catalog, i, slow5_file) != 0) {
+                    slow5_close(slow5_file);
+                    return -1;
+                }
+                open_file_id = i;
+            }
+            khash_t(slow5_s2s) *rg = slow5_hdr_get_data(j, slow5_file->header);
+            int64_t new_read_group = slow5_hdr_add_rg_data(header, rg);
+            if (new_read_group < 0) {
+                ERROR("Could not add the read group of run_id %s to the output header", catalog->run_ids[i][j].c_str());
+                slow5_close(slow5_file);
+                return -1;
+            }
+            run_id_to_group[catalog->run_ids[i][j]] = new_read_group;
+            rg_map[i][j] = new_read_group;
+        }
+    }
+    slow5_close(slow5_file);
+    return 0;
+}
+
+// fetch and decode the record of read_id, remapping its read group to the output header if rg_map is given
+// returns 0 on success, -1 if read_id is not in the catalog and -2 on a read or decode error
+int catalog_get(const catalog_t *catalog, file_cache_t *cache, const std::vector<std::vector<uint32_t>> *rg_map, const char *read_id, slow5_rec_t **read) {
+    auto it = catalog->recs.find(std::string(read_id));
+    if (it == catalog->recs.end()) {
+        return -1;
+    }
+    const catalog_rec_t &rec = it->second;
+
+    slow5_file_t *slow5_file = file_cache_get(cache, rec.file_id);
+    if (!slow5_file) {
+        return -2;
+    }
+    size_t bytes;
+    char *mem = idx_rec_mem(slow5_file, rec.offset, rec.size, &bytes);
+    if (!mem || slow5_rec_depress_parse(&mem, &bytes, NULL, read, slow5_file) != 0) {
+        ERROR("Could not read the record %s from %s", read_id, catalog->files[rec.file_id].c_str());
+        file_cache_put(cache, rec.file_id);
+        free(mem);
+        return -2;
+    }
+    file_cache_put(cache, rec.file_id);
+    free(mem);
+
+    if (rg_map) {
+        (*read)->read_group = (*rg_map)[rec.file_id][(*read)->read_group];
+    }
+    return 0;
+}
+
+void file_cache_init(file_cache_t *cache, const catalog_t *catalog, size_t capacity) {
+    cache->catalog = catalog;
+    cache->capacity = capacity > 0 ? capacity : 1;
+    int ret = pthread_mutex_init(&cache->lock, NULL);
+    NEG_CHK(ret);
+}
+
+// return an open handle for the given file, opening it (and closing idle files beyond the capacity) if needed
+// each successful call must be paired with file_cache_put()
+slow5_file_t *file_cache_get(file_cache_t *cache, uint32_t file_id) {
+    pthread_mutex_lock(&cache->lock);
+    auto it = cache->open_files.find(file_id);
+    if (it != cache->open_files.end()) {
+        it->second.refs++;
+        cache->lru.splice(cache->lru.begin(), cache->lru, it->second.lru_pos);
+        slow5_file_t *slow5_file = it->second.slow5_file;
+        pthread_mutex_unlock(&cache->lock);
+        return slow5_file;
+    }
+
+    // evict the least recently used files that are not in use by any thread
+    auto lru_it = cache->lru.end();
+    while (cache->open_files.size() >= cache->capacity && lru_it != cache->lru.begin()) {
+        --lru_it;
+        auto victim = cache->open_files.find(*lru_it);
+        if (victim->second.refs == 0) {
+            slow5_close(victim->second.slow5_file);
+            cache->open_files.erase(victim);
+            lru_it = cache->lru.erase(lru_it);
+        }
+    }
+
+    const char *path = cache->catalog->files[file_id].c_str();
+    slow5_file_t *slow5_file = slow5_open(path, "r");
+    if (!slow5_file) {
+        ERROR("File '%s' could not be opened - %s.", path, strerror(errno));
+        pthread_mutex_unlock(&cache->lock);
+        return NULL;
+    }
+    if (catalog_file_check(cache->catalog, file_id, slow5_file) != 0) {
+        slow5_close(slow5_file);
+        pthread_mutex_unlock(&cache->lock);
+        return NULL;
+    }
+    cache->lru.push_front(file_id);
+    cached_file_t cached;
+    cached.slow5_file = slow5_file;
+    cached.refs = 1;
+    cached.lru_pos = cache->lru.begin();
+    cache->open_files[file_id] = cached;
+    pthread_mutex_unlock(&cache->lock);
+    return slow5_file;
+}
+
+void file_cache_put(file_cache_t *cache, uint32_t file_id) {
+    pthread_mutex_lock(&cache->lock);
+    auto it = cache->open_files.find(file_id);
+    if (it != cache->open_files.end()) {
+        it->second.refs--;
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void file_cache_destroy(file_cache_t *cache) {
+    for (auto &it : cache->open_files) {
+        slow5_close(it.second.slow5_file);
+    }
+    cache->open_files.clear();
+    cache->lru.clear();
+    pthread_mutex_destroy(&cache->lock);
+}
@@ -0,0 +1,58 @@
+// Multi-file catalog index: read ID -> (file, offset, size) over many SLOW5/BLOW5 files
+
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <slow5/slow5.h>
+#include "misc.h"
+
+#define SLOW5_CAT_MAGIC { 'S', 'L', 'O', 'W', '5', 'C', 'A', 'T', '\2' }
+#define SLOW5_CAT_EOF { 'T', 'A', 'C', '5', 'W', 'O', 'L', 'S' }
+#define DEFAULT_MAX_OPEN_FILES 256
+
+typedef struct {
+    uint32_t file_id;
+    uint64_t offset;
+    uint64_t size;
+} catalog_rec_t;
+
+typedef struct {
+    std::vector<std::string> files;                 // absolute paths of the indexed files
+    std::vector<uint64_t> file_sizes;               // size of each file when it was catalogued
+    std::vector<int64_t> file_mtimes;               // modification time of each file when it was catalogued
+    std::vector<std::vector<std::string>> run_ids;  // run_id of each read group of each file
+    std::unordered_map<std::string, catalog_rec_t> recs;
+} catalog_t;
+
+/* bounded cache of open slow5 files shared by worker threads */
+typedef struct {
+    slow5_file_t *slow5_file;
+    int refs;
+    std::list<uint32_t>::iterator lru_pos;
+} cached_file_t;
+
+typedef struct {
+    const catalog_t *catalog;
+    size_t capacity;
+    std::unordered_map<uint32_t, cached_file_t> open_files;
+    std::list<uint32_t> lru; // most recently used first
+    pthread_mutex_t lock;
+} file_cache_t;
+
+int catalog_build(const std::vector<std::string> &slow5_files, int32_t num_threads, catalog_t *catalog);
+int catalog_write(const char *path, const catalog_t *catalog);
+int catalog_load(const char *path, catalog_t *catalog);
+int catalog_init_hdr(const catalog_t *catalog, slow5_hdr_t *header, int lossy, std::vector<std::vector<uint32_t>> &rg_map);
+int catalog_get(const catalog_t *catalog, file_cache_t *cache, const std::vector<std::vector<uint32_t>> *rg_map, const char *read_id, slow5_rec_t **read);
+
+void file_cache_init(file_cache_t *cache, const catalog_t *catalog, size_t capacity);
+slow5_file_t *file_cache_get(file_cache_t *cache, uint32_t file_id);
+void file_cache_put(file_cache_t *cache, uint32_t file_id);
+void file_cache_destroy(file_cache_t *cache);
+
+#endif
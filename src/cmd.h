@@ -11,6 +11,10 @@
 #define DEFAULT_RETAIN_DIR_STRUCTURE 0
 #define DEFAULT_DUMP_ALL 0
 #define DEFAULT_CONTINUE_MERGE 0
+#define DEFAULT_INDEX 0
+#define DEFAULT_MERGE_READERS 4
+#define DEFAULT_MERGE_SORT_MEM "1G"
+#define DEFAULT_SPLIT_WRITERS 8
 
 #define TO_STR(x) TO_STR2(x)
 #define TO_STR2(x) #x
@@ -24,6 +28,9 @@
 #define HELP_MSG_OUTPUT_DIRECTORY \
     "    -d, --out-dir DIR             output to directory\n"
 
+#define HELP_MSG_INDEX \
+    "        --index                   also write the index of each output file while writing it\n"
+
 #define HELP_MSG_LOSSLESS \
     "        --lossless                retain information in auxiliary fields during the conversion [true]\n"
 
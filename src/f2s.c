@@ -37,6 +37,7 @@
     HELP_MSG_LOSSLESS \
     HELP_MSG_CONTINUE_F2S \
     HELP_MSG_RETAIN_DIR_STRUCTURE \
+    HELP_MSG_INDEX \
     HELP_MSG_HELP \
     HELP_FORMATS_METHODS
 
@@ -53,6 +54,9 @@ void f2s_child_worker(opt_t *user_opts, std::vector<std::string>& fast5_files, r
     std::string slow5_path;
     std::string slow5_path_outputdir_single_fast5;
     std::unordered_map<std::string, uint32_t> warning_map;
+    std::vector<idx_rec_t> idx_entries;
+    std::vector<idx_rec_t> idx_entries_outputdir_single_fast5;
+    std::vector<idx_rec_t> *idx_entries_ptr = user_opts->flag_index ? &idx_entries : NULL;
     std::string extension = ".blow5";
     char *output_dir = user_opts->arg_dir_out;
     if(user_opts->fmt_out==SLOW5_FORMAT_ASCII){
@@ -111,7 +115,7 @@ void f2s_child_worker(opt_t *user_opts, std::vector<std::string>& fast5_files, r
                     ERROR("%s","Could not initialise the SLOW5 header.");
                     exit(EXIT_FAILURE);
                 }
-                ret = read_fast5(user_opts, &fast5_file, slow5File, 0, &warning_map);
+                ret = read_fast5(user_opts, &fast5_file, slow5File, 0, &warning_map, idx_entries_ptr);
                 if(ret < 0){
                     ERROR("Bad fast5: Could not read contents of the fast5 file '%s'.", fast5_files[i].c_str());
                     exit(EXIT_FAILURE);
@@ -123,6 +127,9 @@ void f2s_child_worker(opt_t *user_opts, std::vector<std::string>& fast5_files, r
                     }
                 }
                 slow5_close(slow5File);
+                if (user_opts->flag_index && idx_finish(slow5_path.c_str(), idx_entries) < 0) {
+                    exit(EXIT_FAILURE);
+                }
                 slow5_path = std::string(output_dir);
 
             }else{ // single-fast5
@@ -146,7 +153,8 @@ void f2s_child_worker(opt_t *user_opts, std::vector<std::string>& fast5_files, r
                         exit(EXIT_FAILURE);
                     }
                 }
-                ret = read_fast5(user_opts, &fast5_file, slow5File_outputdir_single_fast5, call_count++, &warning_map);
+                ret = read_fast5(user_opts, &fast5_file, slow5File_outputdir_single_fast5, call_count++, &warning_map,
+                                 user_opts->flag_index ? &idx_entries_outputdir_single_fast5 : NULL);
                 if(ret<0){
                     ERROR("Could not read contents of the fast5 file '%s'.", fast5_files[i].c_str());
                     exit(EXIT_FAILURE);
@@ -181,7 +189,7 @@ void f2s_child_worker(opt_t *user_opts, std::vector<std::string>& fast5_files, r
                     exit(EXIT_FAILURE);
                 }
             }
-            ret = read_fast5(user_opts, &fast5_file, slow5File, call_count++, &warning_map);
+            ret = read_fast5(user_opts, &fast5_file, slow5File, call_count++, &warning_map, idx_entries_ptr);
             if(ret<0){
                 ERROR("Could not read contents of the fast5 file '%s'.", fast5_files[i].c_str());
                 exit(EXIT_FAILURE);
@@ -198,6 +206,9 @@ void f2s_child_worker(opt_t *user_opts, std::vector<std::string>& fast5_files, r
             }
         }
         slow5_close(slow5File_outputdir_single_fast5);
+        if (user_opts->flag_index && idx_finish(slow5_path_outputdir_single_fast5.c_str(), idx_entries_outputdir_single_fast5) < 0) {
+            exit(EXIT_FAILURE);
+        }
     }
     if(slow5File && !output_dir) {
         if(user_opts->fmt_out == SLOW5_FORMAT_BINARY){
@@ -207,6 +218,9 @@ void f2s_child_worker(opt_t *user_opts, std::vector<std::string>& fast5_files, r
             }
         }
         slow5_close(slow5File); //if stdout was used stdout is now closed.
+        if (user_opts->flag_index && idx_finish(user_opts->arg_fname_out, idx_entries) < 0) {
+            exit(EXIT_FAILURE);
+        }
     }
     INFO("Summary - total fast5: %lu, bad fast5: %lu", readsCount->total_5, readsCount->bad_5_file);
 }
@@ -336,6 +350,7 @@ int f2s_main(int argc, char **argv, struct program_meta *meta) {
             {"allow",       no_argument,       NULL, 'a'},  //8
             {"retain",      no_argument,       NULL,  0 },  //9
             {"dump-all",    required_argument, NULL,  0 },  //10
+            {"index",       no_argument,       NULL,  0 },  //11
             {NULL, 0, NULL, 0 }
     };
 
@@ -388,6 +403,9 @@ int f2s_main(int argc, char **argv, struct program_meta *meta) {
                     case 10:
                         user_opts.arg_dump_all = optarg;
                         break;
+                    case 11:
+                        user_opts.flag_index = 1;
+                        break;
                     default:
                         fprintf(stderr, HELP_SMALL_MSG, argv[0]);
                         EXIT_MSG(EXIT_FAILURE, argv, meta);
@@ -428,6 +446,10 @@ int f2s_main(int argc, char **argv, struct program_meta *meta) {
         ERROR("Both output file name (-o) and output directory (-d) cannot be set simultaneously. %s","");
         return EXIT_FAILURE;
     }
+    if(user_opts.flag_index && !user_opts.arg_fname_out && !user_opts.arg_dir_out){
+        ERROR("--index requires an output file (-o) or an output directory (-d)%s","");
+        return EXIT_FAILURE;
+    }
 
     // Check for remaining files to parse
     if (optind >= argc) {
@@ -11,13 +11,23 @@
 #include "thread.h"
 #include "cmd.h"
 #include "misc.h"
-
-#define READ_ID_INIT_CAPACITY (128)
-
-#define USAGE_MSG "Usage: %s [OPTIONS] [SLOW5_FILE] [READ_ID]...\n"
+#include "read_fast5.h"
+#include "slow5_extra.h"
+#include "catalog.h"
+#include "bloom.h"
+#include "rid_list.h"
+#include "histogram.h"
+#include "slow5_idx.h"
+#include <random>
+#include <time.h>
+#include <atomic>
+
+#define USAGE_MSG "Usage: %s [OPTIONS] [SLOW5_FILE] [READ_ID]...\n" \
+                  "       %s [OPTIONS] --catalog FILE [READ_ID]...\n"
 #define HELP_LARGE_MSG \
     "Display the read entry for each specified read id from a slow5 file.\n" \
     "With no READ_ID, read from standard input newline separated read ids.\n" \
+    "With --catalog, read ids are looked up across all the files in a catalog created by slow5tools index --catalog.\n" \
     USAGE_MSG \
     "\n" \
     "OPTIONS:\n" \
@@ -28,22 +38,68 @@
     HELP_MSG_BATCH \
     "    -l --list [FILE]              list of read ids provided as a single-column text file with one read id per line.\n" \
     "    --skip                        warn and continue if a read_id was not found.\n" \
+    "    --catalog FILE                fetch reads from the files in the catalog index FILE instead of a single SLOW5_FILE\n" \
+    "    --max-open INT                maximum number of files kept open at once with --catalog [default: 256]\n" \
+    "    --no-bloom                    do not use the bloom filter created by slow5tools index --bloom with --skip\n" \
+    "    --benchmark                   fetch without writing and report the per-read lookup latency distribution\n" \
+    "    --random INT                  with --benchmark, look up INT read ids sampled at random from the index instead of the given ones\n" \
     HELP_MSG_HELP \
     HELP_FORMATS_METHODS
 
 extern int slow5tools_verbosity_level;
 
+/* shared state of the get worker threads */
+typedef struct {
+    // fetching records through a catalog
+    const catalog_t *catalog;
+    file_cache_t *file_cache;
+    const std::vector<std::vector<uint32_t>> *rg_map;
+    // rejecting missing read ids with a bloom filter
+    const bloom_t *bloom;
+    std::atomic<int64_t> bloom_rejected;
+    std::atomic<int64_t> bloom_false_positives;
+    // --benchmark
+    hist_t *latency_hist;
+    std::atomic<uint64_t> bytes_read;
+} get_param_t;
+
+static inline uint64_t get_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
 void work_per_single_read_get(core_t *core, db_t *db, int32_t i) {
 
     char *id = db->read_id[i];
+    get_param_t *get_param = (get_param_t *) core->param;
+
+    if (get_param->bloom && !bloom_check(get_param->bloom, id, strlen(id))) {
+        ++ get_param->bloom_rejected;
+        ++ db->n_err;
+        db->read_record[i].buffer = NULL;
+        db->read_record[i].len = -1;
+        return;
+    }
 
     int len = 0;
     //fprintf(stderr, "Fetching %s\n", id); // TODO print here or during ordered loop later?
     slow5_rec_t *record=NULL;
 
+    uint64_t start = core->benchmark ? get_time_ns() : 0;
     len = slow5_get(id,&record,core->fp);
+    if (core->benchmark) {
+        hist_record(get_param->latency_hist, get_time_ns() - start);
+        struct slow5_rec_idx read_index;
+        if (record != NULL && slow5_idx_get(core->fp->index, id, &read_index) == 0) {
+            get_param->bytes_read += read_index.size;
+        }
+    }
 
     if (record == NULL || len < 0) {
+        if (get_param->bloom) {
+            ++ get_param->bloom_false_positives;
+        }
         ++ db->n_err;
         db->read_record[i].buffer = NULL;
         db->read_record[i].len = -1;
@@ -61,7 +117,42 @@ void work_per_single_read_get(core_t *core, db_t *db, int32_t i) {
         }
         slow5_rec_free(record);
     }
-    free(id);
+}
+
+// same as work_per_single_read_get, but the record is located through the catalog
+void work_per_single_read_get_catalog(core_t *core, db_t *db, int32_t i) {
+
+    char *id = db->read_id[i];
+    get_param_t *get_catalog = (get_param_t *) core->param;
+    db->read_record[i].buffer = NULL;
+    db->read_record[i].len = -1;
+
+    slow5_rec_t *record = NULL;
+    uint64_t start = core->benchmark ? get_time_ns() : 0;
+    int ret = catalog_get(get_catalog->catalog, get_catalog->file_cache, get_catalog->rg_map, id, &record);
+    if (core->benchmark) {
+        hist_record(get_catalog->latency_hist, get_time_ns() - start);
+        if (ret == 0) {
+            get_catalog->bytes_read += get_catalog->catalog->recs.find(std::string(id))->second.size;
+        }
+    }
+    if (ret != 0) {
+        ++ db->n_err;
+        return;
+    }
+
+    if (core->benchmark == false){
+        size_t record_size;
+        struct slow5_press* compress = slow5_press_init(core->press_method);
+        if(!compress){
+            ERROR("Could not initialize the slow5 compression method%s","");
+            exit(EXIT_FAILURE);
+        }
+        db->read_record[i].buffer = slow5_rec_to_mem(record, core->aux_meta, core->format_out, compress, &record_size);
+        db->read_record[i].len = record_size;
+        slow5_press_free(compress);
+    }
+    slow5_rec_free(record);
 }
 
 bool fetch_record(slow5_file_t *fp, const char *read_id, char **argv, program_meta *meta, slow5_fmt format_out,
@@ -101,7 +192,7 @@ int get_main(int argc, char **argv, struct program_meta *meta) {
 
     // No arguments given
     if (argc <= 1) {
-        fprintf(stderr, HELP_LARGE_MSG, argv[0]);
+        fprintf(stderr, HELP_LARGE_MSG, argv[0], argv[0]);
         EXIT_MSG(EXIT_FAILURE, argv, meta);
         return EXIT_FAILURE;
     }
@@ -117,6 +208,10 @@ int get_main(int argc, char **argv, struct program_meta *meta) {
         {"threads",     required_argument, NULL, 't' }, //7
         {"help",        no_argument, NULL, 'h' }, //8
         {"benchmark",   no_argument, NULL, 'e' }, //9
+        {"catalog",     required_argument, NULL, 0}, //10
+        {"max-open",    required_argument, NULL, 0}, //11
+        {"no-bloom",    no_argument, NULL, 0}, //12
+        {"random",      required_argument, NULL, 0}, //13
         {NULL, 0, NULL, 0 }
     };
 
@@ -133,6 +228,10 @@ int get_main(int argc, char **argv, struct program_meta *meta) {
     int longindex = 0;
 
     int skip_flag = 0;
+    char *catalog_path = NULL;
+    int64_t max_open_files = DEFAULT_MAX_OPEN_FILES;
+    int bloom_flag = 1;
+    int64_t num_random = 0;
 
     // Parse options
     while ((opt = getopt_long(argc, argv, "o:b:c:s:K:l:t:he", long_opts, &longindex)) != -1) {
@@ -165,7 +264,7 @@ int get_main(int argc, char **argv, struct program_meta *meta) {
                 break;
             case 'h':
                 DEBUG("displaying large help message%s","");
-                fprintf(stdout, HELP_LARGE_MSG, argv[0]);
+                fprintf(stdout, HELP_LARGE_MSG, argv[0], argv[0]);
                 EXIT_MSG(EXIT_SUCCESS, argv, meta);
                 exit(EXIT_SUCCESS);
             case 0  :
@@ -173,6 +272,28 @@ int get_main(int argc, char **argv, struct program_meta *meta) {
                     case 6:
                         skip_flag = 1;
                         break;
+                    case 10:
+                        catalog_path = optarg;
+                        break;
+                    case 11:
+                        max_open_files = atol(optarg);
+                        if (max_open_files <= 0) {
+                            ERROR("Maximum number of open files should be larger than 0. You entered %ld", max_open_files);
+                            EXIT_MSG(EXIT_FAILURE, argv, meta);
+                            return EXIT_FAILURE;
+                        }
+                        break;
+                    case 12:
+                        bloom_flag = 0;
+                        break;
+                    case 13:
+                        num_random = atol(optarg);
+                        if (num_random <= 0) {
+                            ERROR("Number of random read ids should be larger than 0. You entered %ld", num_random);
+                            EXIT_MSG(EXIT_FAILURE, argv, meta);
+                            return EXIT_FAILURE;
+                        }
+                        break;
                 }
                 break;
             default: // case '?'
@@ -215,6 +336,10 @@ int get_main(int argc, char **argv, struct program_meta *meta) {
         ERROR("Benchmark does not support writing records out%s", "");
         return EXIT_FAILURE;
     }
+    if(num_random && !benchmark){
+        ERROR("--random can only be used with --benchmark%s", "");
+        return EXIT_FAILURE;
+    }
 
     // Parse output argument
     if (user_opts.arg_fname_out != NULL) {
@@ -237,7 +362,11 @@ int get_main(int argc, char **argv, struct program_meta *meta) {
     }
 
     // Check for remaining files to parse
-    if (optind >= argc) {
+    if (catalog_path) {
+        if (optind >= argc) {
+            read_stdin = true;
+        }
+    } else if (optind >= argc) {
         ERROR("missing slow5 or blow5 file%s", "");
         fprintf(stderr, HELP_SMALL_MSG, argv[0]);
 
@@ -257,15 +386,56 @@ int get_main(int argc, char **argv, struct program_meta *meta) {
         }
     }
 
-    char *f_in_name = argv[optind];
+    slow5_press_method_t press_out = {user_opts.record_press_out,user_opts.signal_press_out};
 
-    slow5_file_t *slow5file = slow5_open(f_in_name, "r");
-    if (!slow5file) {
-        ERROR("cannot open %s. \n", f_in_name);
-        return EXIT_FAILURE;
-    }
+    slow5_file_t *slow5file = NULL;
+    int first_read_id = optind + 1;
+
+    catalog_t catalog;
+    file_cache_t file_cache;
+    std::vector<std::vector<uint32_t>> rg_map;
+    get_param_t get_param;
+    get_param.catalog = &catalog;
+    get_param.file_cache = &file_cache;
+    get_param.rg_map = &rg_map;
+    get_param.bloom = NULL;
+    get_param.bloom_rejected = 0;
+    get_param.bloom_false_positives = 0;
+    get_param.latency_hist = benchmark ? hist_init() : NULL;
+    get_param.bytes_read = 0;
+    double index_load_time = 0;
+    bloom_t *bloom = NULL;
+
+    if (catalog_path) {
+        first_read_id = optind;
+        double realtime0 = slow5_realtime();
+        if (catalog_load(catalog_path, &catalog) < 0) {
+            EXIT_MSG(EXIT_FAILURE, argv, meta);
+            return EXIT_FAILURE;
+        }
+        index_load_time = slow5_realtime() - realtime0;
+        VERBOSE("Loaded the catalog of %ld reads from %ld files - took %.3fs", catalog.recs.size(), catalog.files.size(), slow5_realtime() - realtime0);
 
-    slow5_press_method_t press_out = {user_opts.record_press_out,user_opts.signal_press_out};
+        // the output header has a read group for each unique run_id in the catalog
+        slow5file = slow5_init_empty(user_opts.f_out, user_opts.arg_fname_out, user_opts.fmt_out);
+        if (slow5_hdr_initialize(slow5file->header, 0) < 0) {
+            ERROR("Could not initialize the output header%s", "");
+            return EXIT_FAILURE;
+        }
+        slow5file->header->num_read_groups = 0;
+        if (catalog_init_hdr(&catalog, slow5file->header, 0, rg_map) < 0) {
+            EXIT_MSG(EXIT_FAILURE, argv, meta);
+            return EXIT_FAILURE;
+        }
+        file_cache_init(&file_cache, &catalog, max_open_files);
+    } else {
+        char *f_in_name = argv[optind];
+        slow5file = slow5_open(f_in_name, "r");
+        if (!slow5file) {
+            ERROR("cannot open %s. \n", f_in_name);
+            return EXIT_FAILURE;
+        }
+    }
 
     if(benchmark == false){
         if(slow5_hdr_fwrite(user_opts.f_out, slow5file->header, user_opts.fmt_out, press_out) == -1){
@@ -274,64 +444,94 @@ int get_main(int argc, char **argv, struct program_meta *meta) {
         }
     }
 
-    int ret_idx = slow5_idx_load(slow5file);
-    if (ret_idx < 0) {
-        ERROR("Error loading index file for %s\n", f_in_name);
-        EXIT_MSG(EXIT_FAILURE, argv, meta);
+    if (catalog_path == NULL) {
+        double realtime0 = slow5_realtime();
+        int ret_idx = slow5_idx_load(slow5file);
+        index_load_time = slow5_realtime() - realtime0;
+        if (ret_idx < 0) {
+            ERROR("Error loading index file for %s\n", argv[optind]);
+            EXIT_MSG(EXIT_FAILURE, argv, meta);
+            return EXIT_FAILURE;
+        }
+        // with --skip most read ids may be absent, so reject them with the bloom filter before probing the index
+        if (skip_flag && bloom_flag && bloom_is_fresh(argv[optind])) {
+            bloom = bloom_load(bloom_get_path(argv[optind]).c_str());
+            get_param.bloom = bloom;
+        }
+    }
+
+    // Setup multithreading structures
+    core_t core;
+    core.num_thread = user_opts.num_threads;
+    core.fp = slow5file;
+    core.format_out = user_opts.fmt_out;
+    core.press_method = press_out;
+    core.benchmark = benchmark;
+    core.aux_meta = slow5file->header->aux_meta;
+    core.param = &get_param;
+    void (*get_func)(core_t*, db_t*, int32_t) = catalog_path ? work_per_single_read_get_catalog : work_per_single_read_get;
+
+    if (num_random && !read_stdin) {
+        ERROR("--random cannot be used with read ids given as arguments%s", "");
         return EXIT_FAILURE;
     }
 
-    if (read_stdin) {
-        // Time spend reading slow5
-        double read_time = 0;
+    // Time spend reading slow5
+    double read_time = 0;
+    int64_t total_ids = 0;
 
-        // Setup multithreading structures
-        core_t core;
-        core.num_thread = user_opts.num_threads;
-        core.fp = slow5file;
-        core.format_out = user_opts.fmt_out;
-        core.press_method = press_out;
-        core.benchmark = benchmark;
+    if (read_stdin) {
+        double realtime0 = slow5_realtime();
+        rid_list_t read_id_list;
+        read_id_list.arena = NULL;
+        if (num_random) {
+            // sample (with replacement) from all the read ids in the index, with a fixed seed for repeatable runs
+            std::vector<char *> all_ids;
+            if (catalog_path) {
+                all_ids.reserve(catalog.recs.size());
+                for (const auto &rec : catalog.recs) {
+                    all_ids.push_back((char *) rec.first.c_str());
+                }
+            } else {
+                uint64_t num_rids;
+                char **rids = slow5_get_rids(slow5file, &num_rids);
+                all_ids.assign(rids, rids + num_rids);
+            }
+            if (all_ids.empty()) {
+                ERROR("No read ids in the index to sample from%s", "");
+                return EXIT_FAILURE;
+            }
+            std::mt19937_64 rng(1);
+            std::uniform_int_distribution<size_t> pick(0, all_ids.size() - 1);
+            for (int64_t i = 0; i < num_random; ++ i) {
+                read_id_list.ids.push_back(all_ids[pick(rng)]);
+            }
+            read_id_list.num_dups = 0;
+        } else if (rid_list_load(read_list_in, &read_id_list, 1) < 0) {
+            // the whole list is loaded at once into a single arena and duplicate read ids are removed
+            EXIT_MSG(EXIT_FAILURE, argv, meta);
+            return EXIT_FAILURE;
+        }
+        total_ids = read_id_list.ids.size();
+        VERBOSE("Loaded %ld read ids (%" PRIu64 " duplicates removed) - took %.3fs", total_ids, read_id_list.num_dups, slow5_realtime() - realtime0);
 
         db_t db = { 0 };
-        int64_t cap_ids = READ_ID_INIT_CAPACITY;
-        db.read_id = (char **) malloc(cap_ids * sizeof(char*));
-        db.read_record = (raw_record_t*) malloc(cap_ids * sizeof(raw_record_t));
-        MALLOC_CHK(db.read_id);
+        db.read_record = (raw_record_t*) malloc(user_opts.read_id_batch_capacity * sizeof(raw_record_t));
         MALLOC_CHK(db.read_record);
-        bool end_of_file = false;
-        while (!end_of_file) {
-            int64_t num_ids = 0;
-            while (num_ids < user_opts.read_id_batch_capacity) {
-                char *buf = NULL;
-                size_t cap_buf = 0;
-                ssize_t nread;
-                if ((nread = getline(&buf, &cap_buf, read_list_in)) == -1) {
-                    end_of_file = true;
-                    free(buf);
-                    break;
-                }
-                size_t len_buf = nread - 1; // Ignore '\n'
-                char *curr_id = strndup(buf, len_buf);
-                curr_id[len_buf] = '\0'; // Add string terminator '\0'
-                free(buf); // Free buffer
-                if (num_ids >= cap_ids) {
-                    // Double read id list capacity
-                    cap_ids *= 2;
-                    db.read_id = (char **) realloc(db.read_id, cap_ids * sizeof *db.read_id);
-                    db.read_record = (raw_record_t*) realloc(db.read_record, cap_ids * sizeof *db.read_record);
-                }
-                db.read_id[num_ids] = curr_id;
-                ++ num_ids;
+        for (int64_t batch_start = 0; batch_start < total_ids; batch_start += user_opts.read_id_batch_capacity) {
+            int64_t num_ids = total_ids - batch_start;
+            if (num_ids > user_opts.read_id_batch_capacity) {
+                num_ids = user_opts.read_id_batch_capacity;
             }
-
+            db.read_id = read_id_list.ids.data() + batch_start;
+            db.n_err = 0;
             db.n_batch = num_ids;
 
             // Measure reading time
             double start = slow5_realtime();
 
             // Fetch records for read ids in the batch
-            work_db(&core, &db, work_per_single_read_get);
+            work_db(&core, &db, get_func);
 
             double end = slow5_realtime();
             read_time += end - start;
@@ -354,15 +554,54 @@ int get_main(int argc, char **argv, struct program_meta *meta) {
                 }
             }
         }
-        // Print total time to read slow5
-        VERBOSE("read time = %.3f sec", read_time);
         // Free everything
-        free(db.read_id);
+        rid_list_free(&read_id_list);
+        free(db.read_record);
+    } else if (catalog_path) {
+        // read ids given as arguments are fetched as a single batch
+        db_t db = { 0 };
+        int64_t num_ids = argc - first_read_id;
+        db.read_id = argv + first_read_id;
+        db.read_record = (raw_record_t*) malloc(num_ids * sizeof(raw_record_t));
+        MALLOC_CHK(db.read_record);
+        db.n_batch = num_ids;
+        double start = slow5_realtime();
+        work_db(&core, &db, get_func);
+        read_time += slow5_realtime() - start;
+        for (int64_t i = 0; i < num_ids; ++ i) {
+            void *buffer = db.read_record[i].buffer;
+            int len = db.read_record[i].len;
+            if (buffer == NULL || len < 0) {
+                if(skip_flag || benchmark) continue;
+                ERROR("Could not fetch records.%s","");
+                return EXIT_FAILURE;
+            }
+            fwrite(buffer,1,len,user_opts.f_out);
+            free(buffer);
+        }
         free(db.read_record);
     } else {
-        for (int i = optind + 1; i < argc; ++ i){
+        for (int i = first_read_id; i < argc; ++ i){
+            if (bloom && !bloom_check(bloom, argv[i], strlen(argv[i]))) {
+                ++ get_param.bloom_rejected;
+                continue; // bloom is only used with --skip
+            }
+            uint64_t start = get_time_ns();
             bool success = fetch_record(slow5file, argv[i], argv, meta, user_opts.fmt_out, press_out, benchmark, user_opts.f_out);
+            uint64_t elapsed = get_time_ns() - start;
+            read_time += elapsed * 1e-9;
+            ++ total_ids;
+            if (benchmark) {
+                hist_record(get_param.latency_hist, elapsed);
+                struct slow5_rec_idx read_index;
+                if (success && slow5_idx_get(slow5file->index, argv[i], &read_index) == 0) {
+                    get_param.bytes_read += read_index.size;
+                }
+            }
             if (!success) {
+                if (bloom) {
+                    ++ get_param.bloom_false_positives;
+                }
                 if(skip_flag) continue;
                 ERROR("Could not fetch records.%s","");
                 return EXIT_FAILURE;
@@ -376,7 +615,39 @@ int get_main(int argc, char **argv, struct program_meta *meta) {
             }
     }
 
-    slow5_close(slow5file);
+    // Print total time to read slow5
+    VERBOSE("read time = %.3f sec", read_time);
+
+    if (benchmark) {
+        hist_t *hist = get_param.latency_hist;
+        uint64_t lookups = hist->total;
+        fprintf(stderr, "index load time (s)\t%.3f\n", index_load_time);
+        fprintf(stderr, "lookups\t%" PRIu64 "\n", lookups);
+        fprintf(stderr, "lookups/s\t%.1f\n", read_time > 0 ? lookups / read_time : 0.0);
+        fprintf(stderr, "latency p50 (us)\t%.2f\n", hist_percentile(hist, 50) * 1e-3);
+        fprintf(stderr, "latency p90 (us)\t%.2f\n", hist_percentile(hist, 90) * 1e-3);
+        fprintf(stderr, "latency p99 (us)\t%.2f\n", hist_percentile(hist, 99) * 1e-3);
+        fprintf(stderr, "latency p999 (us)\t%.2f\n", hist_percentile(hist, 99.9) * 1e-3);
+        fprintf(stderr, "latency max (us)\t%.2f\n", hist->max * 1e-3);
+        fprintf(stderr, "bytes read per lookup\t%.1f\n", lookups > 0 ? (double) get_param.bytes_read / lookups : 0.0);
+        hist_free(hist);
+    }
+
+    if (bloom) {
+        int64_t rejected = get_param.bloom_rejected;
+        int64_t false_positives = get_param.bloom_false_positives;
+        VERBOSE("Bloom filter rejected %ld missing reads, %ld missing reads passed the filter (observed false positive rate %.4f)",
+                (long) rejected, (long) false_positives, rejected + false_positives > 0 ? (double) false_positives / (rejected + false_positives) : 0.0);
+        bloom_free(bloom);
+    }
+
+    if (catalog_path) {
+        file_cache_destroy(&file_cache);
+        slow5_hdr_free(slow5file->header);
+        free(slow5file);
+    } else {
+        slow5_close(slow5file);
+    }
     fclose(read_list_in);
 
     EXIT_MSG(EXIT_SUCCESS, argv, meta);
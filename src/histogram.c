@@ -0,0 +1,83 @@
+/**
+ * @file histogram.c
+ * @brief log-linear (HDR-style) latency histogram with lock-free recording from multiple threads
+ * @date 18/10/2026
+ */
+#include <stdlib.h>
+#include "histogram.h"
+#include "error.h"
+
+#define HIST_SUB_COUNT (1U << HIST_SUB_BITS)
+
+// values below HIST_SUB_COUNT get a bucket each, above that each power of two is split into HIST_SUB_COUNT buckets
+static inline uint32_t hist_bucket(uint64_t value) {
+    if (value < HIST_SUB_COUNT) {
+        return (uint32_t) value;
+    }
+    uint32_t msb = 63 - __builtin_clzll(value);
+    uint32_t shift = msb - HIST_SUB_BITS;
+    return (shift + 1) * HIST_SUB_COUNT + (uint32_t) ((value >> shift) - HIST_SUB_COUNT);
+}
+
+// the midpoint of the values that fall in the bucket
+static inline uint64_t hist_bucket_value(uint32_t bucket) {
+    if (bucket < HIST_SUB_COUNT) {
+        return bucket;
+    }
+    uint32_t shift = bucket / HIST_SUB_COUNT - 1;
+    uint64_t mantissa = bucket % HIST_SUB_COUNT + HIST_SUB_COUNT;
+    return (mantissa << shift) + ((1ULL << shift) >> 1);
+}
+
+hist_t *hist_init(void) {
+    hist_t *hist = new hist_t;
+    hist->num_buckets = (HIST_MAX_BITS - HIST_SUB_BITS + 1) * HIST_SUB_COUNT;
+    hist->counts = new std::atomic<uint64_t>[hist->num_buckets];
+    for (uint32_t i = 0; i < hist->num_buckets; i++) {
+        hist->counts[i].store(0, std::memory_order_relaxed);
+    }
+    hist->total.store(0);
+    hist->max.store(0);
+    return hist;
+}
+
+void hist_record(hist_t *hist, uint64_t value) {
+    uint32_t bucket = hist_bucket(value);
+    if (bucket >= hist->num_buckets) {
+        bucket = hist->num_buckets - 1;
+    }
+    hist->counts[bucket].fetch_add(1, std::memory_order_relaxed);
+    hist->total.fetch_add(1, std::memory_order_relaxed);
+    uint64_t prev = hist->max.load(std::memory_order_relaxed);
+    while (value > prev && !hist->max.compare_exchange_weak(prev, value, std::memory_order_relaxed)) {
+    }
+}
+
+// the value at the given percentile (0-100), 0 for an empty histogram
+uint64_t hist_percentile(const hist_t *hist, double percentile) {
+    uint64_t total = hist->total.load();
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t) (percentile / 100.0 * total + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < hist->num_buckets; i++) {
+        seen += hist->counts[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            uint64_t value = hist_bucket_value(i);
+            uint64_t max = hist->max.load();
+            return value < max ? value : max;
+        }
+    }
+    return hist->max.load();
+}
+
+void hist_free(hist_t *hist) {
+    if (hist) {
+        delete[] hist->counts;
+        delete hist;
+    }
+}
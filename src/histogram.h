@@ -0,0 +1,24 @@
+// Log-linear (HDR-style) latency histogram with lock-free recording from multiple threads
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+#include <atomic>
+
+#define HIST_SUB_BITS (7)   // 128 linear sub-buckets per power of two, i.e. under 1% relative error
+#define HIST_MAX_BITS (40)  // values up to 2^40 (about 18 minutes in nanoseconds)
+
+typedef struct {
+    std::atomic<uint64_t> *counts;
+    uint32_t num_buckets;
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> max;
+} hist_t;
+
+hist_t *hist_init(void);
+void hist_record(hist_t *hist, uint64_t value);
+uint64_t hist_percentile(const hist_t *hist, double percentile);
+void hist_free(hist_t *hist);
+
+#endif
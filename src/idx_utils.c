@@ -0,0 +1,579 @@
+/**
+ * @file idx_utils.c
+ * @brief helpers for reading SLOW5/BLOW5 index files and record boundaries
+ * @date 18/10/2026
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_set>
+#include "idx_utils.h"
+#include "error.h"
+#include "thread.h"
+#include "slow5_extra.h"
+
+#define IDX_PROGRESS_INTERVAL (1.0) // seconds between progress updates
+
+extern int slow5tools_verbosity_level;
+
+// pread until all the requested bytes are read
+static int pread_full(int fd, char *buf, size_t count, off_t offset){
+    while (count > 0) {
+        ssize_t ret = pread(fd, buf, count, offset);
+        if (ret <= 0) {
+            return -1;
+        }
+        buf += ret;
+        count -= ret;
+        offset += ret;
+    }
+    return 0;
+}
+
+std::string idx_get_path(const char *slow5_path){
+    return std::string(slow5_path) + SLOW5_IDX_EXT;
+}
+
+// return 1 if the index file exists and is not older than the slow5 file, 0 otherwise
+int idx_is_fresh(const char *slow5_path){
+    struct stat st_slow5;
+    struct stat st_idx;
+    std::string path = idx_get_path(slow5_path);
+    if (stat(slow5_path, &st_slow5) != 0 || stat(path.c_str(), &st_idx) != 0) {
+        return 0;
+    }
+    return st_idx.st_mtime >= st_slow5.st_mtime ? 1 : 0;
+}
+
+// the offset where the records of a slow5 file end: its size, less the end of file marker for BLOW5
+// returns -1 if the file cannot be stat'ed
+off_t idx_records_end(slow5_file_t *slow5_file){
+    struct stat st;
+    if (fstat(fileno(slow5_file->fp), &st) != 0) {
+        return -1;
+    }
+    const char eof[] = SLOW5_BINARY_EOF;
+    return st.st_size - (slow5_file->format == SLOW5_FORMAT_BINARY ? sizeof eof : 0);
+}
+
+// load all entries of an index file in the order they are stored
+int idx_read(const char *idx_path, std::vector<idx_rec_t> &entries, struct slow5_version *version){
+    FILE *fp = fopen(idx_path, "r");
+    if (!fp) {
+        ERROR("Index file %s could not be opened - %s.", idx_path, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fileno(fp), &st) != 0) {
+        ERROR("Could not stat index file %s - %s.", idx_path, strerror(errno));
+        fclose(fp);
+        return -1;
+    }
+    const char magic[] = SLOW5_IDX_MAGIC;
+    const char eof[] = SLOW5_IDX_EOF;
+    size_t file_size = st.st_size;
+    if (file_size < SLOW5_IDX_HEADER_SIZE + sizeof eof) {
+        ERROR("Index file %s is truncated.", idx_path);
+        fclose(fp);
+        return -1;
+    }
+    char *buf = (char *) malloc(file_size);
+    MALLOC_CHK(buf);
+    if (fread(buf, 1, file_size, fp) != file_size) {
+        ERROR("Could not read index file %s.", idx_path);
+        free(buf);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+
+    if (memcmp(buf, magic, sizeof magic) != 0 || memcmp(buf + file_size - sizeof eof, eof, sizeof eof) != 0) {
+        ERROR("Index file %s is malformed. Recreate it using slow5tools index.", idx_path);
+        free(buf);
+        return -1;
+    }
+    if (version) {
+        version->major = (uint8_t) buf[sizeof magic];
+        version->minor = (uint8_t) buf[sizeof magic + 1];
+        version->patch = (uint8_t) buf[sizeof magic + 2];
+    }
+
+    size_t pos = SLOW5_IDX_HEADER_SIZE;
+    size_t end = file_size - sizeof eof;
+    while (pos < end) {
+        slow5_rid_len_t read_id_len;
+        if (pos + sizeof read_id_len > end) {
+            break;
+        }
+        memcpy(&read_id_len, buf + pos, sizeof read_id_len);
+        pos += sizeof read_id_len;
+        if (pos + read_id_len + 2 * sizeof(uint64_t) > end) {
+            break;
+        }
+        idx_rec_t rec;
+        rec.read_id = strndup(buf + pos, read_id_len);
+        MALLOC_CHK(rec.read_id);
+        pos += read_id_len;
+        memcpy(&rec.offset, buf + pos, sizeof rec.offset);
+        pos += sizeof rec.offset;
+        memcpy(&rec.size, buf + pos, sizeof rec.size);
+        pos += sizeof rec.size;
+        entries.push_back(rec);
+    }
+    free(buf);
+    if (pos != end) {
+        ERROR("Index file %s is malformed. Recreate it using slow5tools index.", idx_path);
+        return -1;
+    }
+    return 0;
+}
+
+// count the entries of an index file by hopping over their read ids, without decoding them
+// records_end is set to the end of the furthest record indexed
+// returns -1 if the index file cannot be read or is malformed
+static int64_t idx_count(const char *idx_path, uint64_t *records_end) {
+    FILE *fp = fopen(idx_path, "r");
+    if (!fp) {
+        return -1;
+    }
+    struct stat st;
+    const char magic[] = SLOW5_IDX_MAGIC;
+    const char eof[] = SLOW5_IDX_EOF;
+    char header[SLOW5_IDX_HEADER_SIZE];
+    if (fstat(fileno(fp), &st) != 0 || st.st_size < (off_t) (SLOW5_IDX_HEADER_SIZE + sizeof eof) ||
+        fread(header, 1, sizeof header, fp) != sizeof header || memcmp(header, magic, sizeof magic) != 0) {
+        fclose(fp);
+        return -1;
+    }
+    off_t entries_end = st.st_size - sizeof eof;
+    off_t pos = SLOW5_IDX_HEADER_SIZE;
+    int64_t n = 0;
+    *records_end = 0;
+    while (pos < entries_end) {
+        slow5_rid_len_t read_id_len;
+        uint64_t offset_size[2];
+        if (fread(&read_id_len, sizeof read_id_len, 1, fp) != 1) {
+            break;
+        }
+        pos += sizeof read_id_len + read_id_len + sizeof offset_size;
+        if (pos > entries_end || fseeko(fp, read_id_len, SEEK_CUR) != 0 || fread(offset_size, sizeof offset_size, 1, fp) != 1) {
+            break;
+        }
+        if (offset_size[0] + offset_size[1] > *records_end) {
+            *records_end = offset_size[0] + offset_size[1];
+        }
+        n++;
+    }
+    char tail[sizeof eof];
+    int ok = pos == entries_end && fread(tail, 1, sizeof tail, fp) == sizeof tail && memcmp(tail, eof, sizeof eof) == 0;
+    fclose(fp);
+    return ok ? n : -1;
+}
+
+// the number of records of a slow5 file taken from a .idx that is not older than it so that the records need not be read
+// an index of the same second as the file is only trusted if its last record ends where the records of the file do
+// returns -1 if there is no such index
+int64_t idx_num_records(slow5_file_t *slow5_file) {
+    const char *slow5_path = slow5_file->meta.pathname;
+    if (!idx_is_fresh(slow5_path)) {
+        return -1;
+    }
+    std::string idx_path = idx_get_path(slow5_path);
+    uint64_t indexed_end;
+    int64_t n = idx_count(idx_path.c_str(), &indexed_end);
+    if (n < 0) {
+        WARNING("Index file %s is malformed. Ignoring it.", idx_path.c_str());
+        return -1;
+    }
+    off_t records_end = idx_records_end(slow5_file);
+    if (n == 0 || records_end < 0 || indexed_end != (uint64_t) records_end) {
+        VERBOSE("Index file %s does not cover all the records of %s. Ignoring it.", idx_path.c_str(), slow5_path);
+        return -1;
+    }
+    return n;
+}
+
+// count the remaining records of a slow5 file from their boundaries only, without reading or decompressing them:
+// BLOW5 records are hopped over using their size prefixes and SLOW5 records are counted as lines
+// the file position of slow5_file->fp is not used; returns -1 if the records do not end where the file does
+int64_t idx_count_records(slow5_file_t *slow5_file) {
+    int fd = fileno(slow5_file->fp);
+    off_t pos = ftello(slow5_file->fp);
+    struct stat st;
+    if (pos < 0 || fstat(fd, &st) != 0) {
+        return -1;
+    }
+    int64_t n = 0;
+    if (slow5_file->format == SLOW5_FORMAT_BINARY) {
+        const char eof[] = SLOW5_BINARY_EOF;
+        off_t records_end = st.st_size - sizeof eof;
+        while (pos < records_end) {
+            slow5_rec_size_t record_size;
+            if (pread_full(fd, (char *) &record_size, sizeof record_size, pos) != 0) {
+                return -1;
+            }
+            pos += sizeof record_size + record_size;
+            n++;
+        }
+        return pos == records_end ? n : -1;
+    }
+    char *buf = (char *) malloc(COPY_RANGE_BUFFER);
+    MALLOC_CHK(buf);
+    char last = '\n';
+    while (pos < st.st_size) {
+        ssize_t ret = pread(fd, buf, COPY_RANGE_BUFFER, pos);
+        if (ret <= 0) {
+            free(buf);
+            return -1;
+        }
+        for (char *p = buf; (p = (char *) memchr(p, '\n', buf + ret - p)); p++) {
+            n++;
+        }
+        last = buf[ret - 1];
+        pos += ret;
+    }
+    free(buf);
+    return last == '\n' ? n : n + 1; // a last record without a newline
+}
+
+// sequentially read the remaining records of a slow5 file and record their read ids and boundaries
+int idx_scan(slow5_file_t *slow5_file, std::vector<idx_rec_t> &entries){
+    size_t bytes;
+    char *mem;
+    off_t offset = ftello(slow5_file->fp);
+    while ((mem = (char *) slow5_get_next_mem(&bytes, slow5_file))) {
+        off_t next_offset = ftello(slow5_file->fp);
+        struct slow5_rec *read = NULL;
+        if (slow5_rec_depress_parse(&mem, &bytes, NULL, &read, slow5_file) != 0) {
+            ERROR("Could not decode the slow5 record at offset %" PRId64 " in %s", (int64_t) offset, slow5_file->meta.pathname);
+            return -1;
+        }
+        free(mem);
+        idx_rec_t rec;
+        rec.read_id = strdup(read->read_id);
+        MALLOC_CHK(rec.read_id);
+        rec.offset = offset;
+        rec.size = next_offset - offset;
+        entries.push_back(rec);
+        slow5_rec_free(read);
+        offset = next_offset;
+    }
+    if (slow5_errno != SLOW5_ERR_EOF) {
+        ERROR("Error reading the file %s.", slow5_file->meta.pathname);
+        return -1;
+    }
+    return 0;
+}
+
+void idx_entries_free(std::vector<idx_rec_t> &entries){
+    for (size_t i = 0; i < entries.size(); i++) {
+        free(entries[i].read_id);
+    }
+    entries.clear();
+}
+
+// fetch the raw record at the given index location in the same form slow5_get_next_mem() returns it
+// thread safe as the file position of slow5_file->fp is not used
+char *idx_rec_mem(slow5_file_t *slow5_file, uint64_t offset, uint64_t size, size_t *n){
+    if (slow5_file->format == SLOW5_FORMAT_BINARY) {
+        if (size < sizeof(slow5_rec_size_t)) {
+            return NULL;
+        }
+        offset += sizeof(slow5_rec_size_t);
+        size -= sizeof(slow5_rec_size_t);
+    } else if (size == 0) {
+        return NULL;
+    }
+    char *mem = (char *) malloc(size + 1);
+    MALLOC_CHK(mem);
+    if (pread_full(fileno(slow5_file->fp), mem, size, offset) != 0) {
+        free(mem);
+        return NULL;
+    }
+    if (slow5_file->format == SLOW5_FORMAT_ASCII) {
+        mem[size - 1] = '\0'; // replace the newline
+        *n = size - 1;
+    } else {
+        mem[size] = '\0';
+        *n = size;
+    }
+    return mem;
+}
+
+// return the read id (to be freed by the caller) of a raw record from slow5_get_next_mem() without parsing the rest of the record
+// thread safe
+char *idx_mem_read_id(slow5_file_t *slow5_file, const char *mem, size_t bytes) {
+    char *read_id = NULL;
+    if (slow5_file->format == SLOW5_FORMAT_ASCII) {
+        const char *tab = (const char *) memchr(mem, '\t', bytes);
+        if (tab) {
+            read_id = strndup(mem, tab - mem);
+            MALLOC_CHK(read_id);
+        }
+        return read_id;
+    }
+
+    // only the record compression has to be undone, the read id is the first field of the record
+    // the stateless slow5_ptr_depress_multi is used as this runs in several threads on the same file
+    size_t n = 0;
+    char *rec = (char *) slow5_ptr_depress_multi(slow5_file->compress->record_press->method, mem, bytes, &n);
+    slow5_rid_len_t read_id_len;
+    if (rec && n >= sizeof read_id_len) {
+        memcpy(&read_id_len, rec, sizeof read_id_len);
+        if (sizeof read_id_len + read_id_len <= n) {
+            read_id = strndup(rec + sizeof read_id_len, read_id_len);
+            MALLOC_CHK(read_id);
+        }
+    }
+    free(rec);
+    return read_id;
+}
+
+static void idx_extract_read_id(core_t *core, db_t *db, int32_t i) {
+    db->read_id[i] = idx_mem_read_id(core->fp, db->mem_records[i], db->mem_bytes[i]);
+}
+
+static void idx_print_progress(slow5_file_t *slow5_file, off_t offset, off_t file_size, size_t num_reads, int done) {
+    if (slow5tools_verbosity_level < LOG_INFO || !isatty(fileno(stderr)) || file_size <= 0) {
+        return;
+    }
+    fprintf(stderr, "\r[idx_build::INFO] %s: %.1f%% (%zu reads)%s", slow5_file->meta.pathname,
+            100.0 * offset / file_size, num_reads, done ? "\n" : "");
+}
+
+// read the complete record at offset of a file that may still be being written
+// returns NULL at the end of the complete records, setting *eof if the BLOW5 end of file marker was reached
+static char *idx_tail_mem(slow5_file_t *slow5_file, off_t offset, off_t file_size, size_t *bytes, off_t *next, int *eof) {
+    if (slow5_file->format == SLOW5_FORMAT_BINARY) {
+        const char eof_marker[] = SLOW5_BINARY_EOF;
+        if (offset + (off_t) sizeof eof_marker == file_size) {
+            char buf[sizeof eof_marker];
+            if (pread_full(fileno(slow5_file->fp), buf, sizeof buf, offset) == 0 && memcmp(buf, eof_marker, sizeof eof_marker) == 0) {
+                *eof = 1;
+                return NULL;
+            }
+        }
+        slow5_rec_size_t size;
+        if (offset + (off_t) sizeof size > file_size || pread_full(fileno(slow5_file->fp), (char *) &size, sizeof size, offset) != 0 ||
+            offset + (off_t) (sizeof size + size) > file_size) {
+            return NULL; // partially written record
+        }
+        char *mem = (char *) malloc(size + 1);
+        MALLOC_CHK(mem);
+        if (pread_full(fileno(slow5_file->fp), mem, size, offset + sizeof size) != 0) {
+            free(mem);
+            return NULL;
+        }
+        mem[size] = '\0';
+        *bytes = size;
+        *next = offset + sizeof size + size;
+        return mem;
+    }
+
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t len = getline(&line, &cap, slow5_file->fp);
+    if (len <= 0 || line[len - 1] != '\n' || offset + len > file_size) {
+        free(line); // a line without the newline is still being written
+        return NULL;
+    }
+    line[len - 1] = '\0';
+    *bytes = len - 1;
+    *next = offset + len;
+    return line;
+}
+
+// index the records from offset onwards and append them to entries
+// read_ids holds the read ids of entries and is extended with the new ones to reject duplicates
+// if tail is set, the file may still be being written: only the complete records are indexed and the end is not an error
+static int idx_build_from(slow5_file_t *slow5_file, off_t offset, int tail, int32_t num_threads, int64_t batch_size,
+                          std::vector<idx_rec_t> &entries, std::unordered_set<std::string> &read_ids, int *eof) {
+    struct stat st;
+    off_t file_size = fstat(fileno(slow5_file->fp), &st) == 0 ? st.st_size : 0;
+    if (tail && fseeko(slow5_file->fp, offset, SEEK_SET) != 0) {
+        ERROR("Could not seek to offset %" PRId64 " in %s", (int64_t) offset, slow5_file->meta.pathname);
+        return -1;
+    }
+
+    core_t core;
+    core.num_thread = num_threads;
+    core.fp = slow5_file;
+
+    db_t db = { 0 };
+    db.mem_records = (char **) malloc(batch_size * sizeof *db.mem_records);
+    MALLOC_CHK(db.mem_records);
+    db.mem_bytes = (size_t *) malloc(batch_size * sizeof *db.mem_bytes);
+    MALLOC_CHK(db.mem_bytes);
+    db.read_id = (char **) malloc(batch_size * sizeof *db.read_id);
+    MALLOC_CHK(db.read_id);
+    std::vector<off_t> offsets(batch_size + 1);
+
+    int ret = 0;
+    double last_progress = slow5_realtime();
+    while (ret == 0) {
+        db.n_batch = 0;
+        offsets[0] = offset;
+        while (db.n_batch < batch_size) {
+            char *mem;
+            if (tail) {
+                mem = idx_tail_mem(slow5_file, offsets[db.n_batch], file_size, &db.mem_bytes[db.n_batch], &offsets[db.n_batch + 1], eof);
+            } else {
+                mem = (char *) slow5_get_next_mem(&db.mem_bytes[db.n_batch], slow5_file);
+                offsets[db.n_batch + 1] = ftello(slow5_file->fp);
+            }
+            if (!mem) {
+                break;
+            }
+            db.mem_records[db.n_batch ++] = mem;
+        }
+        if (db.n_batch == 0) {
+            break;
+        }
+        offset = offsets[db.n_batch];
+
+        work_db(&core, &db, idx_extract_read_id);
+
+        for (int64_t i = 0; i < db.n_batch; i++) {
+            free(db.mem_records[i]);
+            if (ret < 0) {
+                free(db.read_id[i]);
+                continue;
+            }
+            if (db.read_id[i] == NULL) {
+                ERROR("Could not decode the slow5 record at offset %" PRId64 " in %s", (int64_t) offsets[i], slow5_file->meta.pathname);
+                ret = -1;
+                continue;
+            }
+            if (!read_ids.insert(db.read_id[i]).second) {
+                ERROR("Duplicate read id '%s' found in %s.", db.read_id[i], slow5_file->meta.pathname);
+                free(db.read_id[i]);
+                ret = -1;
+                continue;
+            }
+            idx_rec_t rec;
+            rec.read_id = db.read_id[i];
+            rec.offset = offsets[i];
+            rec.size = offsets[i + 1] - offsets[i];
+            entries.push_back(rec);
+        }
+
+        if (slow5_realtime() - last_progress >= IDX_PROGRESS_INTERVAL) {
+            idx_print_progress(slow5_file, offset, file_size, entries.size(), 0);
+            last_progress = slow5_realtime();
+        }
+    }
+    if (ret == 0 && !tail && slow5_errno != SLOW5_ERR_EOF) {
+        ERROR("Error reading the file %s.", slow5_file->meta.pathname);
+        ret = -1;
+    }
+    if (ret == 0) {
+        idx_print_progress(slow5_file, tail ? offset : file_size, file_size, entries.size(), 1);
+    }
+
+    free(db.mem_records);
+    free(db.mem_bytes);
+    free(db.read_id);
+    return ret;
+}
+
+// index the remaining records of a slow5 file
+// a single thread hops over the record boundaries and the read ids are decoded by num_threads workers
+int idx_build(slow5_file_t *slow5_file, int32_t num_threads, int64_t batch_size, std::vector<idx_rec_t> &entries) {
+    std::unordered_set<std::string> read_ids;
+    for (size_t i = 0; i < entries.size(); i++) {
+        read_ids.insert(entries[i].read_id);
+    }
+    return idx_build_from(slow5_file, ftello(slow5_file->fp), 0, num_threads, batch_size, entries, read_ids, NULL);
+}
+
+// append the records written after the last entry of an existing index of a file that may still be growing
+// read_ids must hold the read ids of entries; it is kept up to date so that it can be passed to the next update
+// slow5_file must have just been opened. *eof is set once the BLOW5 end of file marker has been written
+int idx_update(slow5_file_t *slow5_file, int32_t num_threads, int64_t batch_size, std::vector<idx_rec_t> &entries,
+               std::unordered_set<std::string> &read_ids, int *eof) {
+    off_t offset = ftello(slow5_file->fp);
+    if (!entries.empty()) {
+        // make sure the index still describes this file before resuming from its last entry
+        const idx_rec_t &last = entries.back();
+        size_t bytes;
+        char *mem = idx_rec_mem(slow5_file, last.offset, last.size, &bytes);
+        char *read_id = mem ? idx_mem_read_id(slow5_file, mem, bytes) : NULL;
+        int match = read_id && strcmp(read_id, last.read_id) == 0;
+        free(read_id);
+        free(mem);
+        if (!match) {
+            ERROR("The index of %s does not match the file. Recreate it using slow5tools index without --update.", slow5_file->meta.pathname);
+            return -1;
+        }
+        offset = last.offset + last.size;
+    }
+    *eof = 0;
+    return idx_build_from(slow5_file, offset, 1, num_threads, batch_size, entries, read_ids, eof);
+}
+
+// write an index file in the same format as slow5_idx_create()
+// the index is written to a temporary file that is renamed when complete so a reader never sees a partial index
+int idx_write(const char *idx_path, const std::vector<idx_rec_t> &entries, struct slow5_version version) {
+    std::string tmp_path = std::string(idx_path) + ".tmp";
+    FILE *fp = fopen(tmp_path.c_str(), "w");
+    if (!fp) {
+        ERROR("Index file %s could not be opened - %s.", tmp_path.c_str(), strerror(errno));
+        return -1;
+    }
+
+    const char magic[] = SLOW5_IDX_MAGIC;
+    const char eof[] = SLOW5_IDX_EOF;
+    char header[SLOW5_IDX_HEADER_SIZE] = { 0 };
+    memcpy(header, magic, sizeof magic);
+    header[sizeof magic] = version.major;
+    header[sizeof magic + 1] = version.minor;
+    header[sizeof magic + 2] = version.patch;
+    fwrite(header, 1, sizeof header, fp);
+
+    for (size_t i = 0; i < entries.size(); i++) {
+        slow5_rid_len_t read_id_len = strlen(entries[i].read_id);
+        fwrite(&read_id_len, sizeof read_id_len, 1, fp);
+        fwrite(entries[i].read_id, 1, read_id_len, fp);
+        fwrite(&entries[i].offset, sizeof entries[i].offset, 1, fp);
+        fwrite(&entries[i].size, sizeof entries[i].size, 1, fp);
+    }
+    fwrite(eof, 1, sizeof eof, fp);
+
+    if (ferror(fp) || fclose(fp) != 0) {
+        ERROR("Could not write the index file %s.", tmp_path.c_str());
+        unlink(tmp_path.c_str());
+        return -1;
+    }
+    if (rename(tmp_path.c_str(), idx_path) != 0) {
+        ERROR("Could not rename %s to %s - %s.", tmp_path.c_str(), idx_path, strerror(errno));
+        unlink(tmp_path.c_str());
+        return -1;
+    }
+    return 0;
+}
+
+// record that the record of read_id was written at [offset, offset+size) of the output
+void idx_add(std::vector<idx_rec_t> &entries, const char *read_id, uint64_t offset, uint64_t size) {
+    idx_rec_t rec;
+    rec.read_id = strdup(read_id);
+    MALLOC_CHK(rec.read_id);
+    rec.offset = offset;
+    rec.size = size;
+    entries.push_back(rec);
+}
+
+// write the index of a slow5 file that has just been written and closed from the entries collected while writing it
+// the version is taken from the header of the written file so that the index matches what slow5tools index creates
+int idx_finish(const char *slow5_path, std::vector<idx_rec_t> &entries) {
+    slow5_file_t *slow5_file = slow5_open(slow5_path, "r");
+    if (!slow5_file) {
+        ERROR("File '%s' could not be opened to write its index.", slow5_path);
+        idx_entries_free(entries);
+        return -1;
+    }
+    struct slow5_version version = slow5_file->header->version;
+    slow5_close(slow5_file);
+    int ret = idx_write(idx_get_path(slow5_path).c_str(), entries, version);
+    idx_entries_free(entries);
+    return ret;
+}
@@ -0,0 +1,42 @@
+// Helpers for reading SLOW5/BLOW5 index (.idx) files and scanning record boundaries
+
+#ifndef IDX_UTILS_H
+#define IDX_UTILS_H
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <slow5/slow5.h>
+#include "misc.h"
+
+#define SLOW5_IDX_MAGIC { 'S', 'L', 'O', 'W', '5', 'I', 'D', 'X', '\1' }
+#define SLOW5_IDX_EOF { 'X', 'D', 'I', '5', 'W', 'O', 'L', 'S' }
+#define SLOW5_IDX_HEADER_SIZE (64)
+#define SLOW5_IDX_EXT ".idx"
+
+/* a single index entry: the record of read_id spans [offset, offset+size) in the slow5 file
+   (for BLOW5, offset points to the record size prefix and size includes the prefix) */
+typedef struct {
+    char *read_id;
+    uint64_t offset;
+    uint64_t size;
+} idx_rec_t;
+
+std::string idx_get_path(const char *slow5_path);
+int idx_is_fresh(const char *slow5_path);
+off_t idx_records_end(slow5_file_t *slow5_file);
+int idx_read(const char *idx_path, std::vector<idx_rec_t> &entries, struct slow5_version *version);
+int idx_scan(slow5_file_t *slow5_file, std::vector<idx_rec_t> &entries);
+int idx_build(slow5_file_t *slow5_file, int32_t num_threads, int64_t batch_size, std::vector<idx_rec_t> &entries);
+int idx_update(slow5_file_t *slow5_file, int32_t num_threads, int64_t batch_size, std::vector<idx_rec_t> &entries,
+               std::unordered_set<std::string> &read_ids, int *eof);
+int idx_write(const char *idx_path, const std::vector<idx_rec_t> &entries, struct slow5_version version);
+void idx_entries_free(std::vector<idx_rec_t> &entries);
+char *idx_mem_read_id(slow5_file_t *slow5_file, const char *mem, size_t bytes);
+void idx_add(std::vector<idx_rec_t> &entries, const char *read_id, uint64_t offset, uint64_t size);
+int idx_finish(const char *slow5_path, std::vector<idx_rec_t> &entries);
+char *idx_rec_mem(slow5_file_t *slow5_file, uint64_t offset, uint64_t size, size_t *n);
+int64_t idx_num_records(slow5_file_t *slow5_file);
+int64_t idx_count_records(slow5_file_t *slow5_file);
+
+#endif
@@ -6,23 +6,99 @@
  */
 #include <stdio.h>
 #include <getopt.h>
+#include <signal.h>
+#include <unistd.h>
 
+#include <string>
+#include <vector>
+#include <unordered_set>
 #include <slow5/slow5.h>
 #include "error.h"
 #include "cmd.h"
 #include "misc.h"
+#include "read_fast5.h"
+#include "catalog.h"
+#include "idx_utils.h"
+#include "bloom.h"
+#include "sidx.h"
 
-#define USAGE_MSG "Usage: %s  [SLOW5|BLOW5_FILE]\n"
+#define USAGE_MSG "Usage: %s  [SLOW5|BLOW5_FILE]\n" \
+                  "       %s --catalog FILE [OPTIONS] [SLOW5_FILE/DIR] ...\n"
 #define HELP_LARGE_MSG \
     USAGE_MSG \
     "Create a slow5 or blow5 index file.\n" \
+    "With --catalog, create a single catalog index over many slow5/blow5 files for slow5tools get --catalog.\n" \
     "\n" \
     "OPTIONS:\n" \
+    "    --catalog FILE                write a catalog index of all the given files/directories to FILE\n" \
+    "    --bloom                       also write a bloom filter of the read ids (FILE.idx.bloom) used by get --skip\n" \
+    "    --attr FIELD[,FIELD...]       also write a secondary index (FILE.FIELD.sidx) of each given numeric field used by slow5tools query\n" \
+    "    --update                      only index the records appended after the last record in the existing index\n" \
+    "    --follow                      with --update, keep indexing a file that is being written until its end of file marker or SIGINT\n" \
+    HELP_MSG_THREADS \
+    HELP_MSG_BATCH \
     "    -h, --help\n" \
     "        Display this message and exit.\n" \
 
+#define INDEX_FOLLOW_INTERVAL 1 // seconds between checks for new records with --follow
+
 extern int slow5tools_verbosity_level;
 
+static volatile sig_atomic_t index_follow_stop = 0;
+
+static void index_signal_handler(int sig) {
+    index_follow_stop = 1;
+}
+
+// bring the index of a (possibly growing) file up to date, repeatedly if follow is set
+static int index_update(slow5_file_t *file, const char *f_in_name, opt_t *user_opts, int follow, std::vector<idx_rec_t> &entries) {
+    std::string idx_path = idx_get_path(f_in_name);
+    if (access(idx_path.c_str(), F_OK) == 0 && idx_read(idx_path.c_str(), entries, NULL) < 0) {
+        return -1;
+    }
+    // the read ids seen so far are kept across the polls so that each one only costs the new records
+    std::unordered_set<std::string> read_ids;
+    for (size_t i = 0; i < entries.size(); i++) {
+        read_ids.insert(entries[i].read_id);
+    }
+    if (follow) {
+        // no SA_RESTART so that sleep() returns on SIGINT/SIGTERM
+        struct sigaction sa;
+        memset(&sa, 0, sizeof sa);
+        sa.sa_handler = index_signal_handler;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGINT, &sa, NULL);
+        sigaction(SIGTERM, &sa, NULL);
+    }
+
+    int eof = 0;
+    int first = 1;
+    while (1) {
+        size_t num_entries = entries.size();
+        if (idx_update(file, user_opts->num_threads, user_opts->read_id_batch_capacity, entries, read_ids, &eof) < 0) {
+            return -1;
+        }
+        if (first || entries.size() > num_entries) {
+            if (idx_write(idx_path.c_str(), entries, file->header->version) < 0) {
+                return -1;
+            }
+            VERBOSE("Indexed %ld new reads (%ld in total)", (long) (entries.size() - num_entries), (long) entries.size());
+        }
+        first = 0;
+        if (!follow || eof || index_follow_stop) {
+            break;
+        }
+        sleep(INDEX_FOLLOW_INTERVAL);
+        if (index_follow_stop) {
+            break;
+        }
+    }
+    if (follow && !eof) {
+        INFO("Stopped following %s before its end of file marker was written", f_in_name);
+    }
+    return 0;
+}
+
 int index_main(int argc, char **argv, struct program_meta *meta) {
 
     // Debug: print arguments
@@ -30,19 +106,35 @@ int index_main(int argc, char **argv, struct program_meta *meta) {
 
     // No arguments given
     if (argc <= 1) {
-        fprintf(stderr, HELP_LARGE_MSG, argv[0]);
+        fprintf(stderr, HELP_LARGE_MSG, argv[0], argv[0]);
         EXIT_MSG(EXIT_FAILURE, argv, meta);
         return EXIT_FAILURE;
     }
 
     static struct option long_opts[] = {
-        {"help", no_argument, NULL, 'h' },
+        {"help", no_argument, NULL, 'h' }, //0
+        {"threads", required_argument, NULL, 't' }, //1
+        {"catalog", required_argument, NULL, 0 }, //2
+        {"bloom", no_argument, NULL, 0 }, //3
+        {"attr", required_argument, NULL, 0 }, //4
+        {"batchsize", required_argument, NULL, 'K'}, //5
+        {"update", no_argument, NULL, 0 }, //6
+        {"follow", no_argument, NULL, 0 }, //7
         {NULL, 0, NULL, 0 }
     };
 
+    opt_t user_opts;
+    init_opt(&user_opts);
+    char *catalog_path = NULL;
+    int bloom_flag = 0;
+    int update_flag = 0;
+    int follow_flag = 0;
+    std::vector<std::string> attrs;
+
     int opt;
+    int longindex = 0;
     // Parse options
-    while ((opt = getopt_long(argc, argv, "h", long_opts, NULL)) != -1) {
+    while ((opt = getopt_long(argc, argv, "ht:K:", long_opts, &longindex)) != -1) {
 
         DEBUG("opt='%c', optarg=\"%s\", optind=%d, opterr=%d, optopt='%c'",
                   opt, optarg, optind, opterr, optopt);
@@ -50,10 +142,47 @@ int index_main(int argc, char **argv, struct program_meta *meta) {
         switch (opt) {
             case 'h':
                 DEBUG("displaying large help message%s","");
-                fprintf(stdout, HELP_LARGE_MSG, argv[0]);
+                fprintf(stdout, HELP_LARGE_MSG, argv[0], argv[0]);
 
                 EXIT_MSG(EXIT_SUCCESS, argv, meta);
                 exit(EXIT_SUCCESS);
+            case 't':
+                user_opts.arg_num_threads = optarg;
+                break;
+            case 'K':
+                user_opts.arg_batch = optarg;
+                break;
+            case 0  :
+                switch (longindex) {
+                    case 2:
+                        catalog_path = optarg;
+                        break;
+                    case 3:
+                        bloom_flag = 1;
+                        break;
+                    case 6:
+                        update_flag = 1;
+                        break;
+                    case 7:
+                        follow_flag = 1;
+                        break;
+                    case 4: {
+                        std::string list(optarg);
+                        size_t start = 0;
+                        while (start <= list.size()) {
+                            size_t end = list.find(',', start);
+                            if (end == std::string::npos) {
+                                end = list.size();
+                            }
+                            if (end > start) {
+                                attrs.push_back(list.substr(start, end - start));
+                            }
+                            start = end + 1;
+                        }
+                        break;
+                    }
+                }
+                break;
             default: // case '?'
                 fprintf(stderr, HELP_SMALL_MSG, argv[0]);
                 EXIT_MSG(EXIT_FAILURE, argv, meta);
@@ -61,6 +190,15 @@ int index_main(int argc, char **argv, struct program_meta *meta) {
         }
     }
 
+    if(parse_num_threads(&user_opts,argc,argv,meta) < 0){
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
+    if(parse_batch_size(&user_opts,argc,argv) < 0){
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
+
     // Check for remaining files to parse
     if (optind >= argc) {
         ERROR("missing slow5 or blow5 file%s", "");
@@ -68,9 +206,39 @@ int index_main(int argc, char **argv, struct program_meta *meta) {
 
         EXIT_MSG(EXIT_FAILURE, argv, meta);
         return EXIT_FAILURE;
+    }
+
+    if (catalog_path) {
+        double realtime0 = slow5_realtime();
+        std::vector<std::string> files;
+        for (int i = optind; i < argc; ++ i) {
+            list_all_items(argv[i], files, 0, ".slow5");
+        }
+        VERBOSE("%ld files found - took %.3fs", files.size(), slow5_realtime() - realtime0);
+        if (files.empty()) {
+            ERROR("No slow5/blow5 files found%s", "");
+            EXIT_MSG(EXIT_FAILURE, argv, meta);
+            return EXIT_FAILURE;
+        }
+
+        catalog_t catalog;
+        if (catalog_build(files, user_opts.num_threads, &catalog) < 0) {
+            ERROR("Could not build the catalog index%s", "");
+            EXIT_MSG(EXIT_FAILURE, argv, meta);
+            return EXIT_FAILURE;
+        }
+        if (catalog_write(catalog_path, &catalog) < 0) {
+            EXIT_MSG(EXIT_FAILURE, argv, meta);
+            return EXIT_FAILURE;
+        }
+        VERBOSE("Catalogued %ld reads from %ld files - took %.3fs", catalog.recs.size(), catalog.files.size(), slow5_realtime() - realtime0);
+
+        EXIT_MSG(EXIT_SUCCESS, argv, meta);
+        return EXIT_SUCCESS;
+    }
 
     // Check for only one file
-    } else if (optind < argc - 1) {
+    if (optind < argc - 1) {
         ERROR("too many files given%s", "");
         fprintf(stderr, HELP_SMALL_MSG, argv[0]);
 
@@ -78,19 +246,74 @@ int index_main(int argc, char **argv, struct program_meta *meta) {
         return EXIT_FAILURE;
     }
 
+    if (follow_flag && !update_flag) {
+        ERROR("--follow can only be used with --update%s", "");
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
+    if (update_flag && !attrs.empty()) {
+        ERROR("--attr cannot be used with --update%s", "");
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
+
     char *f_in_name = argv[optind];
     slow5_file_t *file=slow5_open(f_in_name,"r");
     F_CHK(file,f_in_name);
 
-    if (slow5_idx_create(file) != 0) {
-        fprintf(stderr, "Error running slow5idx_build on %s\n",
-                f_in_name);
+    // read ids are decoded by the worker threads while the main thread hops over the record boundaries
+    double realtime0 = slow5_realtime();
+    std::vector<idx_rec_t> entries;
+    if (update_flag) {
+        if (index_update(file, f_in_name, &user_opts, follow_flag, entries) < 0) {
+            ERROR("Could not update the index of %s", f_in_name);
+            idx_entries_free(entries);
+            slow5_close(file);
+            EXIT_MSG(EXIT_FAILURE, argv, meta);
+            return EXIT_FAILURE;
+        }
+    } else if (idx_build(file, user_opts.num_threads, user_opts.read_id_batch_capacity, entries) < 0 ||
+        idx_write(idx_get_path(f_in_name).c_str(), entries, file->header->version) < 0) {
+        ERROR("Could not create the index of %s", f_in_name);
+        idx_entries_free(entries);
+        slow5_close(file);
         EXIT_MSG(EXIT_FAILURE, argv, meta);
         return EXIT_FAILURE;
     }
+    VERBOSE("Indexed %ld reads - took %.3fs", (long) entries.size(), slow5_realtime() - realtime0);
 
     slow5_close(file);
 
+    if (bloom_flag) {
+        bloom_t *bloom = bloom_init(entries.size(), BLOOM_DEFAULT_FP_RATE);
+        for (size_t i = 0; i < entries.size(); i++) {
+            bloom_add(bloom, entries[i].read_id, strlen(entries[i].read_id));
+        }
+        int ret = bloom_write(bloom, bloom_get_path(f_in_name).c_str());
+        VERBOSE("Bloom filter of %" PRIu64 " read ids: %" PRIu64 " bits, %" PRIu32 " hash functions", bloom->num_items, bloom->num_bits, bloom->num_hashes);
+        bloom_free(bloom);
+        if (ret < 0) {
+            idx_entries_free(entries);
+            EXIT_MSG(EXIT_FAILURE, argv, meta);
+            return EXIT_FAILURE;
+        }
+    }
+    idx_entries_free(entries);
+
+    if (!attrs.empty()) {
+        realtime0 = slow5_realtime();
+        file = slow5_open(f_in_name, "r");
+        F_CHK(file, f_in_name);
+        int ret = sidx_build(file, attrs, user_opts.num_threads, user_opts.read_id_batch_capacity);
+        slow5_close(file);
+        if (ret < 0) {
+            ERROR("Could not build the secondary indexes of %s", f_in_name);
+            EXIT_MSG(EXIT_FAILURE, argv, meta);
+            return EXIT_FAILURE;
+        }
+        VERBOSE("Built %ld secondary indexes - took %.3fs", (long) attrs.size(), slow5_realtime() - realtime0);
+    }
+
     EXIT_MSG(EXIT_SUCCESS, argv, meta);
     return EXIT_SUCCESS;
 }
@@ -40,6 +40,8 @@
     "    cat                   quickly concatenate SLOW5/BLOW5 files of same type (same header, extension, compression)]\n" \
     "    quickcheck            quickly checks if a SLOW5/BLOW5 file is intact\n" \
     "    skim                  skims through requested components in a SLOW5/BLOW5 file\n" \
+    "    serve                 serve records of SLOW5/BLOW5 files to local clients over a Unix domain socket\n" \
+    "    query                 display the records whose field values are within given ranges using secondary indexes\n" \
     "\n" \
     "ARGS:    Try '%s [COMMAND] --help' for more information.\n" \
 
@@ -63,6 +65,8 @@ int (stats_main)(int, char **, struct program_meta *);
 int (cat_main)(int argc, char **argv, struct program_meta *meta);
 int (quickcheck_main)(int, char **, struct program_meta *);
 int (skim_main)(int, char **, struct program_meta *);
+int (serve_main)(int, char **, struct program_meta *);
+int (query_main)(int, char **, struct program_meta *);
 
 // Segmentation fault handler
 void segv_handler(int sig) {
@@ -122,7 +126,9 @@ int main(const int argc, char **argv){
             {"skim",         skim_main},
             {"stats",        stats_main},
             {"cat",          cat_main},
-            {"quickcheck",   quickcheck_main}
+            {"quickcheck",   quickcheck_main},
+            {"serve",        serve_main},
+            {"query",        query_main}
         };
         const size_t num_cmds = sizeof (cmds) / sizeof (*cmds);
 
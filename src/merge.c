@@ -5,11 +5,20 @@
  * @date 27/02/2021
  */
 #include <getopt.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 
 #include <string>
 #include <vector>
+#include <deque>
+#include <unordered_map>
 #include <queue>
+#include <algorithm>
 #include <pthread.h>
+#include <unistd.h>
 
 #include "error.h"
 #include "cmd.h"
@@ -19,6 +28,8 @@
 #include "slow5_extra.h"
 #include "misc.h"
 #include "thread.h"
+#include "idx_utils.h"
+#include "rid_list.h"
 
 #define USAGE_MSG "Usage: %s [OPTIONS] [SLOW5_FILE/DIR] ...\n"
 #define HELP_LARGE_MSG \
@@ -33,11 +44,546 @@
     HELP_MSG_BATCH \
     HELP_MSG_LOSSLESS  \
     HELP_MSG_CONTINUE_MERGE \
+    HELP_MSG_INDEX \
+    "        --readers INT             number of input files opened and read at once [" TO_STR(DEFAULT_MERGE_READERS) "]\n" \
+    "        --sort-by KEY             sort the output records by KEY (read_id or start_time) [not sorted]\n" \
+    "        --sort-mem SIZE           memory for sorting before sorted runs are written to temporary files [" DEFAULT_MERGE_SORT_MEM "]\n" \
+    "        --dedup[=MODE]            keep only the first record of each read id (drop) or keep all and report the duplicates (report) [drop]\n" \
+    "        --pwrite                  copy the records of the input files to their precomputed output offsets in parallel when they need no conversion\n" \
+    "        --fan-in INT              merge at most INT files at once, through levels of intermediate files that are resumed if interrupted [no limit]\n" \
+    HELP_MSG_PROCESSES \
     HELP_MSG_HELP \
     HELP_FORMATS_METHODS
 
+#define MERGE_CHUNK_BYTES (8 * 1024 * 1024) // a reader hands over the records of a file in chunks of about this size
+#define MERGE_PREFETCH_CHUNKS 2 // chunks read ahead for each open file
+#define MERGE_MAX_OPEN_FILES 4096 // input files open at once in the header phase, if the file descriptor limit allows
+#define MERGE_FD_RESERVE 64 // file descriptors left for the output, the standard streams and the libraries
+
 extern int slow5tools_verbosity_level;
 
+// records read ahead from an input file
+typedef struct {
+    std::vector<char *> mem;
+    std::vector<size_t> bytes;
+} merge_chunk_t;
+
+typedef struct {
+    slow5_file_t *file;
+    std::deque<merge_chunk_t> chunks;
+    int eof;
+    int err;
+} merge_input_t;
+
+// a pool of reader threads that opens the input files ahead and reads up to num_open of them at once
+// the consumer takes the records one file after another, so the output order does not depend on the readers
+typedef struct {
+    const std::vector<std::string> *paths;
+    std::vector<merge_input_t> inputs;
+    size_t chunk_records;
+    size_t num_open;
+    size_t next_file;       // next file to be opened by a reader
+    size_t window_start;    // first file not yet closed by the consumer, only files below window_start + num_open are opened
+    int stop;
+    std::vector<pthread_t> readers;
+    pthread_mutex_t lock;
+    pthread_cond_t cond_reader;
+    pthread_cond_t cond_consumer;
+} merge_pool_t;
+
+static void *merge_reader(void *arg) {
+    merge_pool_t *pool = (merge_pool_t *) arg;
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        while (!pool->stop && pool->next_file < pool->paths->size() && pool->next_file >= pool->window_start + pool->num_open) {
+            pthread_cond_wait(&pool->cond_reader, &pool->lock);
+        }
+        if (pool->stop || pool->next_file >= pool->paths->size()) {
+            break;
+        }
+        size_t f = pool->next_file++;
+        merge_input_t *input = &pool->inputs[f];
+        pthread_mutex_unlock(&pool->lock);
+
+        const char *path = (*pool->paths)[f].c_str();
+        slow5_file_t *file = input->file; // the file may still be open from the header phase
+        if (!file && !(file = slow5_open(path, "r"))) {
+            ERROR("File '%s' could not be opened - %s.", path, strerror(errno));
+        }
+        pthread_mutex_lock(&pool->lock);
+        input->file = file;
+        input->err = file ? 0 : 1;
+        pthread_mutex_unlock(&pool->lock);
+
+        int eof = 0;
+        int err = input->err;
+        int stopped = 0;
+        while (!eof && !err) {
+            merge_chunk_t chunk;
+            size_t chunk_bytes = 0;
+            while (chunk.mem.size() < pool->chunk_records && chunk_bytes < MERGE_CHUNK_BYTES) {
+                size_t bytes;
+                char *mem = (char *) slow5_get_next_mem(&bytes, file);
+                if (!mem) {
+                    if (slow5_errno != SLOW5_ERR_EOF) {
+                        ERROR("Could not read file %s", path);
+                        err = 1;
+                    } else {
+                        eof = 1;
+                    }
+                    break;
+                }
+                chunk.mem.push_back(mem);
+                chunk.bytes.push_back(bytes);
+                chunk_bytes += bytes;
+            }
+
+            pthread_mutex_lock(&pool->lock);
+            while (!pool->stop && input->chunks.size() >= MERGE_PREFETCH_CHUNKS) {
+                pthread_cond_wait(&pool->cond_reader, &pool->lock);
+            }
+            if (pool->stop) {
+                for (size_t i = 0; i < chunk.mem.size(); i++) {
+                    free(chunk.mem[i]);
+                }
+                stopped = 1;
+                break; // still holding the lock
+            }
+            if (!chunk.mem.empty()) {
+                input->chunks.push_back(chunk);
+            }
+            input->eof = eof;
+            input->err = err;
+            pthread_cond_broadcast(&pool->cond_consumer);
+            pthread_mutex_unlock(&pool->lock);
+        }
+        if (!stopped) {
+            pthread_mutex_lock(&pool->lock);
+        }
+        pthread_cond_broadcast(&pool->cond_consumer); // also wakes the consumer up if the file could not be opened
+    }
+    pthread_mutex_unlock(&pool->lock);
+    pthread_exit(0);
+}
+
+// the pool takes over the files in cached_files, the already open first files of paths
+static void merge_pool_init(merge_pool_t *pool, const std::vector<std::string> &paths, const std::vector<slow5_file_t *> &cached_files,
+                            size_t num_open, size_t chunk_records) {
+    pool->paths = &paths;
+    pool->inputs.resize(paths.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+        pool->inputs[i].file = i < cached_files.size() ? cached_files[i] : NULL;
+        pool->inputs[i].eof = 0;
+        pool->inputs[i].err = 0;
+    }
+    pool->chunk_records = chunk_records;
+    pool->num_open = num_open < paths.size() ? num_open : paths.size();
+    pool->next_file = 0;
+    pool->window_start = 0;
+    pool->stop = 0;
+    NEG_CHK(pthread_mutex_init(&pool->lock, NULL));
+    NEG_CHK(pthread_cond_init(&pool->cond_reader, NULL));
+    NEG_CHK(pthread_cond_init(&pool->cond_consumer, NULL));
+    pool->readers.resize(pool->num_open);
+    for (size_t i = 0; i < pool->readers.size(); i++) {
+        NEG_CHK(pthread_create(&pool->readers[i], NULL, merge_reader, (void *) pool));
+    }
+}
+
+// take the next chunk of file f, waiting for the readers if needed
+// returns 1 if a chunk was taken, 0 if all the records of the file have been taken and -1 on error
+static int merge_pool_take(merge_pool_t *pool, size_t f, merge_chunk_t *chunk) {
+    merge_input_t *input = &pool->inputs[f];
+    pthread_mutex_lock(&pool->lock);
+    while (input->chunks.empty() && !input->eof && !input->err) {
+        pthread_cond_wait(&pool->cond_consumer, &pool->lock);
+    }
+    int ret;
+    if (input->err) {
+        ret = -1;
+    } else if (input->chunks.empty()) {
+        ret = 0;
+    } else {
+        chunk->mem.swap(input->chunks.front().mem);
+        chunk->bytes.swap(input->chunks.front().bytes);
+        input->chunks.pop_front();
+        pthread_cond_broadcast(&pool->cond_reader);
+        ret = 1;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return ret;
+}
+
+// close the files below f whose records have all been processed so that the readers can open the next files
+static int merge_pool_release(merge_pool_t *pool, size_t f) {
+    int ret = 0;
+    for (size_t j = pool->window_start; j < f; j++) {
+        if (pool->inputs[j].file && slow5_close(pool->inputs[j].file) == EOF) {
+            ERROR("File '%s' failed on closing - %s.", (*pool->paths)[j].c_str(), strerror(errno));
+            ret = -1;
+        }
+        pool->inputs[j].file = NULL;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->window_start = f;
+    pthread_cond_broadcast(&pool->cond_reader);
+    pthread_mutex_unlock(&pool->lock);
+    return ret;
+}
+
+// stop the readers and free whatever they have read ahead
+static void merge_pool_destroy(merge_pool_t *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->cond_reader);
+    pthread_mutex_unlock(&pool->lock);
+    for (size_t i = 0; i < pool->readers.size(); i++) {
+        NEG_CHK(pthread_join(pool->readers[i], NULL));
+    }
+    for (size_t j = 0; j < pool->inputs.size(); j++) {
+        for (size_t k = 0; k < pool->inputs[j].chunks.size(); k++) {
+            for (size_t i = 0; i < pool->inputs[j].chunks[k].mem.size(); i++) {
+                free(pool->inputs[j].chunks[k].mem[i]);
+            }
+        }
+        if (pool->inputs[j].file) {
+            slow5_close(pool->inputs[j].file);
+        }
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->cond_reader);
+    pthread_cond_destroy(&pool->cond_consumer);
+}
+
+// merge --dedup modes
+#define MERGE_DEDUP_NONE 0
+#define MERGE_DEDUP_DROP 1
+#define MERGE_DEDUP_REPORT 2
+
+// the read ids seen so far, shared by the worker threads through core->param
+typedef struct {
+    rid_set_t *set;
+    uint64_t first_seq; // sequence number of the first record of the batch
+    int mode;
+} merge_dedup_t;
+
+// merge --sort-by keys
+#define MERGE_SORT_NONE 0
+#define MERGE_SORT_READ_ID 1
+#define MERGE_SORT_START_TIME 2
+
+#define MERGE_SORT_MAX_RUNS 32 // runs of the same level that are folded into one run of the next level
+#define MERGE_SORT_RUN_BUFFER (256 * 1024) // stdio buffer of each run
+#define MERGE_SORT_REC_OVERHEAD 64 // memory taken by a buffered record besides its bytes and its read id
+
+// a converted output record waiting to be written in sorted order
+typedef struct {
+    std::string read_id;
+    uint64_t start_time;
+    char *mem;
+    size_t bytes;
+} merge_sort_rec_t;
+
+// sorts the output records with a memory budget
+// records are buffered until they take more than mem_limit bytes, then the buffer is sorted and written to a temporary run
+// runs are folded into larger runs while spilling so that only a few are open at once, and merged into the output at the end
+typedef struct {
+    int key;
+    int64_t mem_limit;
+    int64_t mem_used;
+    std::vector<merge_sort_rec_t> recs;
+    std::vector<FILE *> runs;
+    std::vector<int> run_levels; // 0 for a spilled run and one more than its runs for a folded run, non-increasing
+    std::string tmp_dir;
+} merge_sorter_t;
+
+static int merge_sort_parse_key(const char *arg) {
+    if (strcmp(arg, "read_id") == 0) {
+        return MERGE_SORT_READ_ID;
+    } else if (strcmp(arg, "start_time") == 0) {
+        return MERGE_SORT_START_TIME;
+    }
+    ERROR("invalid sort key -- '%s' (expected read_id or start_time)", arg);
+    return -1;
+}
+
+static inline bool merge_sort_less(int key, const merge_sort_rec_t &a, const merge_sort_rec_t &b) {
+    if (key == MERGE_SORT_START_TIME) {
+        return a.start_time < b.start_time;
+    }
+    return a.read_id < b.read_id;
+}
+
+// the temporary runs are created next to the output and unlinked straight away so that they are removed however merge exits
+static FILE *merge_sort_tmpfile(const std::string &dir) {
+    std::string path = dir + "/.slow5tools_merge_sort_XXXXXX";
+    std::vector<char> tmpl(path.begin(), path.end());
+    tmpl.push_back('\0');
+    int fd = mkstemp(tmpl.data());
+    if (fd < 0) {
+        ERROR("Could not create a temporary file in '%s' - %s.", dir.c_str(), strerror(errno));
+        return NULL;
+    }
+    unlink(tmpl.data());
+    FILE *fp = fdopen(fd, "w+");
+    if (!fp) {
+        ERROR("Could not open a temporary file in '%s' - %s.", dir.c_str(), strerror(errno));
+        close(fd);
+        return NULL;
+    }
+    setvbuf(fp, NULL, _IOFBF, MERGE_SORT_RUN_BUFFER);
+    return fp;
+}
+
+static void merge_sort_init(merge_sorter_t *sorter, int key, int64_t mem_limit, const char *output_path) {
+    sorter->key = key;
+    sorter->mem_limit = mem_limit;
+    sorter->mem_used = 0;
+    sorter->tmp_dir = ".";
+    if (output_path) {
+        const char *slash = strrchr(output_path, '/');
+        if (slash) {
+            sorter->tmp_dir = std::string(output_path, slash - output_path + 1);
+        }
+    } else if (getenv("TMPDIR")) {
+        sorter->tmp_dir = getenv("TMPDIR");
+    } else {
+        sorter->tmp_dir = "/tmp";
+    }
+}
+
+// run record: uint16_t read id length, read id, uint64_t start_time, uint64_t record size, record
+static int merge_sort_rec_write(FILE *run, const merge_sort_rec_t &rec) {
+    uint16_t rid_len = rec.read_id.size();
+    uint64_t bytes = rec.bytes;
+    if (fwrite(&rid_len, sizeof rid_len, 1, run) != 1 ||
+        fwrite(rec.read_id.data(), 1, rid_len, run) != rid_len ||
+        fwrite(&rec.start_time, sizeof rec.start_time, 1, run) != 1 ||
+        fwrite(&bytes, sizeof bytes, 1, run) != 1 ||
+        fwrite(rec.mem, 1, rec.bytes, run) != rec.bytes) {
+        ERROR("Could not write a temporary sorted run - %s.", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+// returns 1 if a record was read, 0 at the end of the run and -1 on error
+static int merge_sort_rec_read(FILE *run, merge_sort_rec_t *rec) {
+    uint16_t rid_len;
+    if (fread(&rid_len, sizeof rid_len, 1, run) != 1) {
+        if (feof(run)) {
+            return 0;
+        }
+        ERROR("Could not read a temporary sorted run - %s.", strerror(errno));
+        return -1;
+    }
+    uint64_t bytes;
+    rec->read_id.resize(rid_len);
+    if (fread(&rec->read_id[0], 1, rid_len, run) != rid_len ||
+        fread(&rec->start_time, sizeof rec->start_time, 1, run) != 1 ||
+        fread(&bytes, sizeof bytes, 1, run) != 1) {
+        ERROR("Could not read a temporary sorted run%s", "");
+        return -1;
+    }
+    rec->bytes = bytes;
+    rec->mem = (char *) malloc(bytes);
+    MALLOC_CHK(rec->mem);
+    if (fread(rec->mem, 1, bytes, run) != bytes) {
+        ERROR("Could not read a temporary sorted run%s", "");
+        free(rec->mem);
+        return -1;
+    }
+    return 1;
+}
+
+// write a record to a run (out_idx NULL and to_run set) or to the output, indexing it if out_idx is set
+static int merge_sort_emit(FILE *out, int to_run, std::vector<idx_rec_t> *out_idx, const merge_sort_rec_t &rec) {
+    if (to_run) {
+        return merge_sort_rec_write(out, rec);
+    }
+    if (out_idx) {
+        idx_add(*out_idx, rec.read_id.c_str(), ftello(out), rec.bytes);
+    }
+    if (fwrite(rec.mem, 1, rec.bytes, out) != rec.bytes) {
+        ERROR("Could not write the sorted records - %s.", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static void merge_sort_buffer(merge_sorter_t *sorter) {
+    int key = sorter->key;
+    auto less = [key](const merge_sort_rec_t &a, const merge_sort_rec_t &b) { return merge_sort_less(key, a, b); };
+    if (!std::is_sorted(sorter->recs.begin(), sorter->recs.end(), less)) {
+        std::stable_sort(sorter->recs.begin(), sorter->recs.end(), less);
+    }
+}
+
+static void merge_sort_clear(merge_sorter_t *sorter) {
+    for (size_t i = 0; i < sorter->recs.size(); i++) {
+        free(sorter->recs[i].mem);
+    }
+    sorter->recs.clear();
+    sorter->mem_used = 0;
+}
+
+static int merge_sort_runs(merge_sorter_t *sorter, const std::vector<FILE *> &runs, FILE *out, int to_run, std::vector<idx_rec_t> *out_idx);
+
+// merge the runs from first on into one run of the next level, which takes their place
+static int merge_sort_fold(merge_sorter_t *sorter, size_t first) {
+    FILE *run = merge_sort_tmpfile(sorter->tmp_dir);
+    if (!run) {
+        return -1;
+    }
+    std::vector<FILE *> group(sorter->runs.begin() + first, sorter->runs.end());
+    int level = sorter->run_levels[first] + 1;
+    sorter->runs.resize(first);
+    sorter->run_levels.resize(first);
+    sorter->runs.push_back(run);
+    sorter->run_levels.push_back(level);
+    if (merge_sort_runs(sorter, group, run, 1, NULL) < 0) { // closes the runs of the group
+        return -1;
+    }
+    if (fflush(run) == EOF) {
+        ERROR("Could not write a temporary sorted run - %s.", strerror(errno));
+        return -1;
+    }
+    rewind(run);
+    return 0;
+}
+
+// sort the buffered records and write them to a new run
+// once there are MERGE_SORT_MAX_RUNS runs of the lowest level, they are folded into one run of the next level (and so on),
+// so the open runs stay bounded by MERGE_SORT_MAX_RUNS per level however much is sorted
+static int merge_sort_spill(merge_sorter_t *sorter) {
+    merge_sort_buffer(sorter);
+    FILE *run = merge_sort_tmpfile(sorter->tmp_dir);
+    if (!run) {
+        return -1;
+    }
+    sorter->runs.push_back(run);
+    sorter->run_levels.push_back(0);
+    for (size_t i = 0; i < sorter->recs.size(); i++) {
+        if (merge_sort_rec_write(run, sorter->recs[i]) < 0) {
+            return -1;
+        }
+    }
+    if (fflush(run) == EOF) {
+        ERROR("Could not write a temporary sorted run - %s.", strerror(errno));
+        return -1;
+    }
+    rewind(run);
+    VERBOSE("Wrote sorted run %zu with %zu records", sorter->runs.size(), sorter->recs.size());
+    merge_sort_clear(sorter);
+    while (1) {
+        size_t num_runs = sorter->runs.size();
+        size_t first = num_runs;
+        while (first > 0 && sorter->run_levels[first - 1] == sorter->run_levels[num_runs - 1]) {
+            first--;
+        }
+        if (num_runs - first < MERGE_SORT_MAX_RUNS) {
+            break;
+        }
+        VERBOSE("Folding %zu sorted runs of level %d", num_runs - first, sorter->run_levels[first]);
+        if (merge_sort_fold(sorter, first) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// take over a converted record (mem is freed by the sorter)
+static int merge_sort_add(merge_sorter_t *sorter, const char *read_id, uint64_t start_time, char *mem, size_t bytes) {
+    merge_sort_rec_t rec;
+    rec.read_id = read_id;
+    rec.start_time = start_time;
+    rec.mem = mem;
+    rec.bytes = bytes;
+    sorter->recs.push_back(rec);
+    sorter->mem_used += bytes + rec.read_id.size() + MERGE_SORT_REC_OVERHEAD;
+    if (sorter->mem_used > sorter->mem_limit) {
+        return merge_sort_spill(sorter);
+    }
+    return 0;
+}
+
+// k-way merge of runs into out, which is a run if to_run is set and the output file otherwise
+// records with equal keys are taken from the earlier run first so that the input order is kept
+static int merge_sort_runs(merge_sorter_t *sorter, const std::vector<FILE *> &runs, FILE *out, int to_run, std::vector<idx_rec_t> *out_idx) {
+    typedef std::pair<merge_sort_rec_t, size_t> head_t;
+    int key = sorter->key;
+    auto after = [key](const head_t &a, const head_t &b) {
+        if (merge_sort_less(key, b.first, a.first)) {
+            return true;
+        }
+        return !merge_sort_less(key, a.first, b.first) && a.second > b.second;
+    };
+    std::priority_queue<head_t, std::vector<head_t>, decltype(after)> heads(after);
+    int ret = 0;
+    for (size_t i = 0; i < runs.size() && ret == 0; i++) {
+        head_t head;
+        head.second = i;
+        int ret_read = merge_sort_rec_read(runs[i], &head.first);
+        if (ret_read < 0) {
+            ret = -1;
+        } else if (ret_read == 1) {
+            heads.push(head);
+        }
+    }
+    while (!heads.empty()) {
+        head_t head = heads.top();
+        heads.pop();
+        if (ret == 0 && merge_sort_emit(out, to_run, out_idx, head.first) < 0) {
+            ret = -1;
+        }
+        free(head.first.mem);
+        if (ret < 0) {
+            continue; // free what is left in the queue
+        }
+        int ret_read = merge_sort_rec_read(runs[head.second], &head.first);
+        if (ret_read < 0) {
+            ret = -1;
+        } else if (ret_read == 1) {
+            heads.push(head);
+        }
+    }
+    for (size_t i = 0; i < runs.size(); i++) {
+        fclose(runs[i]);
+    }
+    return ret;
+}
+
+// write all the records to out in sorted order
+static int merge_sort_finish(merge_sorter_t *sorter, FILE *out, std::vector<idx_rec_t> *out_idx) {
+    if (sorter->runs.empty()) { // everything fitted in memory
+        merge_sort_buffer(sorter);
+        for (size_t i = 0; i < sorter->recs.size(); i++) {
+            if (merge_sort_emit(out, 0, out_idx, sorter->recs[i]) < 0) {
+                return -1;
+            }
+        }
+        merge_sort_clear(sorter);
+        return 0;
+    }
+    if (!sorter->recs.empty() && merge_sort_spill(sorter) < 0) {
+        return -1;
+    }
+    // the runs left open are few enough to be merged at once
+    std::vector<FILE *> runs;
+    runs.swap(sorter->runs);
+    sorter->run_levels.clear();
+    return merge_sort_runs(sorter, runs, out, 0, out_idx);
+}
+
+static void merge_sort_destroy(merge_sorter_t *sorter) {
+    merge_sort_clear(sorter);
+    for (size_t i = 0; i < sorter->runs.size(); i++) {
+        fclose(sorter->runs[i]);
+    }
+    sorter->runs.clear();
+    sorter->run_levels.clear();
+}
+
 int compare_headers(slow5_hdr_t *output_header, slow5_hdr_t *input_header, int64_t output_g, int64_t input_g, const char *i_file_path, char *j_run_id);
 
 void parallel_reads_model(core_t *core, db_t *db, int32_t i) {
@@ -49,6 +595,21 @@ void parallel_reads_model(core_t *core, db_t *db, int32_t i) {
         free(db->mem_records[i]);
     }
     read->read_group = db->list[db->slow5_file_indices[i]][read->read_group]; //write records of the ith slow5file with the updated read_group value
+    if (db->read_id) { // --index, --sort-by or --dedup
+        db->read_id[i] = strdup(read->read_id);
+        MALLOC_CHK(db->read_id[i]);
+    }
+    if (db->dups) { // --dedup
+        merge_dedup_t *dedup = (merge_dedup_t *) core->param;
+        uint64_t seq = dedup->first_seq + i;
+        db->dups[i] = rid_set_claim(dedup->set, read->read_id, seq) < seq;
+        if (db->dups[i] && dedup->mode == MERGE_DEDUP_DROP) { // an earlier record has this read id, no need to convert
+            db->read_record[i].buffer = NULL;
+            db->read_record[i].len = 0;
+            slow5_rec_free(read);
+            return;
+        }
+    }
     struct slow5_press *press_ptr = slow5_press_init(core->press_method);
     if(!press_ptr){
         ERROR("Could not initialize the slow5 compression method%s","");
@@ -66,9 +627,563 @@ void parallel_reads_model(core_t *core, db_t *db, int32_t i) {
     }
     slow5_press_free(press_ptr);
     db->read_record[i].len = len;
+    if (db->start_times) { // --sort-by start_time
+        int err;
+        db->start_times[i] = slow5_aux_get_uint64(read, "start_time", &err);
+        if (err < 0) {
+            ERROR("Could not get the start_time of read %s", read->read_id);
+            exit(EXIT_FAILURE);
+        }
+    }
     slow5_rec_free(read);
 }
 
+// add the read groups and the auxiliary fields of an input header to the output header
+// groups is set to the output read group of each read group of the input
+static int merge_add_header(slow5_hdr_t *out_header, slow5_hdr_t *in_header, const char *path, int lossy,
+                            std::map<std::string, enum slow5_aux_type> &set_aux_attr_pairs,
+                            std::unordered_map<std::string, size_t> &run_id_groups, std::vector<size_t> &groups, int *flag_warnings) {
+    if(lossy==0 && in_header->aux_meta == NULL){
+        ERROR("%s has no auxiliary fields. Specify -l false to merge files with no auxiliary fields.", path);
+        return -1;
+    }
+    if(lossy==0){ // adding aux_fields to the output header
+        slow5_aux_meta_t* aux_ptr = in_header->aux_meta;
+        uint32_t num_aux_attrs = aux_ptr->num;
+        for(uint32_t r=0; r<num_aux_attrs; r++){
+            if(aux_ptr->types[r] == SLOW5_ENUM || aux_ptr->types[r] == SLOW5_ENUM_ARRAY){
+                int aux_avail = -1;
+                if(out_header->aux_meta) {
+                    uint32_t attribute_index;
+                    aux_avail = check_aux_fields_in_header(out_header, aux_ptr->attrs[r], 0, &attribute_index);
+                }
+                if(aux_avail == -1){
+                    uint8_t n;
+                    const char **enum_labels = (const char** )slow5_get_aux_enum_labels(in_header, aux_ptr->attrs[r], &n);
+                    if(!enum_labels){
+                        ERROR("Could not fetch the record attribute '%s' from %s", aux_ptr->attrs[r], path);
+                        return -1;
+                    }
+                    if(slow5_aux_meta_add_enum(out_header->aux_meta, aux_ptr->attrs[r], aux_ptr->types[r], enum_labels, n)){
+                        ERROR("Could not initialize the record attribute '%s' from %s", aux_ptr->attrs[r], path);
+                        return -1;
+                    }
+                } else {
+                    uint8_t n_input;
+                    const char **enum_labels_input = (const char** )slow5_get_aux_enum_labels(in_header, aux_ptr->attrs[r], &n_input);
+                    if(!enum_labels_input){
+                        ERROR("Could not fetch the record attribute '%s' from %s", aux_ptr->attrs[r], path);
+                        return -1;
+                    }
+                    uint8_t n_output;
+                    const char **enum_labels_output = (const char** )slow5_get_aux_enum_labels(out_header, aux_ptr->attrs[r], &n_output);
+                    if(!enum_labels_output){
+                        ERROR("Internal error: Could not fetch the record attribute '%s' from the output header", aux_ptr->attrs[r]);
+                        return -1;
+                    }
+                    if(n_input != n_output){
+                        ERROR("Attribute %s has different number of enum labels in different files", aux_ptr->attrs[r]);
+                        return -1;
+                    }
+                    for(uint8_t i=0; i<n_input; i++){
+                        if(strcmp(enum_labels_input[i],enum_labels_output[i])){
+                            ERROR("Attribute %s has different order/name of the enum labels in different files", aux_ptr->attrs[r]);
+                            return -1;
+                        }
+                    }
+                }
+            }else{
+                set_aux_attr_pairs.insert({std::string(aux_ptr->attrs[r]),aux_ptr->types[r]});
+            }
+        }
+    }
+
+    int64_t read_group_count_i = in_header->num_read_groups; // number of read_groups in ith slow5file
+    std::vector<size_t> read_group_tracker(read_group_count_i); //this array will store the new group_numbers of the ith slow5File, i.e., the new value of jth read_group_number
+    groups.swap(read_group_tracker);
+
+    for(int64_t j=0; j<read_group_count_i; j++){
+        char* run_id_j = slow5_hdr_get("run_id", j, in_header); // run_id of the jth read_group of the ith slow5file
+        if(!run_id_j){
+            ERROR("No run_id found in %s.", path);
+            return -1;
+        }
+        int64_t read_group_count = out_header->num_read_groups; //since this might change during iterating; cannot know beforehand
+        size_t flag_run_id_found = 0;
+        auto found = run_id_groups.find(run_id_j);
+        if(found != run_id_groups.end()){
+            int64_t k = found->second;
+            flag_run_id_found = 1;
+            groups[j] = k; //assumption0: if run_ids are similar the rest of the header attribute values of jth and kth read_groups are similar.
+            *flag_warnings = compare_headers(out_header, in_header, k, j, path, run_id_j);
+        }
+        if(flag_run_id_found == 0){ // time to add a new read_group
+            khash_t(slow5_s2s) *rg = slow5_hdr_get_data(j, in_header); // extract jth read_group related data from ith slow5file
+            int64_t new_read_group = slow5_hdr_add_rg_data(out_header, rg); //assumption0
+            if(new_read_group != read_group_count){ //sanity check
+                ERROR("New read group number is not equal to number of groups; something's wrong\n%s", "");
+                return -1;
+            }
+            groups[j] = new_read_group;
+            run_id_groups[run_id_j] = new_read_group;
+        }
+    }
+    return 0;
+}
+
+typedef struct {
+    const std::vector<std::string> *files;
+    size_t start;
+} merge_open_param_t;
+
+// the records of an input file and how they are encoded, for --pwrite
+typedef struct {
+    off_t records_start;
+    off_t records_end;
+    std::string layout;
+} merge_span_t;
+
+// describe how the records of a file are encoded: the version, the format, the compression and the auxiliary fields
+// the records of a file can be copied as they are to an output with the same layout if its read groups keep their numbers
+static std::string merge_record_layout(struct slow5_version version, enum slow5_fmt format, slow5_press_method_t method, slow5_aux_meta_t *aux_meta) {
+    std::string layout = std::to_string(version.major) + "." + std::to_string(version.minor) + "." + std::to_string(version.patch);
+    layout += " " + std::to_string(format);
+    if (format == SLOW5_FORMAT_BINARY) {
+        layout += " " + std::to_string(method.record_method) + " " + std::to_string(method.signal_method);
+    }
+    if (aux_meta) {
+        for (uint32_t r = 0; r < aux_meta->num; r++) {
+            layout += std::string("\t") + aux_meta->attrs[r] + ":" + std::to_string(aux_meta->types[r]);
+        }
+    }
+    return layout;
+}
+
+// find the records of a file that has just been opened
+static int merge_span(slow5_file_t *file, const char *path, merge_span_t *span) {
+    slow5_press_method_t method = {SLOW5_COMPRESS_NONE, SLOW5_COMPRESS_NONE};
+    if (file->format == SLOW5_FORMAT_BINARY) {
+        method.record_method = file->compress->record_press->method;
+        method.signal_method = file->compress->signal_press->method;
+    }
+    span->layout = merge_record_layout(file->header->version, file->format, method, file->header->aux_meta);
+    span->records_start = ftello(file->fp);
+    struct stat st;
+    if (fstat(fileno(file->fp), &st) != 0) {
+        ERROR("Could not stat %s - %s.", path, strerror(errno));
+        return -1;
+    }
+    const char eof[] = SLOW5_BINARY_EOF;
+    span->records_end = st.st_size - (file->format == SLOW5_FORMAT_BINARY ? sizeof eof : 0);
+    if (span->records_start < 0 || span->records_end < span->records_start) {
+        ERROR("Could not locate the records of %s", path);
+        return -1;
+    }
+    return 0;
+}
+
+// open an input file and parse its header (worker of the header phase)
+static void merge_open_file(core_t *core, db_t *db, int32_t i) {
+    merge_open_param_t *param = (merge_open_param_t *) core->param;
+    db->slow5_file_pointers[i] = slow5_open((*param->files)[param->start + i].c_str(), "r");
+}
+
+// the number of input files that may be open at once in the header phase, leaving room for the readers
+static size_t merge_fd_budget(size_t num_readers) {
+    struct rlimit rlim;
+    size_t limit = MERGE_MAX_OPEN_FILES;
+    if (getrlimit(RLIMIT_NOFILE, &rlim) == 0 && rlim.rlim_cur != RLIM_INFINITY && rlim.rlim_cur < limit) {
+        limit = rlim.rlim_cur;
+    }
+    size_t reserved = MERGE_FD_RESERVE + num_readers;
+    return limit > reserved + 2 ? limit - reserved : 2;
+}
+
+// give the auxiliary fields of the output header the order they have in in_aux if both have the same fields
+// returns 0 on success and -1 if the fields differ
+static int merge_aux_reorder(slow5_hdr_t *out_header, slow5_aux_meta_t *in_aux) {
+    slow5_aux_meta_t *out_aux = out_header->aux_meta;
+    if (!out_aux || !in_aux || out_aux->num != in_aux->num) {
+        return -1;
+    }
+    slow5_aux_meta_t *aux = slow5_aux_meta_init_empty();
+    MALLOC_CHK(aux);
+    for (uint32_t r = 0; r < in_aux->num; r++) {
+        uint32_t pos;
+        int ret;
+        if (check_aux_fields_in_header(out_header, in_aux->attrs[r], 0, &pos) < 0) {
+            slow5_aux_meta_free(aux);
+            return -1;
+        }
+        if (out_aux->types[pos] == SLOW5_ENUM || out_aux->types[pos] == SLOW5_ENUM_ARRAY) {
+            ret = slow5_aux_meta_add_enum(aux, out_aux->attrs[pos], out_aux->types[pos], (const char **) out_aux->enum_labels[pos], out_aux->enum_num_labels[pos]);
+        } else {
+            ret = slow5_aux_meta_add(aux, out_aux->attrs[pos], out_aux->types[pos]);
+        }
+        if (ret) {
+            ERROR("Could not initialize the record attribute '%s'", out_aux->attrs[pos]);
+            slow5_aux_meta_free(aux);
+            return -1;
+        }
+    }
+    out_header->aux_meta = aux;
+    slow5_aux_meta_free(out_aux);
+    return 0;
+}
+
+// check whether the records of all the input files can be copied to the output as they are for --pwrite
+// that is when they all have the layout of the output and their read groups keep their numbers
+// the auxiliary fields of the output header are put in the order of the input files if needed
+// returns 1 if they can, 0 if they cannot
+static int merge_pwrite_check(slow5_hdr_t *out_header, enum slow5_fmt format, slow5_press_method_t method, int lossy,
+                              const std::vector<std::string> &paths, const std::vector<std::vector<size_t>> &list,
+                              const std::vector<merge_span_t> &spans, const std::vector<slow5_file_t *> &cached_files) {
+    for (size_t i = 0; i < list.size(); i++) {
+        for (size_t g = 0; g < list[i].size(); g++) {
+            if (list[i][g] != g) {
+                INFO("The read groups of %s are renumbered in the output. Falling back to converting the records.", paths[i].c_str());
+                return 0;
+            }
+        }
+    }
+    for (size_t i = 1; i < spans.size(); i++) {
+        if (spans[i].layout != spans[0].layout) {
+            INFO("The records of %s are encoded differently from those of %s. Falling back to converting the records.", paths[i].c_str(), paths[0].c_str());
+            return 0;
+        }
+    }
+    if (!lossy && !cached_files.empty() && merge_aux_reorder(out_header, cached_files[0]->header->aux_meta) < 0) {
+        return 0;
+    }
+    if (merge_record_layout(out_header->version, format, method, lossy ? NULL : out_header->aux_meta) != spans[0].layout) {
+        INFO("The records of the input files have to be converted to the output format, compression or auxiliary fields. Falling back to converting the records.%s", "");
+        return 0;
+    }
+    return 1;
+}
+
+typedef struct {
+    const std::vector<std::string> *paths;
+    const std::vector<merge_span_t> *spans;
+    std::vector<off_t> dest; // output offset of the records of each input file
+    std::vector<int> ret;
+    int fd_out;
+} merge_pwrite_param_t;
+
+static void merge_pwrite_file(core_t *core, db_t *db, int32_t i) {
+    merge_pwrite_param_t *param = (merge_pwrite_param_t *) core->param;
+    const char *path = (*param->paths)[i].c_str();
+    const merge_span_t *span = &(*param->spans)[i];
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        ERROR("File '%s' could not be opened - %s.", path, strerror(errno));
+        param->ret[i] = -1;
+        return;
+    }
+    if (copy_range(fd, span->records_start, param->fd_out, param->dest[i], span->records_end - span->records_start) < 0) {
+        ERROR("Could not copy the records of %s - %s.", path, strerror(errno));
+        param->ret[i] = -1;
+    }
+    close(fd);
+}
+
+// copy the records of every input file to its offset in the output with num_threads threads at once
+// the output is left positioned after the last record
+static int merge_pwrite(FILE *out, const char *out_path, const std::vector<std::string> &paths, const std::vector<merge_span_t> &spans, int32_t num_threads) {
+    if (fflush(out) == EOF) {
+        ERROR("Could not write to %s - %s.", out_path, strerror(errno));
+        return -1;
+    }
+    merge_pwrite_param_t param;
+    param.paths = &paths;
+    param.spans = &spans;
+    param.fd_out = fileno(out);
+    param.ret.assign(paths.size(), 0);
+    off_t offset = ftello(out);
+    for (size_t i = 0; i < spans.size(); i++) {
+        param.dest.push_back(offset);
+        offset += spans[i].records_end - spans[i].records_start;
+    }
+    core_t core;
+    core.num_thread = num_threads;
+    core.param = &param;
+    db_t db = { 0 };
+    db.n_batch = paths.size();
+    work_db(&core, &db, merge_pwrite_file);
+    for (size_t i = 0; i < param.ret.size(); i++) {
+        if (param.ret[i] < 0) {
+            return -1;
+        }
+    }
+    if (fseeko(out, offset, SEEK_SET) != 0) {
+        ERROR("Could not seek in %s - %s.", out_path, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+// build the output header from the headers of all the input files
+// the files are opened by a pool of threads, a window at a time, and their headers are added in the order of the files
+// with a run_id to read group map. The files opened first are kept open (cached_files) to be read without reopening
+static int merge_collect_headers(const std::vector<std::string> &files, slow5_hdr_t *out_header, opt_t *user_opts, size_t num_readers,
+                                 std::map<std::string, enum slow5_aux_type> &set_aux_attr_pairs,
+                                 std::vector<std::string> &slow5_files, std::vector<std::vector<size_t>> &list,
+                                 std::vector<slow5_file_t *> &cached_files, int *flag_warnings, std::vector<merge_span_t> *spans) {
+    size_t budget = merge_fd_budget(num_readers);
+    size_t window = budget / 2;
+    size_t cache_cap = budget - window;
+    std::unordered_map<std::string, size_t> run_id_groups;
+
+    merge_open_param_t param;
+    param.files = &files;
+    core_t core;
+    core.num_thread = user_opts->num_threads;
+    core.param = &param;
+    db_t db = { 0 };
+    db.slow5_file_pointers = (slow5_file_t **) malloc(window * sizeof *db.slow5_file_pointers);
+    MALLOC_CHK(db.slow5_file_pointers);
+
+    int ret = 0;
+    for (size_t start = 0; start < files.size(); start += window) {
+        param.start = start;
+        db.n_batch = files.size() - start < window ? files.size() - start : window;
+        work_db(&core, &db, merge_open_file);
+
+        for (int64_t i = 0; i < db.n_batch; i++) {
+            const char *path = files[start + i].c_str();
+            slow5_file_t *slow5File_i = db.slow5_file_pointers[i];
+            DEBUG("input file\t%s", path);
+            if (ret < 0) {
+                if (slow5File_i) {
+                    slow5_close(slow5File_i);
+                }
+                continue;
+            }
+            if(!slow5File_i){
+                ERROR("[Skip file]: cannot open %s. skipping.\n", path);
+                continue;
+            }
+            std::vector<size_t> groups;
+            if (merge_add_header(out_header, slow5File_i->header, path, user_opts->flag_lossy, set_aux_attr_pairs, run_id_groups, groups, flag_warnings) < 0) {
+                slow5_close(slow5File_i);
+                ret = -1;
+                continue;
+            }
+            if (spans) {
+                merge_span_t span;
+                if (merge_span(slow5File_i, path, &span) < 0) {
+                    slow5_close(slow5File_i);
+                    ret = -1;
+                    continue;
+                }
+                spans->push_back(span);
+            }
+            list.push_back(groups);
+            slow5_files.push_back(files[start + i]);
+            if (cached_files.size() < cache_cap) {
+                cached_files.push_back(slow5File_i);
+            } else {
+                slow5_close(slow5File_i);
+            }
+        }
+    }
+    free(db.slow5_file_pointers);
+    if (ret < 0) {
+        for (size_t i = 0; i < cached_files.size(); i++) {
+            slow5_close(cached_files[i]);
+        }
+        cached_files.clear();
+    }
+    return ret;
+}
+
+#define MERGE_TREE_EXT ".merge_tree" // intermediate files of --fan-in are kept in OUTPUT.merge_tree until the output is written
+
+int merge_main(int argc, char **argv, struct program_meta *meta);
+
+// settings of the merges of the intermediate levels of --fan-in
+typedef struct {
+    const char *exe;
+    int32_t num_processes;
+    int32_t num_threads;
+    int64_t batch_size;
+    size_t num_readers;
+    int lossy;
+    int continue_merge;
+} merge_tree_opt_t;
+
+// a level is resumed only if it was started from the same files and fan-in
+static uint64_t merge_tree_manifest(const std::vector<std::string> &files, size_t fan_in) {
+    uint64_t hash = 0xcbf29ce484222325ULL; // FNV-1a
+    for (size_t i = 0; i < files.size(); i++) {
+        for (size_t j = 0; j <= files[i].size(); j++) { // the terminating '\0' separates the paths
+            hash ^= (unsigned char) files[i].c_str()[j];
+            hash *= 0x100000001b3ULL;
+        }
+    }
+    return hash ^ fan_in;
+}
+
+static int merge_tree_mkdir(const std::string &dir) {
+    if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        ERROR("Could not create the directory '%s' - %s.", dir.c_str(), strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+// check or write the manifest of a level
+static int merge_tree_level_start(const std::string &dir, const std::vector<std::string> &files, size_t fan_in) {
+    std::string path = dir + "/manifest";
+    uint64_t manifest = merge_tree_manifest(files, fan_in);
+    FILE *fp = fopen(path.c_str(), "r");
+    if (fp) {
+        unsigned long long found = 0;
+        int ret = fscanf(fp, "%llu", &found);
+        fclose(fp);
+        if (ret != 1 || found != manifest) {
+            ERROR("'%s' holds intermediate files of a merge of different input files or with a different --fan-in. Remove it to start again.", dir.c_str());
+            return -1;
+        }
+        INFO("Resuming the intermediate merges in '%s'", dir.c_str());
+        return 0;
+    }
+    fp = fopen(path.c_str(), "w");
+    F_CHK(fp, path.c_str());
+    fprintf(fp, "%llu\n", (unsigned long long) manifest);
+    if (fclose(fp) == EOF) {
+        ERROR("Could not write '%s' - %s.", path.c_str(), strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+// merge files[first, last) to out_path in a child process by running merge on them
+static pid_t merge_tree_fork(const merge_tree_opt_t *opt, const std::vector<std::string> &files, size_t first, size_t last,
+                             const std::string &out_path, struct program_meta *meta) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid != 0) {
+        if (pid < 0) {
+            ERROR("Forking processes failed - %s.", strerror(errno));
+        }
+        return pid;
+    }
+    // child: the intermediate files are BLOW5 with fast compression as they are read again straight away
+    std::vector<std::string> args = {opt->exe, "-o", out_path, "-c", "none", "-s", "svb-zd",
+                                     "-t", std::to_string(opt->num_threads), "-K", std::to_string(opt->batch_size),
+                                     "--readers", std::to_string(opt->num_readers)};
+    if (opt->lossy) {
+        args.push_back("-l");
+        args.push_back("false");
+    }
+    if (opt->continue_merge) {
+        args.push_back("-a");
+    }
+    args.insert(args.end(), files.begin() + first, files.begin() + last);
+    std::vector<char *> child_argv;
+    for (size_t i = 0; i < args.size(); i++) {
+        child_argv.push_back(&args[i][0]);
+    }
+    child_argv.push_back(NULL);
+    optind = 1;
+    exit(merge_main(child_argv.size() - 1, child_argv.data(), meta));
+}
+
+// merge the files in groups of fan_in, in parallel, into intermediate files, level after level, until at most fan_in files remain
+// files is replaced by the files left to merge into the output
+// groups whose intermediate file was written by an earlier run of the same merge are not merged again
+static int merge_tree(std::vector<std::string> &files, size_t fan_in, const std::string &tree_dir, const merge_tree_opt_t *opt,
+                      struct program_meta *meta) {
+    if (merge_tree_mkdir(tree_dir) < 0) {
+        return -1;
+    }
+    for (int level = 0; files.size() > fan_in; level++) {
+        double realtime = slow5_realtime();
+        std::string dir = tree_dir + "/level" + std::to_string(level);
+        if (merge_tree_mkdir(dir) < 0 || merge_tree_level_start(dir, files, fan_in) < 0) {
+            return -1;
+        }
+        size_t num_groups = (files.size() + fan_in - 1) / fan_in;
+        std::vector<std::string> outputs;
+        std::vector<size_t> pending;
+        for (size_t g = 0; g < num_groups; g++) {
+            outputs.push_back(dir + "/" + std::to_string(g) + ".blow5");
+            struct stat st;
+            if (stat(outputs[g].c_str(), &st) != 0) {
+                pending.push_back(g);
+            }
+        }
+        VERBOSE("Level %d: merging %zu files in %zu groups (%zu already merged)", level, files.size(), num_groups, num_groups - pending.size());
+
+        std::map<pid_t, size_t> running;
+        size_t next = 0;
+        int ret = 0;
+        while (running.size() > 0 || (next < pending.size() && ret == 0)) {
+            if (next < pending.size() && ret == 0 && running.size() < (size_t) opt->num_processes) {
+                size_t g = pending[next++];
+                size_t first = g * fan_in;
+                size_t last = first + fan_in < files.size() ? first + fan_in : files.size();
+                pid_t pid = merge_tree_fork(opt, files, first, last, outputs[g] + ".tmp.blow5", meta);
+                if (pid < 0) {
+                    ret = -1;
+                } else {
+                    running[pid] = g;
+                }
+                continue;
+            }
+            int status;
+            pid_t pid = waitpid(-1, &status, 0);
+            if (pid < 0) {
+                ERROR("Waitpid failed - %s.", strerror(errno));
+                return -1;
+            }
+            auto it = running.find(pid);
+            if (it == running.end()) {
+                continue;
+            }
+            size_t g = it->second;
+            running.erase(it);
+            std::string tmp_path = outputs[g] + ".tmp.blow5";
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                ERROR("Merging group %zu of level %d into '%s' failed.", g, level, tmp_path.c_str());
+                ret = -1;
+            } else if (rename(tmp_path.c_str(), outputs[g].c_str()) != 0) {
+                ERROR("Could not rename '%s' - %s.", tmp_path.c_str(), strerror(errno));
+                ret = -1;
+            }
+        }
+        if (ret < 0) {
+            return -1;
+        }
+        VERBOSE("Level %d merged - took %.3fs", level, slow5_realtime() - realtime);
+        files.swap(outputs);
+    }
+    return 0;
+}
+
+// remove the intermediate files once the output is written
+static void merge_tree_remove(const std::string &tree_dir) {
+    for (int level = 0; ; level++) {
+        std::string dir = tree_dir + "/level" + std::to_string(level);
+        DIR *dp = opendir(dir.c_str());
+        if (!dp) {
+            break;
+        }
+        struct dirent *ep;
+        while ((ep = readdir(dp)) != NULL) {
+            if (strcmp(ep->d_name, ".") && strcmp(ep->d_name, "..")) {
+                unlink((dir + "/" + ep->d_name).c_str());
+            }
+        }
+        closedir(dp);
+        rmdir(dir.c_str());
+    }
+    if (rmdir(tree_dir.c_str()) != 0) {
+        WARNING("Could not remove '%s' - %s.", tree_dir.c_str(), strerror(errno));
+    }
+}
+
 int merge_main(int argc, char **argv, struct program_meta *meta){
 
     // Debug: print arguments
@@ -91,17 +1206,33 @@ int merge_main(int argc, char **argv, struct program_meta *meta){
             {"allow", no_argument, NULL, 'a'},               //6
             {"output", required_argument, NULL, 'o'},        //7
             {"batchsize", required_argument, NULL, 'K'},     //8
+            {"index", no_argument, NULL, 0},                 //9
+            {"readers", required_argument, NULL, 0},         //10
+            {"sort-by", required_argument, NULL, 0},         //11
+            {"sort-mem", required_argument, NULL, 0},        //12
+            {"dedup", optional_argument, NULL, 0},           //13
+            {"pwrite", no_argument, NULL, 0},                //14
+            {"fan-in", required_argument, NULL, 0},          //15
+            {"iop", required_argument, NULL, 'p'},           //16
             {NULL, 0, NULL, 0 }
     };
 
     opt_t user_opts;
     init_opt(&user_opts);
+    const char *arg_readers = NULL;
+    size_t num_readers = DEFAULT_MERGE_READERS;
+    int sort_key = MERGE_SORT_NONE;
+    const char *arg_sort_mem = DEFAULT_MERGE_SORT_MEM;
+    int dedup_mode = MERGE_DEDUP_NONE;
+    int flag_pwrite = 0;
+    const char *arg_fan_in = NULL;
+    size_t fan_in = 0;
 
     int opt;
     int longindex = 0;
 
     // Parse options
-    while ((opt = getopt_long(argc, argv, "c:s:ht:o:aK:", long_opts, &longindex)) != -1) {
+    while ((opt = getopt_long(argc, argv, "c:s:ht:o:aK:p:", long_opts, &longindex)) != -1) {
         DEBUG("opt='%c', optarg=\"%s\", optind=%d, opterr=%d, optopt='%c'",
                   opt, optarg, optind, opterr, optopt);
         switch (opt) {
@@ -129,6 +1260,9 @@ int merge_main(int argc, char **argv, struct program_meta *meta){
             case 'K':
                 user_opts.arg_batch = optarg;
                 break;
+            case 'p':
+                user_opts.arg_num_processes = optarg;
+                break;
             case 0  :
                 switch (longindex) {
                     case 2:
@@ -137,6 +1271,40 @@ int merge_main(int argc, char **argv, struct program_meta *meta){
                     case 5:
                         user_opts.arg_lossless = optarg;
                         break;
+                    case 9:
+                        user_opts.flag_index = 1;
+                        break;
+                    case 10:
+                        arg_readers = optarg;
+                        break;
+                    case 11:
+                        if ((sort_key = merge_sort_parse_key(optarg)) < 0) {
+                            fprintf(stderr, HELP_SMALL_MSG, argv[0]);
+                            EXIT_MSG(EXIT_FAILURE, argv, meta);
+                            return EXIT_FAILURE;
+                        }
+                        break;
+                    case 12:
+                        arg_sort_mem = optarg;
+                        break;
+                    case 13:
+                        if (optarg == NULL || strcmp(optarg, "drop") == 0) {
+                            dedup_mode = MERGE_DEDUP_DROP;
+                        } else if (strcmp(optarg, "report") == 0) {
+                            dedup_mode = MERGE_DEDUP_REPORT;
+                        } else {
+                            ERROR("invalid dedup mode -- '%s' (expected drop or report)", optarg);
+                            fprintf(stderr, HELP_SMALL_MSG, argv[0]);
+                            EXIT_MSG(EXIT_FAILURE, argv, meta);
+                            return EXIT_FAILURE;
+                        }
+                        break;
+                    case 14:
+                        flag_pwrite = 1;
+                        break;
+                    case 15:
+                        arg_fan_in = optarg;
+                        break;
                 }
                 break;
             default: // case '?'
@@ -153,6 +1321,10 @@ int merge_main(int argc, char **argv, struct program_meta *meta){
         EXIT_MSG(EXIT_FAILURE, argv, meta);
         return EXIT_FAILURE;
     }
+    if(parse_num_processes(&user_opts,argc,argv,meta) < 0){
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
     if(parse_arg_lossless(&user_opts, argc, argv, meta) < 0){
         EXIT_MSG(EXIT_FAILURE, argv, meta);
         return EXIT_FAILURE;
@@ -169,6 +1341,45 @@ int merge_main(int argc, char **argv, struct program_meta *meta){
         EXIT_MSG(EXIT_FAILURE, argv, meta);
         return EXIT_FAILURE;
     }
+    if (arg_readers) {
+        char *endptr;
+        long ret = strtol(arg_readers, &endptr, 10);
+        if (*endptr != '\0' || ret < 1) {
+            ERROR("invalid number of readers -- '%s'", arg_readers);
+            fprintf(stderr, HELP_SMALL_MSG, argv[0]);
+            EXIT_MSG(EXIT_FAILURE, argv, meta);
+            return EXIT_FAILURE;
+        }
+        num_readers = ret;
+    }
+    if (arg_fan_in) {
+        char *endptr;
+        long ret = strtol(arg_fan_in, &endptr, 10);
+        if (*endptr != '\0' || ret < 2) {
+            ERROR("invalid fan-in -- '%s' (at least 2 files)", arg_fan_in);
+            fprintf(stderr, HELP_SMALL_MSG, argv[0]);
+            EXIT_MSG(EXIT_FAILURE, argv, meta);
+            return EXIT_FAILURE;
+        }
+        fan_in = ret;
+        size_t budget = merge_fd_budget(num_readers);
+        if (fan_in > budget) {
+            WARNING("--fan-in %zu is above what the open file limit (ulimit -n) allows. Using %zu.", fan_in, budget);
+            fan_in = budget;
+        }
+    }
+    int64_t sort_mem = parse_size(arg_sort_mem);
+    if (sort_mem <= 0) {
+        ERROR("invalid sort memory -- '%s'", arg_sort_mem);
+        fprintf(stderr, HELP_SMALL_MSG, argv[0]);
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
+    if (sort_key == MERGE_SORT_START_TIME && user_opts.flag_lossy) {
+        ERROR("--sort-by start_time needs the auxiliary fields. Do not use -l false.%s", "");
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
 
     // Check for remaining files to parse
     if (optind >= argc) {
@@ -177,6 +1388,26 @@ int merge_main(int argc, char **argv, struct program_meta *meta){
         EXIT_MSG(EXIT_FAILURE, argv, meta);
         return EXIT_FAILURE;
     }
+    if (user_opts.flag_index && user_opts.arg_fname_out == NULL) {
+        ERROR("--index requires an output file (-o)%s", "");
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
+    if (fan_in && user_opts.arg_fname_out == NULL) {
+        ERROR("--fan-in requires an output file (-o)%s", "");
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
+    if (flag_pwrite && user_opts.arg_fname_out == NULL) {
+        ERROR("--pwrite requires an output file (-o)%s", "");
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
+    if (flag_pwrite && (sort_key != MERGE_SORT_NONE || dedup_mode != MERGE_DEDUP_NONE)) {
+        ERROR("--pwrite cannot be used with --sort-by or --dedup as they need every record%s", "");
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
 
     //measure file listing time
     double realtime0 = slow5_realtime();
@@ -191,6 +1422,24 @@ int merge_main(int argc, char **argv, struct program_meta *meta){
         return EXIT_FAILURE;
     }
 
+    std::string tree_dir;
+    if (fan_in && files.size() > fan_in) {
+        tree_dir = std::string(user_opts.arg_fname_out) + MERGE_TREE_EXT;
+        merge_tree_opt_t tree_opt;
+        tree_opt.exe = argv[0];
+        tree_opt.num_processes = user_opts.num_processes;
+        tree_opt.num_threads = user_opts.num_threads / user_opts.num_processes > 0 ? user_opts.num_threads / user_opts.num_processes : 1;
+        tree_opt.batch_size = user_opts.read_id_batch_capacity;
+        tree_opt.num_readers = num_readers;
+        tree_opt.lossy = user_opts.flag_lossy;
+        tree_opt.continue_merge = user_opts.flag_continue_merge;
+        if (merge_tree(files, fan_in, tree_dir, &tree_opt, meta) < 0) {
+            ERROR("The intermediate files are kept in '%s'. Run the same command again to resume.", tree_dir.c_str());
+            EXIT_MSG(EXIT_FAILURE, argv, meta);
+            return EXIT_FAILURE;
+        }
+    }
+
     //determine new read group numbers
     //measure read_group number allocation time
     realtime0 = slow5_realtime();
@@ -224,116 +1473,13 @@ int merge_main(int argc, char **argv, struct program_meta *meta){
     }
     slow5File->header->num_read_groups = 0;
     std::vector<std::vector<size_t>> list;
-    size_t index = 0;
     std::vector<std::string> slow5_files;
-    size_t num_files = files.size();
-
+    std::vector<slow5_file_t *> cached_files;
     int flag_warnings_occured = 0;
-
-    for(size_t i=0; i<num_files; i++) { //iterate over slow5files
-        DEBUG("input file\t%s", files[i].c_str());
-
-        slow5_file_t* slow5File_i = slow5_open(files[i].c_str(), "r");
-        if(!slow5File_i){
-            ERROR("[Skip file]: cannot open %s. skipping.\n",files[i].c_str());
-            continue;
-        }
-        if(user_opts.flag_lossy==0 && slow5File_i->header->aux_meta == NULL){
-            ERROR("%s has no auxiliary fields. Specify -l false to merge files with no auxiliary fields.", files[i].c_str());
-            slow5_close(slow5File_i);
-            return EXIT_FAILURE;
-        }
-        if(user_opts.flag_lossy==0){ // adding aux_fields to the output header
-            slow5_aux_meta_t* aux_ptr = slow5File_i->header->aux_meta;
-            uint32_t num_aux_attrs = aux_ptr->num;
-            for(uint32_t r=0; r<num_aux_attrs; r++){
-                if(aux_ptr->types[r] == SLOW5_ENUM || aux_ptr->types[r] == SLOW5_ENUM_ARRAY){
-                    int aux_avail = -1;
-                    if(slow5File->header->aux_meta) {
-                        uint32_t attribute_index;
-                        aux_avail = check_aux_fields_in_header(slow5File->header, aux_ptr->attrs[r], 0, &attribute_index);
-                    }
-                    if(aux_avail == -1){
-                        uint8_t n;
-                        const char **enum_labels = (const char** )slow5_get_aux_enum_labels(slow5File_i->header, aux_ptr->attrs[r], &n);
-                        if(!enum_labels){
-                            ERROR("Could not fetch the record attribute '%s' from %s", aux_ptr->attrs[r], files[i].c_str());
-                            return EXIT_FAILURE;
-                        }
-                        if(slow5_aux_meta_add_enum(slow5File->header->aux_meta, aux_ptr->attrs[r], aux_ptr->types[r], enum_labels, n)){
-                            ERROR("Could not initialize the record attribute '%s' from %s", aux_ptr->attrs[r], files[i].c_str());
-                            return EXIT_FAILURE;
-                        }
-                    } else {
-                        uint8_t n_input;
-                        const char **enum_labels_input = (const char** )slow5_get_aux_enum_labels(slow5File_i->header, aux_ptr->attrs[r], &n_input);
-                        if(!enum_labels_input){
-                            ERROR("Could not fetch the record attribute '%s' from %s", aux_ptr->attrs[r], files[i].c_str());
-                            return EXIT_FAILURE;
-                        }
-                        uint8_t n_output;
-                        const char **enum_labels_output = (const char** )slow5_get_aux_enum_labels(slow5File->header, aux_ptr->attrs[r], &n_output);
-                        if(!enum_labels_output){
-                            ERROR("Internal error: Could not fetch the record attribute '%s' from the output header", aux_ptr->attrs[r]);
-                            return EXIT_FAILURE;
-                        }
-                        if(n_input != n_output){
-                            ERROR("Attribute %s has different number of enum labels in different files", aux_ptr->attrs[r]);
-                            return EXIT_FAILURE;
-                        }
-                        for(uint8_t i=0; i<n_input; i++){
-                            if(strcmp(enum_labels_input[i],enum_labels_output[i])){
-                                ERROR("Attribute %s has different order/name of the enum labels in different files", aux_ptr->attrs[r]);
-                                return EXIT_FAILURE;
-                            }
-                        }
-                    }
-                }else{
-                    set_aux_attr_pairs.insert({std::string(aux_ptr->attrs[r]),aux_ptr->types[r]});
-                }
-            }
-        }
-
-        int64_t read_group_count_i = slow5File_i->header->num_read_groups; // number of read_groups in ith slow5file
-        std::vector<size_t> read_group_tracker(read_group_count_i); //this array will store the new group_numbers of the ith slow5File, i.e., the new value of jth read_group_number
-        list.push_back(read_group_tracker);
-
-        for(int64_t j=0; j<read_group_count_i; j++){
-            char* run_id_j = slow5_hdr_get("run_id", j, slow5File_i->header); // run_id of the jth read_group of the ith slow5file
-            if(!run_id_j){
-                ERROR("No run_id found in %s.", files[i].c_str());
-                return EXIT_FAILURE;
-            }
-            int64_t read_group_count = slow5File->header->num_read_groups; //since this might change during iterating; cannot know beforehand
-            size_t flag_run_id_found = 0;
-            for(int64_t k=0; k<read_group_count; k++){
-                char* run_id_k = slow5_hdr_get("run_id", k, slow5File->header);
-                if(!run_id_k){
-                    ERROR("No run_id information found in %s.", files[i].c_str());
-                    return EXIT_FAILURE;
-                }
-                if(strcmp(run_id_j,run_id_k) == 0){
-                    flag_run_id_found = 1;
-                    list[index][j] = k; //assumption0: if run_ids are similar the rest of the header attribute values of jth and kth read_groups are similar.
-                    flag_warnings_occured = compare_headers(slow5File->header, slow5File_i->header, k, j, files[i].c_str(),
-                                                            run_id_j);
-                    break;
-                }
-            }
-            if(flag_run_id_found == 0){ // time to add a new read_group
-                khash_t(slow5_s2s) *rg = slow5_hdr_get_data(j, slow5File_i->header); // extract jth read_group related data from ith slow5file
-                int64_t new_read_group = slow5_hdr_add_rg_data(slow5File->header, rg); //assumption0
-                if(new_read_group != read_group_count){ //sanity check
-                    ERROR("New read group number is not equal to number of groups; something's wrong\n%s", "");
-                    return EXIT_FAILURE;
-                }
-                list[index][j] = new_read_group;
-            }
-        }
-        slow5_close(slow5File_i);
-        index++;
-        slow5_files.push_back(files[i]);
-
+    std::vector<merge_span_t> spans;
+    if (merge_collect_headers(files, slow5File->header, &user_opts, num_readers, set_aux_attr_pairs, slow5_files, list, cached_files, &flag_warnings_occured,
+                              flag_pwrite ? &spans : NULL) < 0) {
+        return EXIT_FAILURE;
     }
 
     if(flag_warnings_occured == 1 && user_opts.flag_continue_merge == DEFAULT_CONTINUE_MERGE){
@@ -354,15 +1500,59 @@ int merge_main(int argc, char **argv, struct program_meta *meta){
         ERROR("No slow5/blow5 files found for conversion. Exiting.%s","");
         return EXIT_FAILURE;
     }
+    if (sort_key == MERGE_SORT_START_TIME && set_aux_attr_pairs.find("start_time") == set_aux_attr_pairs.end()) {
+        ERROR("--sort-by start_time needs the auxiliary field start_time, which the input files do not have.%s", "");
+        return EXIT_FAILURE;
+    }
     VERBOSE("Allocating new read group numbers - took %.3fs\n",slow5_realtime() - realtime0);
 
     //now write the header to the slow5File. Use Binary non compress method for fast writing
     slow5_press_method_t method = {user_opts.record_press_out, user_opts.signal_press_out};
+    if (flag_pwrite) {
+        flag_pwrite = merge_pwrite_check(slow5File->header, user_opts.fmt_out, method, user_opts.flag_lossy, slow5_files, list, spans, cached_files);
+    }
     if(slow5_hdr_fwrite(slow5File->fp, slow5File->header, user_opts.fmt_out, method) == -1){
         ERROR("Could not write the header to %s\n", user_opts.arg_fname_out);
         return EXIT_FAILURE;
     }
 
+    if (flag_pwrite) { // the records are copied as they are, so no pool and no conversion
+        for (size_t i = 0; i < cached_files.size(); i++) {
+            slow5_close(cached_files[i]);
+        }
+        double realtime = slow5_realtime();
+        if (merge_pwrite(slow5File->fp, user_opts.arg_fname_out, slow5_files, spans, user_opts.num_threads) < 0) {
+            return EXIT_FAILURE;
+        }
+        DEBUG("time_pwrite\t%.3fs", slow5_realtime() - realtime);
+        if (user_opts.fmt_out == SLOW5_FORMAT_BINARY) {
+            slow5_eof_fwrite(slow5File->fp);
+        }
+        slow5_close(slow5File);
+
+        if (user_opts.flag_index) { // record offsets are only known once written, so the output is indexed like slow5tools index does
+            std::vector<idx_rec_t> idx_entries;
+            slow5_file_t *written = slow5_open(user_opts.arg_fname_out, "r");
+            if (!written) {
+                ERROR("File '%s' could not be opened to write its index.", user_opts.arg_fname_out);
+                EXIT_MSG(EXIT_FAILURE, argv, meta);
+                return EXIT_FAILURE;
+            }
+            int ret_build = idx_build(written, user_opts.num_threads, user_opts.read_id_batch_capacity, idx_entries);
+            slow5_close(written);
+            if (ret_build < 0 || idx_finish(user_opts.arg_fname_out, idx_entries) < 0) {
+                idx_entries_free(idx_entries);
+                EXIT_MSG(EXIT_FAILURE, argv, meta);
+                return EXIT_FAILURE;
+            }
+        }
+        if (!tree_dir.empty()) {
+            merge_tree_remove(tree_dir);
+        }
+        EXIT_MSG(EXIT_SUCCESS, argv, meta);
+        return EXIT_SUCCESS;
+    }
+
     double time_get_to_mem = 0;
     double time_thread_execution = 0;
     int flag_end_of_records = 0;
@@ -370,16 +1560,22 @@ int merge_main(int argc, char **argv, struct program_meta *meta){
 
     int64_t batch_size = user_opts.read_id_batch_capacity;
     size_t slow5_file_index = 0;
-    std::queue<struct slow5_file*> open_files_pointers;
     std::vector<int> slow5_file_indices(batch_size);
 
-    struct slow5_file *from = slow5_open(slow5_files[slow5_file_index].c_str(), "r");
-    if (from == NULL) {
-        ERROR("File '%s' could not be opened - %s.", slow5_files[slow5_file_index].c_str(), strerror(errno));
-        return EXIT_FAILURE;
+    // the input files are opened and read ahead by a pool of readers while the records taken so far are processed
+    merge_pool_t pool;
+    merge_pool_init(&pool, slow5_files, cached_files, num_readers, batch_size);
+    merge_chunk_t chunk;
+    size_t chunk_pos = 0;
+    std::vector<idx_rec_t> idx_entries;
+    merge_sorter_t sorter;
+    merge_sort_init(&sorter, sort_key, sort_mem, user_opts.arg_fname_out);
+    rid_set_t dedup_set;
+    merge_dedup_t dedup = { &dedup_set, 0, dedup_mode };
+    uint64_t num_dups = 0;
+    if (dedup_mode != MERGE_DEDUP_NONE) {
+        rid_set_init(&dedup_set);
     }
-    open_files_pointers.push(from);
-    size_t open_file_from = slow5_file_index;
     while(1) {
         db_t db = { 0 };
         db.mem_records = (char **) malloc(batch_size * sizeof(char*));
@@ -391,35 +1587,34 @@ int merge_main(int argc, char **argv, struct program_meta *meta){
         MALLOC_CHK(db.slow5_file_pointers);
 
         int64_t record_count = 0;
-        size_t bytes;
-        char *mem;
         double realtime = slow5_realtime();
         while (record_count < batch_size) {
-            if (!(mem = (char *) slow5_get_next_mem(&bytes, from))) {
-                if (slow5_errno != SLOW5_ERR_EOF) {
+            if (chunk_pos == chunk.mem.size()) {
+                chunk_pos = 0;
+                chunk.mem.clear();
+                chunk.bytes.clear();
+                int ret_take = merge_pool_take(&pool, slow5_file_index, &chunk);
+                if (ret_take < 0) {
+                    merge_pool_destroy(&pool);
                     return EXIT_FAILURE;
-                } else { //EOF file reached
+                } else if (ret_take == 0) { //EOF file reached
                     slow5_file_index++;
                     if(slow5_file_index == slow5_files.size()){
                         flag_end_of_records = 1;
                         break;
-                    }else{
-                        from = slow5_open(slow5_files[slow5_file_index].c_str(), "r");
-                        if (from == NULL) {
-                            ERROR("File '%s' could not be opened - %s.", slow5_files[slow5_file_index].c_str(), strerror(errno));
-                            return EXIT_FAILURE;
-                        }
-                        open_files_pointers.push(from);
                     }
-                    continue;
+                    if (slow5_file_index >= pool.window_start + pool.num_open) {
+                        break; // the next file is opened once the files of this batch are closed
+                    }
                 }
-            } else {
-                db.mem_records[record_count] = mem;
-                db.mem_bytes[record_count] = bytes;
-                db.slow5_file_pointers[record_count] = from;
-                slow5_file_indices[record_count] = slow5_file_index;
-                record_count++;
+                continue;
             }
+            db.mem_records[record_count] = chunk.mem[chunk_pos];
+            db.mem_bytes[record_count] = chunk.bytes[chunk_pos];
+            db.slow5_file_pointers[record_count] = pool.inputs[slow5_file_index].file;
+            slow5_file_indices[record_count] = slow5_file_index;
+            chunk_pos++;
+            record_count++;
         }
 
         time_get_to_mem += slow5_realtime() - realtime;
@@ -431,17 +1626,67 @@ int merge_main(int argc, char **argv, struct program_meta *meta){
         core.format_out = user_opts.fmt_out;
         core.press_method = method;
         core.lossy = user_opts.flag_lossy;
+        core.param = &dedup;
 
         db.n_batch = record_count;
         db.read_record = (raw_record_t*) malloc(record_count * sizeof *db.read_record);
         MALLOC_CHK(db.read_record);
         db.list = list;
         db.slow5_file_indices = slow5_file_indices;
+        if (user_opts.flag_index || sort_key != MERGE_SORT_NONE || dedup_mode != MERGE_DEDUP_NONE) {
+            db.read_id = (char **) malloc(record_count * sizeof *db.read_id);
+            MALLOC_CHK(db.read_id);
+        }
+        if (sort_key == MERGE_SORT_START_TIME) {
+            db.start_times = (uint64_t *) malloc(record_count * sizeof *db.start_times);
+            MALLOC_CHK(db.start_times);
+        }
+        if (dedup_mode != MERGE_DEDUP_NONE) {
+            db.dups = (uint8_t *) malloc(record_count * sizeof *db.dups);
+            MALLOC_CHK(db.dups);
+        }
         work_db(&core,&db,parallel_reads_model);
         time_thread_execution += slow5_realtime() - realtime;
 
         realtime = slow5_realtime();
         for (int64_t i = 0; i < record_count; i++) {
+            if (db.dups) {
+                // a record that was first to claim its read id can still lose it to an earlier record of the same batch
+                if (!db.dups[i] && rid_set_get(&dedup_set, db.read_id[i]) != dedup.first_seq + i) {
+                    db.dups[i] = 1;
+                }
+                if (db.dups[i]) {
+                    num_dups++;
+                    if (dedup_mode == MERGE_DEDUP_REPORT) {
+                        WARNING("Duplicate read id %s in %s", db.read_id[i], slow5_files[slow5_file_indices[i]].c_str());
+                    } else {
+                        free(db.read_id[i]);
+                        free(db.read_record[i].buffer);
+                        continue;
+                    }
+                }
+            }
+            if (sort_key != MERGE_SORT_NONE) { // written in order by merge_sort_finish
+                uint64_t start_time = db.start_times ? db.start_times[i] : 0;
+                int ret_sort = merge_sort_add(&sorter, db.read_id[i], start_time, (char *) db.read_record[i].buffer, db.read_record[i].len);
+                free(db.read_id[i]);
+                if (ret_sort < 0) {
+                    for (int64_t j = i + 1; j < record_count; j++) {
+                        free(db.read_id[j]);
+                        free(db.read_record[j].buffer);
+                    }
+                    merge_sort_destroy(&sorter);
+                    merge_pool_destroy(&pool);
+                    return EXIT_FAILURE;
+                }
+                continue;
+            }
+            if (user_opts.flag_index) {
+                idx_add(idx_entries, db.read_id[i], ftello(slow5File->fp), db.read_record[i].len);
+            }
+            if (db.read_id) {
+                free(db.read_id[i]);
+            }
             fwrite(db.read_record[i].buffer,1,db.read_record[i].len,slow5File->fp);
             free(db.read_record[i].buffer);
         }
@@ -452,19 +1697,34 @@ int merge_main(int argc, char **argv, struct program_meta *meta){
         free(db.mem_records);
         free(db.read_record);
         free(db.slow5_file_pointers);
+        free(db.read_id);
+        free(db.start_times);
+        free(db.dups);
+        dedup.first_seq += record_count;
 
-        for(size_t j=open_file_from; j<slow5_file_index; j++){
-            if (slow5_close(open_files_pointers.front()) == EOF) { //close file
-                ERROR("File '%s' failed on closing - %s.", slow5_files[j].c_str(), strerror(errno));
-                return EXIT_FAILURE;
-            }
-            open_files_pointers.pop();
+        if (merge_pool_release(&pool, slow5_file_index) < 0) {
+            merge_pool_destroy(&pool);
+            return EXIT_FAILURE;
         }
-        open_file_from = slow5_file_index;
         if(flag_end_of_records){
             break;
         }
     }
+    merge_pool_destroy(&pool);
+    if (dedup_mode != MERGE_DEDUP_NONE) {
+        INFO("%" PRIu64 " duplicate read ids %s, %zu distinct read ids", num_dups,
+             dedup_mode == MERGE_DEDUP_DROP ? "removed" : "found", rid_set_size(&dedup_set));
+        rid_set_free(&dedup_set);
+    }
+    if (sort_key != MERGE_SORT_NONE) {
+        double realtime = slow5_realtime();
+        int ret_sort = merge_sort_finish(&sorter, slow5File->fp, user_opts.flag_index ? &idx_entries : NULL);
+        merge_sort_destroy(&sorter);
+        if (ret_sort < 0) {
+            return EXIT_FAILURE;
+        }
+        time_write += slow5_realtime() - realtime;
+    }
     DEBUG("time_get_to_mem\t%.3fs", time_get_to_mem);
     DEBUG("time_thread_execution\t%.3fs", time_thread_execution);
     DEBUG("time_write\t%.3fs", time_write);
@@ -475,6 +1735,14 @@ int merge_main(int argc, char **argv, struct program_meta *meta){
     }
     slow5_close(slow5File);
 
+    if (user_opts.flag_index && idx_finish(user_opts.arg_fname_out, idx_entries) < 0) {
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
+    if (!tree_dir.empty()) {
+        merge_tree_remove(tree_dir);
+    }
+
     EXIT_MSG(EXIT_SUCCESS, argv, meta);
     return EXIT_SUCCESS;
 }
@@ -6,6 +6,10 @@
  */
 #include "misc.h"
 #include "cmd.h"
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/sendfile.h>
+#endif
 
 extern int slow5tools_verbosity_level;
 
@@ -61,6 +65,7 @@ void init_opt(opt_t *opt){
     opt->flag_retain_dir_structure = DEFAULT_RETAIN_DIR_STRUCTURE;
     opt->flag_dump_all = DEFAULT_DUMP_ALL;
     opt->flag_continue_merge = DEFAULT_CONTINUE_MERGE;
+    opt->flag_index = DEFAULT_INDEX;
 }
 
 int parse_num_threads(opt_t *opt, int argc, char **argv, struct program_meta *meta){
@@ -149,6 +154,160 @@ int parse_batch_size(opt_t *opt, int argc, char **argv){
     return 0;
 }
 
+// parse a size in bytes with an optional K, M, G or T suffix (powers of 1024)
+// returns -1 if the size is invalid
+int64_t parse_size(const char *arg){
+    char *endptr;
+    double ret = strtod(arg, &endptr);
+    if (endptr == arg || ret < 0) {
+        return -1;
+    }
+    switch (*endptr) {
+        case 'T': case 't': ret *= 1024;
+        // fall through
+        case 'G': case 'g': ret *= 1024;
+        // fall through
+        case 'M': case 'm': ret *= 1024;
+        // fall through
+        case 'K': case 'k': ret *= 1024;
+            endptr++;
+            break;
+        case '\0':
+            break;
+        default:
+            return -1;
+    }
+    if (*endptr != '\0' && !((*endptr == 'B' || *endptr == 'b') && endptr[1] == '\0')) {
+        return -1;
+    }
+    return (int64_t) ret;
+}
+
+// copy len bytes at off_in of fd_in to off_out of fd_out without using or moving the file positions
+// so that several threads can copy to different parts of the same output at once
+// copy_file_range is tried first so that the filesystem can share the blocks (reflink) or copy them server side,
+// falling back to reads and writes of COPY_RANGE_BUFFER bytes when it is not supported for these files
+// returns 0 on success and -1 on error (errno is set)
+int copy_range(int fd_in, off_t off_in, int fd_out, off_t off_out, size_t len){
+#ifdef __NR_copy_file_range
+    while (len > 0) {
+        loff_t in = off_in;
+        loff_t out = off_out;
+        ssize_t n = syscall(__NR_copy_file_range, fd_in, &in, fd_out, &out, len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            if (n == 0) {
+                errno = EIO; // the input is shorter than expected
+                return -1;
+            }
+            if (errno != ENOSYS && errno != EXDEV && errno != EINVAL && errno != EOPNOTSUPP && errno != EBADF) {
+                return -1;
+            }
+            break; // copy the rest with reads and writes
+        }
+        off_in += n;
+        off_out += n;
+        len -= n;
+    }
+    if (len == 0) {
+        return 0;
+    }
+#endif
+    size_t buf_size = len < COPY_RANGE_BUFFER ? len : COPY_RANGE_BUFFER;
+    char *buf = (char *) malloc(buf_size ? buf_size : 1);
+    MALLOC_CHK(buf);
+    while (len > 0) {
+        ssize_t n = pread(fd_in, buf, len < buf_size ? len : buf_size, off_in);
+        if (n <= 0) {
+            if (n == 0) {
+                errno = EIO; // the input is shorter than expected
+            } else if (errno == EINTR) {
+                continue;
+            }
+            free(buf);
+            return -1;
+        }
+        for (ssize_t done = 0; done < n; ) {
+            ssize_t w = pwrite(fd_out, buf + done, n - done, off_out + done);
+            if (w < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                free(buf);
+                return -1;
+            }
+            done += w;
+        }
+        off_in += n;
+        off_out += n;
+        len -= n;
+    }
+    free(buf);
+    return 0;
+}
+
+// copy len bytes at off_in of fd_in to the current position of fd_out, for outputs that cannot be written at an
+// offset such as pipes. sendfile is tried first, falling back to reads and writes of COPY_RANGE_BUFFER bytes
+// returns 0 on success and -1 on error (errno is set)
+int copy_stream(int fd_in, off_t off_in, int fd_out, size_t len){
+#ifdef __linux__
+    while (len > 0) {
+        off_t in = off_in;
+        ssize_t n = sendfile(fd_out, fd_in, &in, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            if (n == 0) {
+                errno = EIO; // the input is shorter than expected
+                return -1;
+            }
+            if (errno != ENOSYS && errno != EINVAL) {
+                return -1;
+            }
+            break; // copy the rest with reads and writes
+        }
+        off_in += n;
+        len -= n;
+    }
+    if (len == 0) {
+        return 0;
+    }
+#endif
+    size_t buf_size = len < COPY_RANGE_BUFFER ? len : COPY_RANGE_BUFFER;
+    char *buf = (char *) malloc(buf_size ? buf_size : 1);
+    MALLOC_CHK(buf);
+    while (len > 0) {
+        ssize_t n = pread(fd_in, buf, len < buf_size ? len : buf_size, off_in);
+        if (n <= 0) {
+            if (n == 0) {
+                errno = EIO;
+            } else if (errno == EINTR) {
+                continue;
+            }
+            free(buf);
+            return -1;
+        }
+        for (ssize_t done = 0; done < n; ) {
+            ssize_t w = write(fd_out, buf + done, n - done);
+            if (w < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                free(buf);
+                return -1;
+            }
+            done += w;
+        }
+        off_in += n;
+        len -= n;
+    }
+    free(buf);
+    return 0;
+}
+
 int parse_format_args(opt_t *opt, int argc, char **argv, struct program_meta *meta){
     // Parse format arguments
     if (opt->arg_fmt_in != NULL) {
@@ -21,6 +21,8 @@
 #include "slow5_extra.h"
 #include "error.h"
 
+#define COPY_RANGE_BUFFER (4 * 1024 * 1024) // bytes read and written at once by copy_range and copy_stream
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -54,6 +56,7 @@ typedef struct {
     int flag_retain_dir_structure;
     int flag_dump_all;
     int flag_continue_merge;
+    int flag_index;
 
     // Input arguments
     char *arg_fname_in;
@@ -130,6 +133,9 @@ int parse_num_processes(opt_t *opt, int argc, char **argv, struct program_meta *
 int parse_arg_lossless(opt_t *opt, int argc, char **argv, struct program_meta *meta);
 int parse_arg_dump_all(opt_t *opt, int argc, char **argv, struct program_meta *meta);
 int parse_batch_size(opt_t *opt, int argc, char **arg);
+int64_t parse_size(const char *arg);
+int copy_range(int fd_in, off_t off_in, int fd_out, off_t off_out, size_t len);
+int copy_stream(int fd_in, off_t off_in, int fd_out, size_t len);
 int parse_format_args(opt_t *opt, int argc, char **argv, struct program_meta *meta);
 int auto_detect_formats(opt_t *opt, int set_default_output_format = 1);
 int parse_compression_opts(opt_t *opt);
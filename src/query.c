@@ -0,0 +1,328 @@
+/**
+ * @file query.c
+ * @brief stream the records of a SLOW5/BLOW5 file whose field values fall in a range using secondary indexes
+ * @date 18/10/2026
+ */
+#include <getopt.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <slow5/slow5.h>
+#include "error.h"
+#include "cmd.h"
+#include "misc.h"
+#include "thread.h"
+#include "slow5_extra.h"
+#include "idx_utils.h"
+#include "sidx.h"
+
+#define USAGE_MSG "Usage: %s [OPTIONS] --filter FIELD:MIN:MAX [SLOW5_FILE]\n"
+#define HELP_LARGE_MSG \
+    "Display the records whose field values are within the given ranges, using the secondary indexes created by slow5tools index --attr.\n" \
+    USAGE_MSG \
+    "\n" \
+    "OPTIONS:\n" \
+    "    --filter FIELD:MIN:MAX        keep records with MIN <= FIELD <= MAX (MIN or MAX can be empty). Can be given multiple times.\n" \
+    "    --to FORMAT                   specify output file format\n" \
+    "    -o, --output [FILE]           output contents to FILE [default: stdout]\n" \
+    HELP_MSG_PRESS \
+    HELP_MSG_THREADS \
+    HELP_MSG_BATCH \
+    "    --count                       print only the number of matching records\n" \
+    HELP_MSG_HELP \
+    HELP_FORMATS_METHODS
+
+extern int slow5tools_verbosity_level;
+
+typedef struct {
+    std::string attr;
+    double min;
+    double max;
+} query_filter_t;
+
+typedef struct {
+    const std::vector<sidx_rec_t> *matches;
+    int64_t start;
+} query_batch_t;
+
+// parse FIELD:MIN:MAX where an empty MIN or MAX is unbounded
+static int parse_filter(const char *arg, query_filter_t *filter) {
+    const char *first = strchr(arg, ':');
+    const char *second = first ? strchr(first + 1, ':') : NULL;
+    if (!first || !second || first == arg) {
+        ERROR("Invalid filter '%s'. Expected FIELD:MIN:MAX.", arg);
+        return -1;
+    }
+    filter->attr = std::string(arg, first - arg);
+    std::string min_str(first + 1, second - first - 1);
+    std::string max_str(second + 1);
+    char *end;
+    filter->min = -INFINITY;
+    filter->max = INFINITY;
+    if (!min_str.empty()) {
+        filter->min = strtod(min_str.c_str(), &end);
+        if (*end != '\0') {
+            ERROR("Invalid minimum '%s' in filter '%s'.", min_str.c_str(), arg);
+            return -1;
+        }
+    }
+    if (!max_str.empty()) {
+        filter->max = strtod(max_str.c_str(), &end);
+        if (*end != '\0') {
+            ERROR("Invalid maximum '%s' in filter '%s'.", max_str.c_str(), arg);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// binary search the sorted secondary index for the range and return the matches sorted by file offset
+static int query_filter_matches(const char *slow5_path, const query_filter_t &filter, std::vector<sidx_rec_t> &matches) {
+    std::vector<sidx_rec_t> entries;
+    if (sidx_load(slow5_path, filter.attr.c_str(), entries) < 0) {
+        return -1;
+    }
+    auto lo = std::lower_bound(entries.begin(), entries.end(), filter.min, [](const sidx_rec_t &rec, double value) {
+        return rec.value < value;
+    });
+    auto hi = std::upper_bound(lo, entries.end(), filter.max, [](double value, const sidx_rec_t &rec) {
+        return value < rec.value;
+    });
+    matches.assign(lo, hi);
+    std::sort(matches.begin(), matches.end(), [](const sidx_rec_t &x, const sidx_rec_t &y) {
+        return x.offset < y.offset;
+    });
+    return 0;
+}
+
+static void query_fetch_record(core_t *core, db_t *db, int32_t i) {
+    query_batch_t *batch = (query_batch_t *) core->param;
+    const sidx_rec_t &rec = (*batch->matches)[batch->start + i];
+    size_t bytes;
+    char *mem = idx_rec_mem(core->fp, rec.offset, rec.size, &bytes);
+    struct slow5_rec *read = NULL;
+    if (!mem || slow5_rec_depress_parse(&mem, &bytes, NULL, &read, core->fp) != 0) {
+        ERROR("Could not read the record at offset %" PRIu64 " of %s", rec.offset, core->fp->meta.pathname);
+        exit(EXIT_FAILURE);
+    }
+    free(mem);
+    struct slow5_press *press_ptr = slow5_press_init(core->press_method);
+    if (!press_ptr) {
+        ERROR("Could not initialize the slow5 compression method%s", "");
+        exit(EXIT_FAILURE);
+    }
+    size_t len;
+    if ((db->read_record[i].buffer = slow5_rec_to_mem(read, core->fp->header->aux_meta, core->format_out, press_ptr, &len)) == NULL) {
+        ERROR("Could not encode the record %s", read->read_id);
+        exit(EXIT_FAILURE);
+    }
+    db->read_record[i].len = len;
+    slow5_press_free(press_ptr);
+    slow5_rec_free(read);
+}
+
+int query_main(int argc, char **argv, struct program_meta *meta) {
+
+    // Debug: print arguments
+    print_args(argc,argv);
+
+    // No arguments given
+    if (argc <= 1) {
+        fprintf(stderr, HELP_LARGE_MSG, argv[0]);
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
+
+    static struct option long_opts[] = {
+        {"to",          required_argument, NULL, 'b'}, //0
+        {"compress",    required_argument, NULL, 'c'}, //1
+        {"sig-compress",required_argument, NULL, 's'}, //2
+        {"batchsize",   required_argument, NULL, 'K'}, //3
+        {"output",      required_argument, NULL, 'o'}, //4
+        {"threads",     required_argument, NULL, 't' }, //5
+        {"help",        no_argument, NULL, 'h' }, //6
+        {"filter",      required_argument, NULL, 0}, //7
+        {"count",       no_argument, NULL, 0}, //8
+        {NULL, 0, NULL, 0 }
+    };
+
+    opt_t user_opts;
+    init_opt(&user_opts);
+    std::vector<query_filter_t> filters;
+    int count_flag = 0;
+
+    int opt;
+    int longindex = 0;
+
+    // Parse options
+    while ((opt = getopt_long(argc, argv, "b:c:s:K:o:t:h", long_opts, &longindex)) != -1) {
+        DEBUG("opt='%c', optarg=\"%s\", optind=%d, opterr=%d, optopt='%c'",
+                  opt, optarg, optind, opterr, optopt);
+        switch (opt) {
+            case 'b':
+                user_opts.arg_fmt_out = optarg;
+                break;
+            case 'c':
+                user_opts.arg_record_press_out = optarg;
+                break;
+            case 's':
+                user_opts.arg_signal_press_out = optarg;
+                break;
+            case 't':
+                user_opts.arg_num_threads = optarg;
+                break;
+            case 'o':
+                user_opts.arg_fname_out = optarg;
+                break;
+            case 'K':
+                user_opts.arg_batch = optarg;
+                break;
+            case 'h':
+                DEBUG("displaying large help message%s","");
+                fprintf(stdout, HELP_LARGE_MSG, argv[0]);
+                EXIT_MSG(EXIT_SUCCESS, argv, meta);
+                exit(EXIT_SUCCESS);
+            case 0  :
+                switch (longindex) {
+                    case 7: {
+                        query_filter_t filter;
+                        if (parse_filter(optarg, &filter) < 0) {
+                            EXIT_MSG(EXIT_FAILURE, argv, meta);
+                            return EXIT_FAILURE;
+                        }
+                        filters.push_back(filter);
+                        break;
+                    }
+                    case 8:
+                        count_flag = 1;
+                        break;
+                }
+                break;
+            default: // case '?'
+                fprintf(stderr, HELP_SMALL_MSG, argv[0]);
+                EXIT_MSG(EXIT_FAILURE, argv, meta);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if(parse_num_threads(&user_opts,argc,argv,meta) < 0){
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
+    if(parse_batch_size(&user_opts,argc,argv) < 0){
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
+    if(parse_format_args(&user_opts,argc,argv,meta) < 0){
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
+    if(auto_detect_formats(&user_opts) < 0){
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
+    if(parse_compression_opts(&user_opts) < 0){
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
+
+    if (filters.empty()) {
+        ERROR("At least one --filter must be given%s", "");
+        fprintf(stderr, HELP_SMALL_MSG, argv[0]);
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
+    if (optind != argc - 1) {
+        ERROR("Expected exactly one slow5 or blow5 file%s", "");
+        fprintf(stderr, HELP_SMALL_MSG, argv[0]);
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
+    const char *f_in_name = argv[optind];
+
+    // records matching all the filters, intersected on the file offset
+    double realtime0 = slow5_realtime();
+    std::vector<sidx_rec_t> matches;
+    for (size_t f = 0; f < filters.size(); f++) {
+        std::vector<sidx_rec_t> filter_matches;
+        if (query_filter_matches(f_in_name, filters[f], filter_matches) < 0) {
+            EXIT_MSG(EXIT_FAILURE, argv, meta);
+            return EXIT_FAILURE;
+        }
+        if (f == 0) {
+            matches.swap(filter_matches);
+        } else {
+            std::vector<sidx_rec_t> intersection;
+            std::set_intersection(matches.begin(), matches.end(), filter_matches.begin(), filter_matches.end(), std::back_inserter(intersection),
+                                  [](const sidx_rec_t &x, const sidx_rec_t &y) { return x.offset < y.offset; });
+            matches.swap(intersection);
+        }
+    }
+    VERBOSE("%ld records matched - took %.3fs", (long) matches.size(), slow5_realtime() - realtime0);
+
+    if (user_opts.arg_fname_out != NULL) {
+        user_opts.f_out = fopen(user_opts.arg_fname_out, "w");
+        if (user_opts.f_out == NULL) {
+            ERROR("File '%s' could not be opened - %s.", user_opts.arg_fname_out, strerror(errno));
+            EXIT_MSG(EXIT_FAILURE, argv, meta);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (count_flag) {
+        fprintf(user_opts.f_out, "%ld\n", (long) matches.size());
+        if (user_opts.arg_fname_out != NULL) {
+            fclose(user_opts.f_out);
+        }
+        EXIT_MSG(EXIT_SUCCESS, argv, meta);
+        return EXIT_SUCCESS;
+    }
+
+    slow5_file_t *slow5_file = slow5_open(f_in_name, "r");
+    F_CHK(slow5_file, f_in_name);
+
+    slow5_press_method_t press_out = {user_opts.record_press_out, user_opts.signal_press_out};
+    if (slow5_hdr_fwrite(user_opts.f_out, slow5_file->header, user_opts.fmt_out, press_out) == -1) {
+        ERROR("Could not write the output header%s", "");
+        return EXIT_FAILURE;
+    }
+
+    query_batch_t batch;
+    batch.matches = &matches;
+    core_t core;
+    core.num_thread = user_opts.num_threads;
+    core.fp = slow5_file;
+    core.format_out = user_opts.fmt_out;
+    core.press_method = press_out;
+    core.param = &batch;
+
+    // records are read in increasing offset order so that the I/O is (mostly) sequential
+    db_t db = { 0 };
+    db.read_record = (raw_record_t *) malloc(user_opts.read_id_batch_capacity * sizeof(raw_record_t));
+    MALLOC_CHK(db.read_record);
+    int64_t num_matches = matches.size();
+    for (batch.start = 0; batch.start < num_matches; batch.start += user_opts.read_id_batch_capacity) {
+        db.n_batch = std::min(user_opts.read_id_batch_capacity, num_matches - batch.start);
+        work_db(&core, &db, query_fetch_record);
+        for (int64_t i = 0; i < db.n_batch; i++) {
+            fwrite(db.read_record[i].buffer, 1, db.read_record[i].len, user_opts.f_out);
+            free(db.read_record[i].buffer);
+        }
+    }
+    free(db.read_record);
+
+    if (user_opts.fmt_out == SLOW5_FORMAT_BINARY) {
+        slow5_eof_fwrite(user_opts.f_out);
+    }
+    slow5_close(slow5_file);
+    if (user_opts.arg_fname_out != NULL) {
+        fclose(user_opts.f_out);
+    }
+
+    EXIT_MSG(EXIT_SUCCESS, argv, meta);
+    return EXIT_SUCCESS;
+}
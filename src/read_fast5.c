@@ -174,10 +174,14 @@ int print_slow5_header(operator_obj* operator_data) {
 }
 
 int print_record(operator_obj* operator_data) {
+    off_t offset = operator_data->idx_entries ? ftello(operator_data->slow5File->fp) : 0;
     if(slow5_rec_fwrite(operator_data->slow5File->fp, operator_data->slow5_record, operator_data->slow5File->header->aux_meta, operator_data->format_out, operator_data->press_ptr) == -1){
         ERROR("Could not write the SLOW5 record for read id '%s' to %s.", operator_data->slow5_record->read_id, operator_data->slow5File->meta.pathname);
         return -1;
     }
+    if (operator_data->idx_entries) {
+        idx_add(*operator_data->idx_entries, operator_data->slow5_record->read_id, offset, ftello(operator_data->slow5File->fp) - offset);
+    }
     return 0;
 }
 
@@ -212,7 +216,8 @@ int read_fast5(opt_t *user_opts,
                fast5_file_t *fast5_file,
                slow5_file_t *slow5File,
                int write_header_flag,
-               std::unordered_map<std::string, uint32_t>* warning_map) {
+               std::unordered_map<std::string, uint32_t>* warning_map,
+               std::vector<idx_rec_t> *idx_entries) {
 
     slow5_fmt format_out = user_opts->fmt_out;
     slow5_press_method_t press_out = {user_opts->record_press_out, user_opts->signal_press_out};
@@ -236,6 +241,7 @@ int read_fast5(opt_t *user_opts,
 
     tracker.fast5_path = fast5_file->fast5_path;
     tracker.slow5File = slow5File;
+    tracker.idx_entries = idx_entries;
 
     int flag_context_tags = 0;
     int flag_tracking_id = 0;
@@ -1,6 +1,7 @@
 // definitions used for FAST5 to SLOW5 conversion (some of the functions must be moved to elsewhere as they are common)
 #include <unordered_map>
 #include "misc.h"
+#include "idx_utils.h"
 #include <vector>
 
 //void free_attributes(group_flags group_flag, operator_obj* operator_data);
@@ -86,6 +87,7 @@ struct operator_obj {
     slow5_file_t* slow5File;
     std::unordered_map<std::string, uint32_t>* warning_map;
     int *primary_fields_count;
+    std::vector<idx_rec_t> *idx_entries; // index entries of the written records (NULL unless --index)
 };
 
 //implemented in read_fast5.c
@@ -93,7 +95,8 @@ int read_fast5(opt_t *user_opts,
                fast5_file_t *fast5_file,
                slow5_file_t *slow5File,
                int write_header_flag,
-               std::unordered_map<std::string, uint32_t>* warning_map);
+               std::unordered_map<std::string, uint32_t>* warning_map,
+               std::vector<idx_rec_t> *idx_entries);
 fast5_file_t fast5_open(const char* filename);
 
 
@@ -0,0 +1,209 @@
+/**
+ * @file rid_list.c
+ * @brief bulk loading of newline separated read ID lists into a single string arena and a concurrent read ID set
+ * @date 18/10/2026
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <string>
+#include <unordered_set>
+#include "rid_list.h"
+#include "error.h"
+
+#define RID_LIST_BLOCK_SIZE (4 * 1024 * 1024)
+
+extern int slow5tools_verbosity_level;
+
+// only lowercase hex digits are accepted: read ids are compared as strings, so an uppercase UUID
+// must not get the same key as its lowercase form
+static inline int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+// convert a canonical UUID (8-4-4-4-12 lowercase hex digits) to a 16-byte key
+// returns 0 on success and -1 if read_id is not a canonical UUID, which is then kept as a string
+int rid_to_key(const char *read_id, size_t len, uint8_t *key) {
+    if (len != RID_UUID_LEN || read_id[8] != '-' || read_id[13] != '-' || read_id[18] != '-' || read_id[23] != '-') {
+        return -1;
+    }
+    int k = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (i == 8 || i == 13 || i == 18 || i == 23) {
+            continue;
+        }
+        int hi = hex_value(read_id[i]);
+        int lo = hex_value(read_id[++ i]);
+        if (hi < 0 || lo < 0) {
+            return -1;
+        }
+        key[k ++] = (uint8_t) (hi << 4 | lo);
+    }
+    return 0;
+}
+
+// read the whole stream in one go for regular files, in large blocks otherwise
+static char *read_all(FILE *fp, size_t *n) {
+    struct stat st;
+    size_t cap = RID_LIST_BLOCK_SIZE;
+    if (fstat(fileno(fp), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        cap = st.st_size + 2; // the NUL and a byte for the read that finds the end of the file
+    }
+    char *buf = (char *) malloc(cap);
+    MALLOC_CHK(buf);
+    size_t len = 0;
+    while (1) {
+        if (cap - len < 2) {
+            cap *= 2;
+            buf = (char *) realloc(buf, cap);
+            MALLOC_CHK(buf);
+        }
+        size_t ret = fread(buf + len, 1, cap - len - 1, fp);
+        len += ret;
+        if (ret == 0) {
+            break;
+        }
+    }
+    if (ferror(fp)) {
+        free(buf);
+        return NULL;
+    }
+    buf[len] = '\0';
+    *n = len;
+    return buf;
+}
+
+// load newline separated read ids; empty lines are ignored and with dedup only the first occurrence of a read id is kept
+int rid_list_load(FILE *fp, rid_list_t *list, int dedup) {
+    list->num_dups = 0;
+    list->arena = read_all(fp, &list->arena_len);
+    if (!list->arena) {
+        ERROR("Could not read the read id list - %s.", strerror(errno));
+        return -1;
+    }
+
+    std::unordered_set<rid_key_t, rid_key_hash, rid_key_equal> uuid_keys;
+    std::unordered_set<std::string> other_ids;
+    if (dedup) {
+        uuid_keys.reserve(list->arena_len / (RID_UUID_LEN + 1));
+    }
+
+    char *start = list->arena;
+    char *end = list->arena + list->arena_len;
+    while (start < end) {
+        char *newline = (char *) memchr(start, '\n', end - start);
+        char *line_end = newline ? newline : end;
+        *line_end = '\0';
+        size_t len = line_end - start;
+        if (len > 0 && start[len - 1] == '\r') {
+            start[-- len] = '\0';
+        }
+        if (len > 0) {
+            bool keep = true;
+            if (dedup) {
+                rid_key_t key;
+                if (rid_to_key(start, len, (uint8_t *) &key) == 0) {
+                    keep = uuid_keys.insert(key).second;
+                } else {
+                    keep = other_ids.insert(std::string(start, len)).second;
+                }
+            }
+            if (keep) {
+                list->ids.push_back(start);
+            } else {
+                list->num_dups ++;
+            }
+        }
+        start = line_end + 1;
+    }
+    return 0;
+}
+
+void rid_list_free(rid_list_t *list) {
+    free(list->arena);
+    list->arena = NULL;
+    list->ids.clear();
+}
+
+void rid_set_init(rid_set_t *set) {
+    set->shards.resize(RID_SET_SHARDS);
+    for (size_t i = 0; i < set->shards.size(); i++) {
+        NEG_CHK(pthread_mutex_init(&set->shards[i].lock, NULL));
+    }
+}
+
+// find the shard of a read id; is_uuid and key are set if the read id is a canonical UUID
+static rid_set_shard_t *rid_set_shard(rid_set_t *set, const char *read_id, size_t len, int *is_uuid, rid_key_t *key) {
+    size_t hash;
+    if (rid_to_key(read_id, len, (uint8_t *) key) == 0) {
+        *is_uuid = 1;
+        hash = rid_key_hash()(*key);
+    } else {
+        *is_uuid = 0;
+        hash = std::hash<std::string>()(std::string(read_id, len));
+    }
+    return &set->shards[(hash >> 7) % set->shards.size()];
+}
+
+// add read_id claimed with sequence number seq, keeping the smallest sequence number it has been claimed with
+// returns that smallest sequence number: seq if this is the first claim so far
+uint64_t rid_set_claim(rid_set_t *set, const char *read_id, uint64_t seq) {
+    size_t len = strlen(read_id);
+    int is_uuid;
+    rid_key_t key;
+    rid_set_shard_t *shard = rid_set_shard(set, read_id, len, &is_uuid, &key);
+    pthread_mutex_lock(&shard->lock);
+    uint64_t *first;
+    if (is_uuid) {
+        first = &shard->uuids.insert(std::make_pair(key, seq)).first->second;
+    } else {
+        first = &shard->others.insert(std::make_pair(std::string(read_id, len), seq)).first->second;
+    }
+    if (seq < *first) {
+        *first = seq;
+    }
+    uint64_t ret = *first;
+    pthread_mutex_unlock(&shard->lock);
+    return ret;
+}
+
+// returns the smallest sequence number read_id has been claimed with and UINT64_MAX if it has not been claimed
+uint64_t rid_set_get(rid_set_t *set, const char *read_id) {
+    size_t len = strlen(read_id);
+    int is_uuid;
+    rid_key_t key;
+    rid_set_shard_t *shard = rid_set_shard(set, read_id, len, &is_uuid, &key);
+    uint64_t ret = UINT64_MAX;
+    pthread_mutex_lock(&shard->lock);
+    if (is_uuid) {
+        auto it = shard->uuids.find(key);
+        if (it != shard->uuids.end()) {
+            ret = it->second;
+        }
+    } else {
+        auto it = shard->others.find(std::string(read_id, len));
+        if (it != shard->others.end()) {
+            ret = it->second;
+        }
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return ret;
+}
+
+size_t rid_set_size(rid_set_t *set) {
+    size_t n = 0;
+    for (size_t i = 0; i < set->shards.size(); i++) {
+        n += set->shards[i].uuids.size() + set->shards[i].others.size();
+    }
+    return n;
+}
+
+void rid_set_free(rid_set_t *set) {
+    for (size_t i = 0; i < set->shards.size(); i++) {
+        pthread_mutex_destroy(&set->shards[i].lock);
+    }
+    set->shards.clear();
+}
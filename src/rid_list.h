@@ -0,0 +1,64 @@
+// Bulk loading of newline separated read ID lists into a single string arena and a read ID set shared by threads
+
+#ifndef RID_LIST_H
+#define RID_LIST_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+#define RID_UUID_LEN (36)
+#define RID_KEY_LEN (16)
+
+typedef struct {
+    char *arena;             // the whole input, with each read id terminated by '\0' in place of the newline
+    size_t arena_len;
+    std::vector<char *> ids; // pointers into the arena in input order
+    uint64_t num_dups;       // number of duplicate read ids removed
+} rid_list_t;
+
+// a read id packed to 16 bytes if it is a canonical lowercase UUID
+typedef struct {
+    uint64_t hi;
+    uint64_t lo;
+} rid_key_t;
+
+struct rid_key_hash {
+    size_t operator()(const rid_key_t &key) const {
+        return key.hi ^ (key.lo * 0x9e3779b97f4a7c15ULL);
+    }
+};
+
+struct rid_key_equal {
+    bool operator()(const rid_key_t &a, const rid_key_t &b) const {
+        return a.hi == b.hi && a.lo == b.lo;
+    }
+};
+
+#define RID_SET_SHARDS (64)
+
+typedef struct {
+    pthread_mutex_t lock;
+    std::unordered_map<rid_key_t, uint64_t, rid_key_hash, rid_key_equal> uuids; // UUID read ids as 16-byte keys
+    std::unordered_map<std::string, uint64_t> others;                          // read ids that are not UUIDs
+} rid_set_shard_t;
+
+// a set of read ids that threads insert to concurrently, sharded by the hash of the read id so that they rarely wait for each other
+// each read id keeps the smallest sequence number it was claimed with, which makes the first occurrence independent of the thread timing
+typedef struct {
+    std::vector<rid_set_shard_t> shards;
+} rid_set_t;
+
+int rid_list_load(FILE *fp, rid_list_t *list, int dedup);
+void rid_list_free(rid_list_t *list);
+int rid_to_key(const char *read_id, size_t len, uint8_t *key);
+void rid_set_init(rid_set_t *set);
+uint64_t rid_set_claim(rid_set_t *set, const char *read_id, uint64_t seq);
+uint64_t rid_set_get(rid_set_t *set, const char *read_id);
+size_t rid_set_size(rid_set_t *set);
+void rid_set_free(rid_set_t *set);
+
+#endif
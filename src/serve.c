@@ -0,0 +1,929 @@
+/**
+ * @file serve.c
+ * @brief serve records of a SLOW5/BLOW5 file (or a catalog of files) over a local Unix domain socket
+ * @date 18/10/2026
+ */
+#include <getopt.h>
+#include <stdio.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <list>
+#include <unordered_map>
+#include <algorithm>
+#include <pthread.h>
+
+#include <slow5/slow5.h>
+#include "error.h"
+#include "cmd.h"
+#include "misc.h"
+#include "read_fast5.h"
+#include "slow5_extra.h"
+#include "catalog.h"
+
+#define DEFAULT_CACHE_SIZE_MB (256)
+#define SERVE_HEADER_REQUEST "@header"
+#define SERVE_LISTEN_BACKLOG (128)
+#define SERVE_READ_SIZE (64 * 1024)  // bytes read from a connection at once
+#define SERVE_SEND_TIMEOUT (30)      // seconds a reply may wait for a client that does not read it
+#define BLOW5_MAGIC_PREFIX "BLOW5"
+
+#define USAGE_MSG "Usage: %s [OPTIONS] --socket PATH [SLOW5_FILE]\n" \
+                  "       %s [OPTIONS] --socket PATH --catalog FILE\n" \
+                  "       %s [OPTIONS] --connect PATH [READ_ID]...\n"
+#define HELP_LARGE_MSG \
+    "Serve records from a slow5 file (or all the files in a catalog) over a local Unix domain socket.\n" \
+    "The index is loaded once and a pool of worker threads answers batches of read ids from clients.\n" \
+    "With --connect, act as a client: fetch the given read ids (or newline separated read ids from standard input) from a running server.\n" \
+    USAGE_MSG \
+    "\n" \
+    "SERVER OPTIONS:\n" \
+    "    --socket PATH                 path of the Unix domain socket to listen on\n" \
+    "    --catalog FILE                serve all the files in the catalog index FILE (see slow5tools index --catalog)\n" \
+    "    --max-open INT                maximum number of files kept open at once with --catalog [default: 256]\n" \
+    "    --cache-size INT              size of the in-memory record cache in megabytes, 0 to disable [default: 256]\n" \
+    "    --to FORMAT                   output format of the served records\n" \
+    HELP_MSG_PRESS \
+    "    -t, --threads INT             number of worker threads [default: 8]\n" \
+    "\n" \
+    "CLIENT OPTIONS:\n" \
+    "    --connect PATH                connect to the server listening on the Unix domain socket PATH\n" \
+    "    -o, --output [FILE]           output contents to FILE [default: stdout]\n" \
+    "    -l --list [FILE]              list of read ids provided as a single-column text file with one read id per line.\n" \
+    "    -K, --batchsize INT           number of read ids sent per request [default: 4096]\n" \
+    "    --skip                        warn and continue if a read_id was not found.\n" \
+    "    --bench                       measure the request latency and throughput instead of writing the records\n" \
+    HELP_MSG_HELP \
+    HELP_FORMATS_METHODS
+
+extern int slow5tools_verbosity_level;
+
+static volatile sig_atomic_t serve_stop = 0;
+static int serve_wake_fd = -1; // write end of the pipe that wakes up the poll loop
+
+// a client connection with the bytes received but not yet answered
+typedef struct {
+    int fd;
+    std::string buf;
+    bool closed; // the client disconnected, the connection is closed by the poll loop
+} serve_conn_t;
+
+/* LRU cache of encoded records bounded by the total number of bytes */
+typedef struct {
+    size_t capacity;
+    size_t bytes;
+    std::list<std::pair<std::string, std::string>> lru; // most recently used first
+    std::unordered_map<std::string, std::list<std::pair<std::string, std::string>>::iterator> map;
+    pthread_mutex_t lock;
+    uint64_t hits;
+    uint64_t misses;
+} record_cache_t;
+
+typedef struct {
+    // source of the records: a single indexed file or a catalog
+    slow5_file_t *slow5_file;
+    catalog_t *catalog;
+    file_cache_t *file_cache;
+    std::vector<std::vector<uint32_t>> *rg_map;
+
+    slow5_hdr_t *header;
+    slow5_fmt format_out;
+    slow5_press_method_t press_method;
+    std::string header_mem;
+
+    record_cache_t record_cache;
+
+    // connections are polled by the main thread and a connection is handed to a worker only while it has a request to answer
+    std::queue<serve_conn_t *> ready; // connections with bytes to read, waiting for a worker (NULL to stop a worker)
+    std::vector<serve_conn_t *> done; // connections handed back to the poll loop by the workers
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} server_t;
+
+static void serve_wake() {
+    int saved_errno = errno;
+    char c = 0;
+    if (write(serve_wake_fd, &c, 1) < 0) {
+        // the pipe is full, so the poll loop wakes up anyway
+    }
+    errno = saved_errno;
+}
+
+static void serve_signal_handler(int sig) {
+    serve_stop = 1;
+    serve_wake();
+}
+
+static int write_full(int fd, const char *buf, size_t count) {
+    while (count > 0) {
+        ssize_t ret = write(fd, buf, count);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            return -1;
+        }
+        buf += ret;
+        count -= ret;
+    }
+    return 0;
+}
+
+static int read_full(int fd, char *buf, size_t count) {
+    while (count > 0) {
+        ssize_t ret = read(fd, buf, count);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            return -1;
+        }
+        buf += ret;
+        count -= ret;
+    }
+    return 0;
+}
+
+static int record_cache_get(record_cache_t *cache, const std::string &read_id, std::string &mem) {
+    if (cache->capacity == 0) {
+        return -1;
+    }
+    pthread_mutex_lock(&cache->lock);
+    auto it = cache->map.find(read_id);
+    if (it == cache->map.end()) {
+        cache->misses++;
+        pthread_mutex_unlock(&cache->lock);
+        return -1;
+    }
+    cache->lru.splice(cache->lru.begin(), cache->lru, it->second);
+    mem = it->second->second;
+    cache->hits++;
+    pthread_mutex_unlock(&cache->lock);
+    return 0;
+}
+
+static void record_cache_put(record_cache_t *cache, const std::string &read_id, const std::string &mem) {
+    if (cache->capacity == 0 || mem.size() > cache->capacity) {
+        return;
+    }
+    pthread_mutex_lock(&cache->lock);
+    if (cache->map.find(read_id) == cache->map.end()) {
+        while (cache->bytes + mem.size() > cache->capacity) {
+            auto &victim = cache->lru.back();
+            cache->bytes -= victim.second.size();
+            cache->map.erase(victim.first);
+            cache->lru.pop_back();
+        }
+        cache->lru.emplace_front(read_id, mem);
+        cache->map[read_id] = cache->lru.begin();
+        cache->bytes += mem.size();
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// encode the record of read_id into mem, returns -1 if the read is not found
+static int serve_fetch(server_t *server, const std::string &read_id, std::string &mem) {
+    if (record_cache_get(&server->record_cache, read_id, mem) == 0) {
+        return 0;
+    }
+
+    slow5_rec_t *record = NULL;
+    if (server->catalog) {
+        if (catalog_get(server->catalog, server->file_cache, server->rg_map, read_id.c_str(), &record) != 0) {
+            return -1;
+        }
+    } else if (slow5_get(read_id.c_str(), &record, server->slow5_file) < 0 || record == NULL) {
+        return -1;
+    }
+
+    struct slow5_press *compress = slow5_press_init(server->press_method);
+    if (!compress) {
+        ERROR("Could not initialize the slow5 compression method%s", "");
+        exit(EXIT_FAILURE);
+    }
+    size_t len;
+    char *buffer = (char *) slow5_rec_to_mem(record, server->header->aux_meta, server->format_out, compress, &len);
+    slow5_press_free(compress);
+    slow5_rec_free(record);
+    if (!buffer) {
+        return -1;
+    }
+    mem.assign(buffer, len);
+    free(buffer);
+
+    record_cache_put(&server->record_cache, read_id, mem);
+    return 0;
+}
+
+// answer a batch of read ids: an int64_t length followed by the encoded record for each read id in order (length -1 if not found)
+static int serve_answer(server_t *server, int fd, const std::vector<std::string> &batch) {
+    std::string reply;
+    std::string mem;
+    for (size_t i = 0; i < batch.size(); i++) {
+        int64_t len = -1;
+        if (batch[i] == SERVE_HEADER_REQUEST) {
+            len = server->header_mem.size();
+            reply.append((const char *) &len, sizeof len);
+            reply.append(server->header_mem);
+        } else if (serve_fetch(server, batch[i], mem) == 0) {
+            len = mem.size();
+            reply.append((const char *) &len, sizeof len);
+            reply.append(mem);
+        } else {
+            reply.append((const char *) &len, sizeof len);
+        }
+    }
+    return write_full(fd, reply.data(), reply.size());
+}
+
+// a request is a batch of newline separated read ids terminated by an empty line
+// read what the client has sent and answer the complete requests; the rest of a request waits in conn->buf for the next read
+// at the end of the stream, the lines left over form a last request
+static void serve_request(server_t *server, serve_conn_t *conn) {
+    char buf[SERVE_READ_SIZE];
+    ssize_t ret;
+    do {
+        ret = read(conn->fd, buf, sizeof buf);
+    } while (ret < 0 && errno == EINTR);
+    bool eof = ret <= 0;
+    if (!eof) {
+        conn->buf.append(buf, ret);
+    }
+
+    std::vector<std::string> batch;
+    size_t pos = 0;  // start of the line being parsed
+    size_t done = 0; // bytes of the requests answered so far
+    while (1) {
+        size_t nl = conn->buf.find('\n', pos);
+        if (nl == std::string::npos && !(eof && pos < conn->buf.size())) {
+            break;
+        }
+        size_t line_end = nl == std::string::npos ? conn->buf.size() : nl;
+        size_t len = line_end - pos;
+        while (len > 0 && conn->buf[pos + len - 1] == '\r') {
+            len--;
+        }
+        if (len > 0) {
+            batch.push_back(conn->buf.substr(pos, len));
+        }
+        pos = nl == std::string::npos ? conn->buf.size() : nl + 1;
+        if (len > 0) {
+            continue;
+        }
+        done = pos;
+        if (!batch.empty()) {
+            if (serve_answer(server, conn->fd, batch) != 0) {
+                DEBUG("client disconnected before the reply was written%s", "");
+                conn->closed = true;
+                return;
+            }
+            batch.clear();
+        }
+    }
+    if (eof) {
+        if (!batch.empty() && serve_answer(server, conn->fd, batch) != 0) {
+            DEBUG("client disconnected before the reply was written%s", "");
+        }
+        conn->closed = true;
+        return;
+    }
+    conn->buf.erase(0, done);
+}
+
+static void *serve_worker(void *arg) {
+    server_t *server = (server_t *) arg;
+    while (1) {
+        pthread_mutex_lock(&server->lock);
+        while (server->ready.empty()) {
+            pthread_cond_wait(&server->cond, &server->lock);
+        }
+        serve_conn_t *conn = server->ready.front();
+        server->ready.pop();
+        pthread_mutex_unlock(&server->lock);
+        if (conn == NULL) { // shutdown
+            break;
+        }
+        serve_request(server, conn);
+
+        // the connection goes back to the poll loop, which also closes it
+        pthread_mutex_lock(&server->lock);
+        server->done.push_back(conn);
+        pthread_mutex_unlock(&server->lock);
+        serve_wake();
+    }
+    pthread_exit(0);
+}
+
+static void serve_dispatch(server_t *server, serve_conn_t *conn) {
+    pthread_mutex_lock(&server->lock);
+    server->ready.push(conn);
+    pthread_cond_signal(&server->cond);
+    pthread_mutex_unlock(&server->lock);
+}
+
+static void serve_close(serve_conn_t *conn) {
+    close(conn->fd);
+    delete conn;
+}
+
+static int serve_listen(const char *socket_path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof addr.sun_path) {
+        ERROR("Socket path %s is too long.", socket_path);
+        return -1;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    struct stat st;
+    if (stat(socket_path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            ERROR("%s exists and is not a socket.", socket_path);
+            return -1;
+        }
+        unlink(socket_path); // stale socket left behind by a previous server
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        ERROR("Could not create a socket - %s.", strerror(errno));
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr *) &addr, sizeof addr) != 0 || listen(fd, SERVE_LISTEN_BACKLOG) != 0) {
+        ERROR("Could not listen on %s - %s.", socket_path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int serve_connect(const char *socket_path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof addr.sun_path) {
+        ERROR("Socket path %s is too long.", socket_path);
+        return -1;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        ERROR("Could not create a socket - %s.", strerror(errno));
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr *) &addr, sizeof addr) != 0) {
+        ERROR("Could not connect to %s - %s. Is slow5tools serve running?", socket_path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// send a batch of read ids and read the replies; records that were not found are left empty with found[i] = false
+static int client_request(int fd, const std::vector<std::string> &read_ids, std::vector<std::string> &records, std::vector<bool> &found) {
+    std::string request;
+    for (size_t i = 0; i < read_ids.size(); i++) {
+        request.append(read_ids[i]);
+        request.push_back('\n');
+    }
+    request.push_back('\n');
+    if (write_full(fd, request.data(), request.size()) != 0) {
+        ERROR("Could not send the request to the server - %s.", strerror(errno));
+        return -1;
+    }
+
+    records.resize(read_ids.size());
+    found.resize(read_ids.size());
+    for (size_t i = 0; i < read_ids.size(); i++) {
+        int64_t len;
+        if (read_full(fd, (char *) &len, sizeof len) != 0) {
+            ERROR("Connection to the server was lost%s", "");
+            return -1;
+        }
+        found[i] = (len >= 0);
+        records[i].resize(len >= 0 ? len : 0);
+        if (len > 0 && read_full(fd, &records[i][0], len) != 0) {
+            ERROR("Connection to the server was lost%s", "");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int serve_client(const char *socket_path, FILE *read_list_in, char **read_ids, int num_read_ids, int64_t batch_size, FILE *f_out, int skip_flag, bool benchmark) {
+    int fd = serve_connect(socket_path);
+    if (fd < 0) {
+        return -1;
+    }
+
+    std::vector<std::string> batch;
+    std::vector<std::string> records;
+    std::vector<bool> found;
+
+    batch.push_back(SERVE_HEADER_REQUEST);
+    if (client_request(fd, batch, records, found) != 0) {
+        close(fd);
+        return -1;
+    }
+    bool binary = records[0].compare(0, strlen(BLOW5_MAGIC_PREFIX), BLOW5_MAGIC_PREFIX) == 0;
+    if (!benchmark) {
+        fwrite(records[0].data(), 1, records[0].size(), f_out);
+    }
+
+    std::vector<double> latencies;
+    int64_t num_reads = 0;
+    int64_t num_missing = 0;
+    double realtime0 = slow5_realtime();
+    int next_arg = 0;
+    char *line = NULL;
+    size_t cap = 0;
+    bool end_of_input = false;
+    int ret = 0;
+    while (!end_of_input) {
+        batch.clear();
+        while ((int64_t) batch.size() < batch_size) {
+            if (read_ids) {
+                if (next_arg >= num_read_ids) {
+                    end_of_input = true;
+                    break;
+                }
+                batch.push_back(read_ids[next_arg ++]);
+            } else {
+                ssize_t nread = getline(&line, &cap, read_list_in);
+                if (nread == -1) {
+                    end_of_input = true;
+                    break;
+                }
+                while (nread > 0 && (line[nread - 1] == '\n' || line[nread - 1] == '\r')) {
+                    line[-- nread] = '\0';
+                }
+                if (nread > 0) {
+                    batch.push_back(std::string(line, nread));
+                }
+            }
+        }
+        if (batch.empty()) {
+            break;
+        }
+
+        double start = slow5_realtime();
+        if (client_request(fd, batch, records, found) != 0) {
+            ret = -1;
+            break;
+        }
+        latencies.push_back(slow5_realtime() - start);
+
+        for (size_t i = 0; i < batch.size(); i++) {
+            if (!found[i]) {
+                num_missing++;
+                if (skip_flag) {
+                    WARNING("Read %s was not found", batch[i].c_str());
+                    continue;
+                }
+                ERROR("Read %s was not found", batch[i].c_str());
+                ret = -1;
+                break;
+            }
+            if (!benchmark) {
+                fwrite(records[i].data(), 1, records[i].size(), f_out);
+            }
+        }
+        num_reads += batch.size();
+        if (ret < 0) {
+            break;
+        }
+    }
+    free(line);
+    close(fd);
+
+    if (ret == 0 && !benchmark && binary) {
+        slow5_eof_fwrite(f_out);
+    }
+
+    if (benchmark && !latencies.empty()) {
+        double total = slow5_realtime() - realtime0;
+        std::sort(latencies.begin(), latencies.end());
+        size_t n = latencies.size();
+        fprintf(stderr, "requests\t%ld\n", (long) n);
+        fprintf(stderr, "reads\t%ld\n", (long) num_reads);
+        fprintf(stderr, "missing reads\t%ld\n", (long) num_missing);
+        fprintf(stderr, "latency p50 (ms)\t%.3f\n", latencies[n / 2] * 1e3);
+        fprintf(stderr, "latency p99 (ms)\t%.3f\n", latencies[std::min(n - 1, (size_t) (n * 0.99))] * 1e3);
+        fprintf(stderr, "latency max (ms)\t%.3f\n", latencies[n - 1] * 1e3);
+        fprintf(stderr, "throughput (reads/s)\t%.1f\n", total > 0 ? num_reads / total : 0.0);
+    }
+    return ret;
+}
+
+int serve_main(int argc, char **argv, struct program_meta *meta) {
+
+    // Debug: print arguments
+    print_args(argc,argv);
+
+    // No arguments given
+    if (argc <= 1) {
+        fprintf(stderr, HELP_LARGE_MSG, argv[0], argv[0], argv[0]);
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
+
+    static struct option long_opts[] = {
+        {"help",        no_argument, NULL, 'h' }, //0
+        {"threads",     required_argument, NULL, 't' }, //1
+        {"to",          required_argument, NULL, 'b'}, //2
+        {"compress",    required_argument, NULL, 'c'}, //3
+        {"sig-compress",required_argument, NULL, 's'}, //4
+        {"socket",      required_argument, NULL, 0}, //5
+        {"catalog",     required_argument, NULL, 0}, //6
+        {"max-open",    required_argument, NULL, 0}, //7
+        {"cache-size",  required_argument, NULL, 0}, //8
+        {"connect",     required_argument, NULL, 0}, //9
+        {"batchsize",   required_argument, NULL, 'K'}, //10
+        {"list",        required_argument, NULL, 'l'}, //11
+        {"output",      required_argument, NULL, 'o'}, //12
+        {"skip",        no_argument, NULL, 0}, //13
+        {"bench",       no_argument, NULL, 0}, //14
+        {NULL, 0, NULL, 0 }
+    };
+
+    opt_t user_opts;
+    init_opt(&user_opts);
+
+    char *socket_path = NULL;
+    char *catalog_path = NULL;
+    char *connect_path = NULL;
+    char *read_list_file_in = NULL;
+    int64_t max_open_files = DEFAULT_MAX_OPEN_FILES;
+    int64_t cache_size_mb = DEFAULT_CACHE_SIZE_MB;
+    int skip_flag = 0;
+    bool benchmark = false;
+
+    int opt;
+    int longindex = 0;
+
+    // Parse options
+    while ((opt = getopt_long(argc, argv, "ht:b:c:s:K:l:o:", long_opts, &longindex)) != -1) {
+        DEBUG("opt='%c', optarg=\"%s\", optind=%d, opterr=%d, optopt='%c'",
+                  opt, optarg, optind, opterr, optopt);
+        switch (opt) {
+            case 'b':
+                user_opts.arg_fmt_out = optarg;
+                break;
+            case 'c':
+                user_opts.arg_record_press_out = optarg;
+                break;
+            case 's':
+                user_opts.arg_signal_press_out = optarg;
+                break;
+            case 't':
+                user_opts.arg_num_threads = optarg;
+                break;
+            case 'K':
+                user_opts.arg_batch = optarg;
+                break;
+            case 'l':
+                read_list_file_in = optarg;
+                break;
+            case 'o':
+                user_opts.arg_fname_out = optarg;
+                break;
+            case 'h':
+                DEBUG("displaying large help message%s","");
+                fprintf(stdout, HELP_LARGE_MSG, argv[0], argv[0], argv[0]);
+                EXIT_MSG(EXIT_SUCCESS, argv, meta);
+                exit(EXIT_SUCCESS);
+            case 0  :
+                switch (longindex) {
+                    case 5:
+                        socket_path = optarg;
+                        break;
+                    case 6:
+                        catalog_path = optarg;
+                        break;
+                    case 7:
+                        max_open_files = atol(optarg);
+                        if (max_open_files <= 0) {
+                            ERROR("Maximum number of open files should be larger than 0. You entered %ld", max_open_files);
+                            EXIT_MSG(EXIT_FAILURE, argv, meta);
+                            return EXIT_FAILURE;
+                        }
+                        break;
+                    case 8:
+                        cache_size_mb = atol(optarg);
+                        if (cache_size_mb < 0) {
+                            ERROR("Cache size cannot be negative. You entered %ld", cache_size_mb);
+                            EXIT_MSG(EXIT_FAILURE, argv, meta);
+                            return EXIT_FAILURE;
+                        }
+                        break;
+                    case 9:
+                        connect_path = optarg;
+                        break;
+                    case 13:
+                        skip_flag = 1;
+                        break;
+                    case 14:
+                        benchmark = true;
+                        break;
+                }
+                break;
+            default: // case '?'
+                fprintf(stderr, HELP_SMALL_MSG, argv[0]);
+                EXIT_MSG(EXIT_FAILURE, argv, meta);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if(parse_num_threads(&user_opts,argc,argv,meta) < 0){
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
+    if(parse_batch_size(&user_opts,argc,argv) < 0){
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
+
+    signal(SIGPIPE, SIG_IGN); // a disconnected peer is handled through the write() return value
+    slow5_set_exit_condition(SLOW5_EXIT_OFF); // missing reads are reported to the client
+
+    // client mode
+    if (connect_path) {
+        if (socket_path || catalog_path) {
+            ERROR("--connect cannot be used with --socket or --catalog%s", "");
+            EXIT_MSG(EXIT_FAILURE, argv, meta);
+            return EXIT_FAILURE;
+        }
+        if (benchmark && user_opts.arg_fname_out) {
+            ERROR("Benchmark does not support writing records out%s", "");
+            return EXIT_FAILURE;
+        }
+        if (user_opts.arg_fname_out) {
+            user_opts.f_out = fopen(user_opts.arg_fname_out, "w");
+            if (!user_opts.f_out) {
+                ERROR("File '%s' could not be opened - %s.", user_opts.arg_fname_out, strerror(errno));
+                EXIT_MSG(EXIT_FAILURE, argv, meta);
+                return EXIT_FAILURE;
+            }
+        }
+        FILE *read_list_in = stdin;
+        if (read_list_file_in) {
+            read_list_in = fopen(read_list_file_in, "r");
+            if (!read_list_in) {
+                ERROR("Read id list %s could not be opened - %s.", read_list_file_in, strerror(errno));
+                return EXIT_FAILURE;
+            }
+        }
+        char **read_ids = (optind < argc && !read_list_file_in) ? argv + optind : NULL;
+        int ret = serve_client(connect_path, read_list_in, read_ids, argc - optind, user_opts.read_id_batch_capacity, user_opts.f_out, skip_flag, benchmark);
+        if (read_list_file_in) {
+            fclose(read_list_in);
+        }
+        if (user_opts.arg_fname_out) {
+            fclose(user_opts.f_out);
+        }
+        if (ret < 0) {
+            EXIT_MSG(EXIT_FAILURE, argv, meta);
+            return EXIT_FAILURE;
+        }
+        EXIT_MSG(EXIT_SUCCESS, argv, meta);
+        return EXIT_SUCCESS;
+    }
+
+    // server mode
+    if (!socket_path) {
+        ERROR("missing --socket or --connect%s", "");
+        fprintf(stderr, HELP_SMALL_MSG, argv[0]);
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
+    if ((catalog_path == NULL && optind != argc - 1) || (catalog_path && optind != argc)) {
+        ERROR("expected exactly one slow5 or blow5 file, or --catalog%s", "");
+        fprintf(stderr, HELP_SMALL_MSG, argv[0]);
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
+    if(parse_format_args(&user_opts,argc,argv,meta) < 0){
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
+    if(auto_detect_formats(&user_opts) < 0){
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
+    if(parse_compression_opts(&user_opts) < 0){
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
+
+    server_t server;
+    server.slow5_file = NULL;
+    server.catalog = NULL;
+    server.file_cache = NULL;
+    server.rg_map = NULL;
+    server.format_out = user_opts.fmt_out;
+    server.press_method = {user_opts.record_press_out, user_opts.signal_press_out};
+    server.record_cache.capacity = cache_size_mb * 1024 * 1024;
+    server.record_cache.bytes = 0;
+    server.record_cache.hits = 0;
+    server.record_cache.misses = 0;
+    NEG_CHK(pthread_mutex_init(&server.record_cache.lock, NULL));
+    NEG_CHK(pthread_mutex_init(&server.lock, NULL));
+    NEG_CHK(pthread_cond_init(&server.cond, NULL));
+
+    catalog_t catalog;
+    file_cache_t file_cache;
+    std::vector<std::vector<uint32_t>> rg_map;
+    slow5_file_t *out_file = NULL;
+
+    double realtime0 = slow5_realtime();
+    if (catalog_path) {
+        if (catalog_load(catalog_path, &catalog) < 0) {
+            EXIT_MSG(EXIT_FAILURE, argv, meta);
+            return EXIT_FAILURE;
+        }
+        out_file = slow5_init_empty(NULL, NULL, user_opts.fmt_out);
+        if (slow5_hdr_initialize(out_file->header, 0) < 0) {
+            ERROR("Could not initialize the output header%s", "");
+            return EXIT_FAILURE;
+        }
+        out_file->header->num_read_groups = 0;
+        if (catalog_init_hdr(&catalog, out_file->header, 0, rg_map) < 0) {
+            EXIT_MSG(EXIT_FAILURE, argv, meta);
+            return EXIT_FAILURE;
+        }
+        file_cache_init(&file_cache, &catalog, max_open_files);
+        server.catalog = &catalog;
+        server.file_cache = &file_cache;
+        server.rg_map = &rg_map;
+        server.header = out_file->header;
+    } else {
+        server.slow5_file = slow5_open(argv[optind], "r");
+        F_CHK(server.slow5_file, argv[optind]);
+        if (slow5_idx_load(server.slow5_file) < 0) {
+            ERROR("Error loading index file for %s", argv[optind]);
+            EXIT_MSG(EXIT_FAILURE, argv, meta);
+            return EXIT_FAILURE;
+        }
+        server.header = server.slow5_file->header;
+    }
+
+    size_t header_len;
+    char *header_mem = (char *) slow5_hdr_to_mem(server.header, server.format_out, server.press_method, &header_len);
+    if (!header_mem) {
+        ERROR("Could not encode the output header%s", "");
+        return EXIT_FAILURE;
+    }
+    server.header_mem.assign(header_mem, header_len);
+    free(header_mem);
+    VERBOSE("Loaded the index - took %.3fs", slow5_realtime() - realtime0);
+
+    int listen_fd = serve_listen(socket_path);
+    if (listen_fd < 0) {
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
+
+    // the signal handler and the workers wake up the poll loop through a pipe
+    int wake_pipe[2];
+    if (pipe(wake_pipe) != 0) {
+        ERROR("Could not create a pipe - %s.", strerror(errno));
+        return EXIT_FAILURE;
+    }
+    fcntl(wake_pipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake_pipe[1], F_SETFL, O_NONBLOCK);
+    serve_wake_fd = wake_pipe[1];
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = serve_signal_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    // SIGINT and SIGTERM are blocked in the workers so that they are always delivered to the poll loop
+    sigset_t stop_signals, old_mask;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, &old_mask);
+    std::vector<pthread_t> workers(user_opts.num_threads);
+    for (size_t i = 0; i < workers.size(); i++) {
+        NEG_CHK(pthread_create(&workers[i], NULL, serve_worker, (void *) &server));
+    }
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+    INFO("Listening on %s with %ld worker threads", socket_path, (long) workers.size());
+
+    std::vector<serve_conn_t *> idle; // connections waiting for a request, polled here
+    std::vector<serve_conn_t *> busy; // connections handed to a worker
+    std::vector<struct pollfd> pfds;
+    struct timeval send_timeout = { SERVE_SEND_TIMEOUT, 0 };
+    while (!serve_stop) {
+        pfds.resize(2 + idle.size());
+        pfds[0].fd = wake_pipe[0];
+        pfds[1].fd = listen_fd;
+        for (size_t i = 0; i < idle.size(); i++) {
+            pfds[2 + i].fd = idle[i]->fd;
+        }
+        for (size_t i = 0; i < pfds.size(); i++) {
+            pfds[i].events = POLLIN;
+            pfds[i].revents = 0;
+        }
+        if (poll(pfds.data(), pfds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ERROR("Could not poll the connections - %s.", strerror(errno));
+            break;
+        }
+
+        // connections with a request (or a disconnect) go to the workers
+        size_t n = 0;
+        for (size_t i = 0; i < idle.size(); i++) {
+            if (pfds[2 + i].revents) {
+                busy.push_back(idle[i]);
+                serve_dispatch(&server, idle[i]);
+            } else {
+                idle[n++] = idle[i];
+            }
+        }
+        idle.resize(n);
+
+        if (pfds[0].revents) {
+            char buf[256];
+            while (read(wake_pipe[0], buf, sizeof buf) > 0);
+            pthread_mutex_lock(&server.lock);
+            std::vector<serve_conn_t *> done;
+            done.swap(server.done);
+            pthread_mutex_unlock(&server.lock);
+            for (size_t i = 0; i < done.size(); i++) {
+                busy.erase(std::find(busy.begin(), busy.end(), done[i]));
+                if (done[i]->closed) {
+                    serve_close(done[i]);
+                } else {
+                    idle.push_back(done[i]);
+                }
+            }
+        }
+
+        if (pfds[1].revents) {
+            int fd = accept(listen_fd, NULL, NULL);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                ERROR("Could not accept a connection - %s.", strerror(errno));
+                break;
+            }
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof send_timeout);
+            serve_conn_t *conn = new serve_conn_t;
+            conn->fd = fd;
+            conn->closed = false;
+            idle.push_back(conn);
+        }
+    }
+    close(listen_fd);
+    unlink(socket_path);
+
+    // the requests being answered are finished, but nothing more is read from the clients
+    for (size_t i = 0; i < idle.size(); i++) {
+        serve_close(idle[i]);
+    }
+    for (size_t i = 0; i < busy.size(); i++) {
+        shutdown(busy[i]->fd, SHUT_RD);
+    }
+    for (size_t i = 0; i < workers.size(); i++) {
+        serve_dispatch(&server, NULL);
+    }
+    for (size_t i = 0; i < workers.size(); i++) {
+        NEG_CHK(pthread_join(workers[i], NULL));
+    }
+    for (size_t i = 0; i < busy.size(); i++) {
+        serve_close(busy[i]);
+    }
+    serve_wake_fd = -1;
+    close(wake_pipe[0]);
+    close(wake_pipe[1]);
+    VERBOSE("record cache hits: %" PRIu64 ", misses: %" PRIu64, server.record_cache.hits, server.record_cache.misses);
+
+    if (catalog_path) {
+        file_cache_destroy(&file_cache);
+        slow5_hdr_free(out_file->header);
+        free(out_file);
+    } else {
+        slow5_close(server.slow5_file);
+    }
+    pthread_mutex_destroy(&server.record_cache.lock);
+    pthread_mutex_destroy(&server.lock);
+    pthread_cond_destroy(&server.cond);
+
+    EXIT_MSG(EXIT_SUCCESS, argv, meta);
+    return EXIT_SUCCESS;
+}
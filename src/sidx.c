@@ -0,0 +1,296 @@
+/**
+ * @file sidx.c
+ * @brief secondary indexes: record locations sorted by the value of a primary or auxiliary field
+ * @date 18/10/2026
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include "sidx.h"
+#include "thread.h"
+#include "error.h"
+#include "misc.h"
+#include "slow5_extra.h"
+
+extern int slow5tools_verbosity_level;
+
+static const char *sidx_primary_fields[] = { "read_group", "digitisation", "offset", "range", "sampling_rate", "len_raw_signal" };
+
+typedef struct {
+    const std::vector<std::string> *attrs;
+    std::vector<std::vector<double>> values; // [attr][record in batch]
+    std::vector<std::vector<char>> valid;
+} sidx_batch_t;
+
+std::string sidx_get_path(const char *slow5_path, const char *attr) {
+    return std::string(slow5_path) + "." + attr + SIDX_EXT;
+}
+
+// return 1 if the secondary index exists and is not older than the slow5 file, 0 otherwise
+int sidx_is_fresh(const char *slow5_path, const char *attr) {
+    struct stat st_slow5;
+    struct stat st_sidx;
+    std::string path = sidx_get_path(slow5_path, attr);
+    if (stat(slow5_path, &st_slow5) != 0 || stat(path.c_str(), &st_sidx) != 0) {
+        return 0;
+    }
+    return st_sidx.st_mtime >= st_slow5.st_mtime ? 1 : 0;
+}
+
+static int sidx_is_primary(const char *attr) {
+    for (size_t i = 0; i < sizeof sidx_primary_fields / sizeof *sidx_primary_fields; i++) {
+        if (strcmp(attr, sidx_primary_fields[i]) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// check that attr is a primary field or a numeric (or numeric string) auxiliary field
+int sidx_check_attr(const slow5_hdr_t *header, const char *attr) {
+    if (sidx_is_primary(attr)) {
+        return 0;
+    }
+    uint32_t index;
+    if (header->aux_meta == NULL || check_aux_fields_in_header((slow5_hdr *) header, attr, 0, &index) < 0) {
+        ERROR("Field '%s' is neither a primary field nor an auxiliary field of the file.", attr);
+        return -1;
+    }
+    switch (header->aux_meta->types[index]) {
+        case SLOW5_INT8_T: case SLOW5_INT16_T: case SLOW5_INT32_T: case SLOW5_INT64_T:
+        case SLOW5_UINT8_T: case SLOW5_UINT16_T: case SLOW5_UINT32_T: case SLOW5_UINT64_T:
+        case SLOW5_FLOAT: case SLOW5_DOUBLE: case SLOW5_ENUM: case SLOW5_STRING:
+            return 0;
+        default:
+            ERROR("Field '%s' is not a numeric field and cannot be indexed.", attr);
+            return -1;
+    }
+}
+
+// the numeric value of attr in the record, returns -1 if the value is missing or not a number
+// string fields (e.g. channel_number) are parsed as numbers and enum fields give the label index
+int sidx_get_value(const slow5_rec_t *read, const slow5_hdr_t *header, const char *attr, double *value) {
+    if (strcmp(attr, "read_group") == 0) { *value = read->read_group; return 0; }
+    if (strcmp(attr, "digitisation") == 0) { *value = read->digitisation; return 0; }
+    if (strcmp(attr, "offset") == 0) { *value = read->offset; return 0; }
+    if (strcmp(attr, "range") == 0) { *value = read->range; return 0; }
+    if (strcmp(attr, "sampling_rate") == 0) { *value = read->sampling_rate; return 0; }
+    if (strcmp(attr, "len_raw_signal") == 0) { *value = read->len_raw_signal; return 0; }
+
+    uint32_t index;
+    if (header->aux_meta == NULL || check_aux_fields_in_header((slow5_hdr *) header, attr, 0, &index) < 0) {
+        return -1;
+    }
+    int err = 0;
+    double v = NAN;
+    switch (header->aux_meta->types[index]) {
+        case SLOW5_INT8_T: { int8_t x = slow5_aux_get_int8(read, attr, &err); if (x != INT8_MAX) v = x; break; }
+        case SLOW5_INT16_T: { int16_t x = slow5_aux_get_int16(read, attr, &err); if (x != INT16_MAX) v = x; break; }
+        case SLOW5_INT32_T: { int32_t x = slow5_aux_get_int32(read, attr, &err); if (x != INT32_MAX) v = x; break; }
+        case SLOW5_INT64_T: { int64_t x = slow5_aux_get_int64(read, attr, &err); if (x != INT64_MAX) v = x; break; }
+        case SLOW5_UINT8_T: { uint8_t x = slow5_aux_get_uint8(read, attr, &err); if (x != UINT8_MAX) v = x; break; }
+        case SLOW5_UINT16_T: { uint16_t x = slow5_aux_get_uint16(read, attr, &err); if (x != UINT16_MAX) v = x; break; }
+        case SLOW5_UINT32_T: { uint32_t x = slow5_aux_get_uint32(read, attr, &err); if (x != UINT32_MAX) v = x; break; }
+        case SLOW5_UINT64_T: { uint64_t x = slow5_aux_get_uint64(read, attr, &err); if (x != UINT64_MAX) v = x; break; }
+        case SLOW5_FLOAT: v = slow5_aux_get_float(read, attr, &err); break;
+        case SLOW5_DOUBLE: v = slow5_aux_get_double(read, attr, &err); break;
+        case SLOW5_ENUM: { uint8_t x = slow5_aux_get_enum(read, attr, &err); if (x != SLOW5_ENUM_NULL) v = x; break; }
+        case SLOW5_STRING: {
+            uint64_t len;
+            char *str = slow5_aux_get_string(read, attr, &len, &err);
+            if (str && len > 0) {
+                char *end;
+                std::string s(str, len);
+                v = strtod(s.c_str(), &end);
+                if (*end != '\0') {
+                    v = NAN;
+                }
+            }
+            break;
+        }
+        default:
+            return -1;
+    }
+    if (err < 0 || isnan(v)) {
+        return -1;
+    }
+    *value = v;
+    return 0;
+}
+
+static void sidx_extract_values(core_t *core, db_t *db, int32_t i) {
+    sidx_batch_t *batch = (sidx_batch_t *) core->param;
+    struct slow5_rec *read = NULL;
+    if (slow5_rec_depress_parse(&db->mem_records[i], &db->mem_bytes[i], NULL, &read, core->fp) != 0) {
+        ERROR("Could not decode a record of %s", core->fp->meta.pathname);
+        exit(EXIT_FAILURE);
+    }
+    free(db->mem_records[i]);
+    for (size_t a = 0; a < batch->attrs->size(); a++) {
+        double value;
+        batch->valid[a][i] = sidx_get_value(read, core->fp->header, (*batch->attrs)[a].c_str(), &value) == 0;
+        batch->values[a][i] = batch->valid[a][i] ? value : 0;
+    }
+    slow5_rec_free(read);
+}
+
+// the index is written to a temporary file that is renamed when complete so a reader never sees a partial index
+static int sidx_write(const char *path, const char *attr, const std::vector<sidx_rec_t> &entries) {
+    std::string tmp_path = std::string(path) + ".tmp";
+    FILE *fp = fopen(tmp_path.c_str(), "w");
+    if (!fp) {
+        ERROR("Secondary index file %s could not be opened - %s.", tmp_path.c_str(), strerror(errno));
+        return -1;
+    }
+    const char magic[] = SIDX_MAGIC;
+    fwrite(magic, 1, sizeof magic, fp);
+    uint16_t attr_len = strlen(attr);
+    fwrite(&attr_len, sizeof attr_len, 1, fp);
+    fwrite(attr, 1, attr_len, fp);
+    uint64_t num_entries = entries.size();
+    fwrite(&num_entries, sizeof num_entries, 1, fp);
+    fwrite(entries.data(), sizeof(sidx_rec_t), num_entries, fp);
+    const char eof[] = SIDX_EOF;
+    fwrite(eof, 1, sizeof eof, fp);
+    if (ferror(fp) || fclose(fp) != 0) {
+        ERROR("Could not write the secondary index file %s.", tmp_path.c_str());
+        unlink(tmp_path.c_str());
+        return -1;
+    }
+    if (rename(tmp_path.c_str(), path) != 0) {
+        ERROR("Could not rename %s to %s - %s.", tmp_path.c_str(), path, strerror(errno));
+        unlink(tmp_path.c_str());
+        return -1;
+    }
+    return 0;
+}
+
+// build a secondary index for each of attrs in a single pass over the records, decoding in parallel
+int sidx_build(slow5_file_t *slow5_file, const std::vector<std::string> &attrs, int32_t num_threads, int64_t batch_size) {
+    for (size_t a = 0; a < attrs.size(); a++) {
+        if (sidx_check_attr(slow5_file->header, attrs[a].c_str()) < 0) {
+            return -1;
+        }
+    }
+
+    std::vector<std::vector<sidx_rec_t>> entries(attrs.size());
+    sidx_batch_t batch;
+    batch.attrs = &attrs;
+    batch.values.resize(attrs.size(), std::vector<double>(batch_size));
+    batch.valid.resize(attrs.size(), std::vector<char>(batch_size));
+    std::vector<uint64_t> offsets(batch_size + 1);
+
+    core_t core;
+    core.num_thread = num_threads;
+    core.fp = slow5_file;
+    core.param = &batch;
+
+    db_t db = { 0 };
+    db.mem_records = (char **) malloc(batch_size * sizeof(char*));
+    db.mem_bytes = (size_t *) malloc(batch_size * sizeof(size_t));
+    MALLOC_CHK(db.mem_records);
+    MALLOC_CHK(db.mem_bytes);
+
+    int flag_end_of_file = 0;
+    while (!flag_end_of_file) {
+        int64_t record_count = 0;
+        size_t bytes;
+        char *mem;
+        offsets[0] = ftello(slow5_file->fp);
+        while (record_count < batch_size) {
+            if (!(mem = (char *) slow5_get_next_mem(&bytes, slow5_file))) {
+                if (slow5_errno != SLOW5_ERR_EOF) {
+                    ERROR("Error reading the file %s.", slow5_file->meta.pathname);
+                    free(db.mem_records);
+                    free(db.mem_bytes);
+                    return -1;
+                }
+                flag_end_of_file = 1;
+                break;
+            }
+            db.mem_records[record_count] = mem;
+            db.mem_bytes[record_count] = bytes;
+            record_count++;
+            offsets[record_count] = ftello(slow5_file->fp);
+        }
+
+        db.n_batch = record_count;
+        work_db(&core, &db, sidx_extract_values);
+
+        for (size_t a = 0; a < attrs.size(); a++) {
+            for (int64_t i = 0; i < record_count; i++) {
+                if (batch.valid[a][i]) {
+                    sidx_rec_t rec = { batch.values[a][i], offsets[i], offsets[i + 1] - offsets[i] };
+                    entries[a].push_back(rec);
+                }
+            }
+        }
+    }
+    free(db.mem_records);
+    free(db.mem_bytes);
+
+    for (size_t a = 0; a < attrs.size(); a++) {
+        std::sort(entries[a].begin(), entries[a].end(), [](const sidx_rec_t &x, const sidx_rec_t &y) {
+            return x.value != y.value ? x.value < y.value : x.offset < y.offset;
+        });
+        if (sidx_write(sidx_get_path(slow5_file->meta.pathname, attrs[a].c_str()).c_str(), attrs[a].c_str(), entries[a]) < 0) {
+            return -1;
+        }
+        VERBOSE("Secondary index on '%s' has %ld records", attrs[a].c_str(), (long) entries[a].size());
+    }
+    return 0;
+}
+
+int sidx_load(const char *slow5_path, const char *attr, std::vector<sidx_rec_t> &entries) {
+    std::string path = sidx_get_path(slow5_path, attr);
+    if (!sidx_is_fresh(slow5_path, attr)) {
+        ERROR("No up-to-date secondary index %s. Create it using slow5tools index --attr %s %s.", path.c_str(), attr, slow5_path);
+        return -1;
+    }
+    FILE *fp = fopen(path.c_str(), "r");
+    if (!fp) {
+        ERROR("Secondary index file %s could not be opened - %s.", path.c_str(), strerror(errno));
+        return -1;
+    }
+    const char magic[] = SIDX_MAGIC;
+    const char eof[] = SIDX_EOF;
+    char buf[sizeof magic];
+    uint16_t attr_len;
+    uint64_t num_entries;
+    std::string stored_attr;
+    struct stat st;
+    off_t entries_start;
+    if (fstat(fileno(fp), &st) != 0 || fread(buf, 1, sizeof magic, fp) != sizeof magic || memcmp(buf, magic, sizeof magic) != 0 ||
+        fread(&attr_len, sizeof attr_len, 1, fp) != 1) {
+        goto malformed;
+    }
+    stored_attr.resize(attr_len);
+    if ((attr_len > 0 && fread(&stored_attr[0], 1, attr_len, fp) != attr_len) || stored_attr != attr ||
+        fread(&num_entries, sizeof num_entries, 1, fp) != 1) {
+        goto malformed;
+    }
+    // the count is checked against the file size before allocating, so a truncated or corrupt file is not trusted
+    entries_start = ftello(fp);
+    if (entries_start < 0 || st.st_size < entries_start + (off_t) sizeof eof ||
+        num_entries != (uint64_t) (st.st_size - entries_start - sizeof eof) / sizeof(sidx_rec_t) ||
+        (uint64_t) (st.st_size - entries_start - sizeof eof) % sizeof(sidx_rec_t) != 0) {
+        goto malformed;
+    }
+    entries.resize(num_entries);
+    if (fread(entries.data(), sizeof(sidx_rec_t), num_entries, fp) != num_entries ||
+        fread(buf, 1, sizeof eof, fp) != sizeof eof || memcmp(buf, eof, sizeof eof) != 0) {
+        goto malformed;
+    }
+    fclose(fp);
+    return 0;
+
+malformed:
+    ERROR("Secondary index file %s is malformed. Recreate it using slow5tools index --attr.", path.c_str());
+    fclose(fp);
+    return -1;
+}
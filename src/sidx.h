@@ -0,0 +1,29 @@
+// Secondary indexes: record locations sorted by the value of a primary or auxiliary field
+
+#ifndef SIDX_H
+#define SIDX_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <slow5/slow5.h>
+
+#define SIDX_MAGIC { 'S', 'L', 'O', 'W', '5', 'S', 'I', 'X', '\1' }
+#define SIDX_EOF { 'X', 'I', 'S', '5', 'W', 'O', 'L', 'S' }
+#define SIDX_EXT ".sidx"
+
+/* the record at [offset, offset+size) (same convention as the .idx) has the given field value */
+typedef struct {
+    double value;
+    uint64_t offset;
+    uint64_t size;
+} sidx_rec_t;
+
+std::string sidx_get_path(const char *slow5_path, const char *attr);
+int sidx_is_fresh(const char *slow5_path, const char *attr);
+int sidx_check_attr(const slow5_hdr_t *header, const char *attr);
+int sidx_get_value(const slow5_rec_t *read, const slow5_hdr_t *header, const char *attr, double *value);
+int sidx_build(slow5_file_t *slow5_file, const std::vector<std::string> &attrs, int32_t num_threads, int64_t batch_size);
+int sidx_load(const char *slow5_path, const char *attr, std::vector<sidx_rec_t> &entries);
+
+#endif
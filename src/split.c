@@ -7,14 +7,19 @@
 
 #include <getopt.h>
 #include <sys/wait.h>
+#include <pthread.h>
 #include <string>
 #include <vector>
+#include <deque>
+#include <map>
+#include <algorithm>
 #include "error.h"
 #include "cmd.h"
 #include "misc.h"
 #include "slow5_extra.h"
 #include "read_fast5.h"
 #include "thread.h"
+#include "idx_utils.h"
 
 #define USAGE_MSG "Usage: %s [OPTIONS] [SLOW5_FILE/DIR] ...\n"
 #define HELP_LARGE_MSG \
@@ -28,9 +33,14 @@
     "    -g, --groups                  split multi read group file into single read group files\n" \
     "    -r, --reads [INT]             split into n reads, i.e., each file will have n reads\n"    \
     "    -f, --files [INT]             split reads into n files evenly \n"              \
+    "        --bytes SIZE              split into files of about SIZE bytes each (e.g. 20G)\n" \
+    "        --balance STR             balance the files of -f by records or bytes [records if indexed]\n" \
+    "        --by STR                  split by a key: hash:N, channel or start_time:WINDOW (e.g. start_time:1h)\n" \
     HELP_MSG_THREADS \
     HELP_MSG_BATCH \
     HELP_MSG_LOSSLESS \
+    HELP_MSG_INDEX \
+    "        --writers INT             number of output files written at once [" TO_STR(DEFAULT_SPLIT_WRITERS) "]\n" \
     HELP_MSG_HELP \
     HELP_FORMATS_METHODS
 
@@ -41,34 +51,362 @@ enum SplitMethod {
     READS_SPLIT,
     FILE_SPLIT,
     GROUP_SPLIT,
+    BYTES_SPLIT,
+    KEY_SPLIT,
 };
+
+// --by: the output file of a record is given by a key computed from the record
+#define SPLIT_BY_HASH 1         // hash of the read id modulo by_n
+#define SPLIT_BY_CHANNEL 2      // channel_number
+#define SPLIT_BY_START_TIME 3   // start_time in windows of by_window seconds
+
 typedef struct {
     SplitMethod splitMethod = READS_SPLIT;
     size_t n;
+    int64_t bytes = 0;       // input bytes per output file for --bytes
+    int balance_bytes = 0;   // -f balances the files by size instead of number of records (--balance bytes)
+    int balance_records = 0; // -f balances the files by number of records even without an index (--balance records)
+    int by = 0;
+    uint32_t by_n = 0;
+    double by_window = 0;
 }meta_split_method;
 
-int split_func(std::vector<std::string> slow5_files_input, opt_t user_opts, meta_split_method  meta_split_method_object);
+#define SPLIT_WRITER_QUEUE_BYTES (64 * 1024 * 1024) // bytes queued for a writer before the records are held back
+#define SPLIT_FD_RESERVE 64 // file descriptors left for the input, the index files, the standard streams and the libraries
+
+// how a record handed to a writer is framed in the output
+#define SPLIT_FRAME_NONE 0   // the record is written as it is
+#define SPLIT_FRAME_BINARY 1 // the record is preceded by its size (raw BLOW5 record)
+#define SPLIT_FRAME_ASCII 2  // the record is followed by a newline (raw SLOW5 record)
+
+// an output file being written by a writer thread
+typedef struct {
+    slow5_file_t *file;
+    std::string path;
+    std::vector<idx_rec_t> idx_entries;
+    int64_t num_records;
+    size_t writer;
+    int err;
+} split_output_t;
+
+typedef struct {
+    split_output_t *out;
+    char *mem;      // NULL for the job that finishes the output
+    size_t bytes;
+    char *read_id;  // for --index
+    int framing;
+    int remove_if_empty;
+} split_job_t;
+
+typedef struct {
+    std::deque<split_job_t> jobs;
+    size_t queued_bytes;
+    pthread_t thread;
+} split_writer_t;
+
+// writer threads that write the output files concurrently, each output being written by one of them in the order of its records
+// the records of the outputs of -r and -f are written while the next outputs are being filled, up to max_open outputs at once
+typedef struct {
+    std::vector<split_writer_t> writers;
+    size_t max_open;
+    size_t num_open;    // outputs opened and not yet finished
+    size_t next_writer;
+    int fmt_out;
+    int flag_index;
+    int err;
+    int stop;
+    pthread_mutex_t lock;
+    pthread_cond_t cond_writer;
+    pthread_cond_t cond_producer;
+} split_writers_t;
+
+typedef struct {
+    split_writers_t *pool;
+    size_t w;
+} split_writer_arg_t;
+
+static int split_write_record(split_writers_t *pool, split_job_t *job) {
+    split_output_t *out = job->out;
+    FILE *fp = out->file->fp;
+    off_t offset = job->read_id ? ftello(fp) : 0;
+    int ret = 0;
+    if (job->framing == SPLIT_FRAME_BINARY) {
+        slow5_rec_size_t record_size = job->bytes;
+        ret |= fwrite(&record_size, sizeof record_size, 1, fp) != 1;
+    }
+    ret |= fwrite(job->mem, 1, job->bytes, fp) != job->bytes;
+    if (job->framing == SPLIT_FRAME_ASCII) {
+        ret |= fwrite("\n", 1, 1, fp) != 1;
+    }
+    if (job->read_id) {
+        idx_add(out->idx_entries, job->read_id, offset, ftello(fp) - offset);
+    }
+    out->num_records++;
+    return ret ? -1 : 0;
+}
+
+static int split_finish_output(split_writers_t *pool, split_job_t *job) {
+    split_output_t *out = job->out;
+    if (pool->fmt_out == SLOW5_FORMAT_BINARY) {
+        slow5_eof_fwrite(out->file->fp);
+    }
+    if (slow5_close(out->file) == EOF) {
+        out->err = 1;
+    }
+    if (out->err) {
+        ERROR("Could not write %s - %s.", out->path.c_str(), strerror(errno));
+        idx_entries_free(out->idx_entries);
+        return -1;
+    }
+    if (job->remove_if_empty && out->num_records == 0) {
+        if (remove(out->path.c_str())) {
+            WARNING("Deleting additional file %s failed - %s.", out->path.c_str(), strerror(errno));
+        }
+        return 0;
+    }
+    if (pool->flag_index && idx_finish(out->path.c_str(), out->idx_entries) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static void *split_writer(void *arg) {
+    split_writers_t *pool = ((split_writer_arg_t *) arg)->pool;
+    split_writer_t *writer = &pool->writers[((split_writer_arg_t *) arg)->w];
+    free(arg);
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        while (writer->jobs.empty() && !pool->stop) {
+            pthread_cond_wait(&pool->cond_writer, &pool->lock);
+        }
+        if (writer->jobs.empty()) {
+            break; // stopped and drained
+        }
+        split_job_t job = writer->jobs.front();
+        writer->jobs.pop_front();
+        pthread_mutex_unlock(&pool->lock);
+
+        int ret = 0;
+        if (job.mem) {
+            if (!job.out->err && split_write_record(pool, &job) < 0) {
+                job.out->err = 1;
+            }
+            free(job.mem);
+            free(job.read_id);
+        } else {
+            ret = split_finish_output(pool, &job);
+            delete job.out;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        writer->queued_bytes -= job.bytes;
+        if (!job.mem) {
+            pool->num_open--;
+        }
+        if (ret < 0) {
+            pool->err = 1;
+        }
+        pthread_cond_broadcast(&pool->cond_producer);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    pthread_exit(0);
+}
+
+static void split_writers_init(split_writers_t *pool, size_t num_writers, int fmt_out, int flag_index) {
+    pool->writers.resize(num_writers);
+    pool->max_open = num_writers;
+    pool->num_open = 0;
+    pool->next_writer = 0;
+    pool->fmt_out = fmt_out;
+    pool->flag_index = flag_index;
+    pool->err = 0;
+    pool->stop = 0;
+    NEG_CHK(pthread_mutex_init(&pool->lock, NULL));
+    NEG_CHK(pthread_cond_init(&pool->cond_writer, NULL));
+    NEG_CHK(pthread_cond_init(&pool->cond_producer, NULL));
+    for (size_t w = 0; w < num_writers; w++) {
+        pool->writers[w].queued_bytes = 0;
+        split_writer_arg_t *arg = (split_writer_arg_t *) malloc(sizeof *arg);
+        MALLOC_CHK(arg);
+        arg->pool = pool;
+        arg->w = w;
+        NEG_CHK(pthread_create(&pool->writers[w].thread, NULL, split_writer, (void *) arg));
+    }
+}
+
+// hand an output file whose header has been written over to a writer
+static split_output_t *split_writers_open(split_writers_t *pool, slow5_file_t *file, const char *path) {
+    split_output_t *out = new split_output_t;
+    out->file = file;
+    out->path = path;
+    out->num_records = 0;
+    out->err = 0;
+    pthread_mutex_lock(&pool->lock);
+    pool->num_open++;
+    out->writer = pool->next_writer++ % pool->writers.size();
+    pthread_mutex_unlock(&pool->lock);
+    return out;
+}
+
+// wait until fewer than max_open outputs are still being written, before opening the next output of -r or -f
+static void split_writers_wait_open(split_writers_t *pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->num_open >= pool->max_open) {
+        pthread_cond_wait(&pool->cond_producer, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void split_writers_submit(split_writers_t *pool, split_job_t job) {
+    split_writer_t *writer = &pool->writers[job.out->writer];
+    pthread_mutex_lock(&pool->lock);
+    while (job.mem && writer->queued_bytes >= SPLIT_WRITER_QUEUE_BYTES) {
+        pthread_cond_wait(&pool->cond_producer, &pool->lock);
+    }
+    writer->queued_bytes += job.bytes;
+    writer->jobs.push_back(job);
+    pthread_cond_broadcast(&pool->cond_writer);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// queue a record for an output; mem and read_id are freed by the writer
+static void split_writers_write(split_writers_t *pool, split_output_t *out, char *mem, size_t bytes, char *read_id, int framing) {
+    split_job_t job = { out, mem, bytes, read_id, framing, 0 };
+    split_writers_submit(pool, job);
+}
+
+// queue the end of an output: the end of file marker, the index and closing it (or removing it if it has no records and remove_if_empty is set)
+static void split_writers_close(split_writers_t *pool, split_output_t *out, int remove_if_empty) {
+    split_job_t job = { out, NULL, 0, NULL, SPLIT_FRAME_NONE, remove_if_empty };
+    split_writers_submit(pool, job);
+}
+
+// write everything that is queued and stop the writers; returns -1 if an output could not be written
+static int split_writers_destroy(split_writers_t *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->cond_writer);
+    pthread_mutex_unlock(&pool->lock);
+    for (size_t w = 0; w < pool->writers.size(); w++) {
+        NEG_CHK(pthread_join(pool->writers[w].thread, NULL));
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->cond_writer);
+    pthread_cond_destroy(&pool->cond_producer);
+    return pool->err ? -1 : 0;
+}
+
+// the outputs of --by, created as their keys are met
+typedef struct {
+    const meta_split_method *method;
+    std::map<uint32_t, split_output_t*> outputs;
+    size_t max_outputs; // outputs that may be open at once, see split_fd_budget
+} split_keyed_t;
+
+// the number of output files of --by that may be open at once under the limit of open files
+static size_t split_fd_budget() {
+    struct rlimit rlim;
+    if (getrlimit(RLIMIT_NOFILE, &rlim) != 0 || rlim.rlim_cur == RLIM_INFINITY) {
+        return SIZE_MAX;
+    }
+    return rlim.rlim_cur > SPLIT_FD_RESERVE + 1 ? rlim.rlim_cur - SPLIT_FD_RESERVE : 1;
+}
+
+int split_func(std::vector<std::string> slow5_files_input, opt_t user_opts, meta_split_method  meta_split_method_object, size_t num_writers);
 
 int read_file_split_func(std::basic_string<char> &input_slow5_path, slow5_file_t * input_slow5_file_i, opt_t user_opts, std::string extension,
                     slow5_press_method_t press_out, meta_split_method meta_split_method_object,
-                    int flag_single_threaded_execution);
+                    int flag_single_threaded_execution, split_writers_t *writers);
 
 int single_threaded_split_execution(std::basic_string<char> &input_slow5_path, opt_t user_opts, std::string extension,
-                                              slow5_press_method_t press_out, int64_t read_limit,
-                                              int64_t *record_count_ptr, int* flag_EOF_ptr, slow5_file_t * input_slow5_file_i, slow5_file_t * slow5_file_out);
+                                              slow5_press_method_t press_out, int64_t read_limit, off_t input_limit,
+                                              int64_t *record_count_ptr, int* flag_EOF_ptr, slow5_file_t * input_slow5_file_i, split_output_t *output,
+                                              split_writers_t *writers);
 
 int multi_threaded_split_execution(std::basic_string<char> &input_slow5_path, opt_t user_opts, std::string extension,
-                                             slow5_press_method_t press_out, int64_t read_limit,
-                                             int64_t *record_count_ptr, int* flag_EOF_ptr, slow5_file_t * input_slow5_file_i, std::vector<slow5_file_t*> output_slow5_files);
+                                             slow5_press_method_t press_out, int64_t read_limit, off_t input_limit,
+                                             int64_t *record_count_ptr, int* flag_EOF_ptr, slow5_file_t * input_slow5_file_i, std::vector<split_output_t*> &outputs,
+                                             split_writers_t *writers, split_keyed_t *keyed);
 
 int group_split_func(std::basic_string<char> &input_slow5_path, slow5_file_t * input_slow5_file_i, opt_t user_opts, std::string extension,
                          slow5_press_method_t press_out, meta_split_method meta_split_method_object,
-                         int flag_single_threaded_execution);
+                         int flag_single_threaded_execution, split_writers_t *writers);
+
+int key_split_func(std::basic_string<char> &input_slow5_path, slow5_file_t * input_slow5_file_i, opt_t user_opts, std::string extension,
+                   slow5_press_method_t press_out, meta_split_method meta_split_method_object, split_writers_t *writers);
 
 int create_output_slow5(slow5_file_t *input_slow5_file_i, slow5_file_t *&slow5_file_out, opt_t user_opts,
                         std::basic_string<char> &input_slow5_path, char** slow5_path_out_char_array, slow5_press_method_t press_out,
                         std::string extension, uint32_t file_index, uint32_t read_group_index);
 
+// parse the argument of --by into method, returns -1 if it is invalid
+static int split_parse_by(const char *arg, meta_split_method *method) {
+    char *endptr;
+    if (strncmp(arg, "hash:", 5) == 0) {
+        long n = strtol(arg + 5, &endptr, 10);
+        if (*endptr == '\0' && n > 0 && n <= UINT32_MAX) {
+            method->by = SPLIT_BY_HASH;
+            method->by_n = n;
+            return 0;
+        }
+    } else if (strcmp(arg, "channel") == 0) {
+        method->by = SPLIT_BY_CHANNEL;
+        return 0;
+    } else if (strncmp(arg, "start_time:", 11) == 0) {
+        // the window is in seconds, or in minutes or hours with an m or h suffix
+        double window = strtod(arg + 11, &endptr);
+        if (endptr != arg + 11 && (*endptr == '\0' || endptr[1] == '\0')) {
+            switch (*endptr) {
+                case 'h': window *= 60;
+                // fall through
+                case 'm': window *= 60;
+                // fall through
+                case 's': case '\0':
+                    if (window > 0) {
+                        method->by = SPLIT_BY_START_TIME;
+                        method->by_window = window;
+                        return 0;
+                    }
+            }
+        }
+    }
+    ERROR("invalid split key -- '%s' (expected hash:N, channel or start_time:WINDOW)", arg);
+    return -1;
+}
+
+// the key of a record for --by, which is the index of its output file
+static uint32_t split_key(const slow5_rec_t *read, const meta_split_method *method) {
+    int err = 0;
+    if (method->by == SPLIT_BY_HASH) {
+        uint64_t hash = 0xcbf29ce484222325ULL; // FNV-1a, so that a read id always gets the same output
+        for (const char *c = read->read_id; *c; c++) {
+            hash ^= (unsigned char) *c;
+            hash *= 0x100000001b3ULL;
+        }
+        return hash % method->by_n;
+    } else if (method->by == SPLIT_BY_CHANNEL) {
+        uint64_t len = 0;
+        char *channel = slow5_aux_get_string(read, "channel_number", &len, &err);
+        char buf[32] = { 0 }; // the string is not necessarily null terminated
+        if (err == 0 && channel) {
+            memcpy(buf, channel, len < sizeof buf - 1 ? len : sizeof buf - 1);
+        }
+        char *endptr = buf;
+        unsigned long key = strtoul(buf, &endptr, 10);
+        if (err < 0 || !channel || endptr == buf || key > UINT32_MAX) {
+            ERROR("Could not get a channel_number for read %s", read->read_id);
+            exit(EXIT_FAILURE);
+        }
+        return key;
+    }
+    uint64_t start_time = slow5_aux_get_uint64(read, "start_time", &err);
+    if (err < 0 || start_time == UINT64_MAX || !(read->sampling_rate > 0)) {
+        ERROR("Could not get the start_time of read %s", read->read_id);
+        exit(EXIT_FAILURE);
+    }
+    return (uint32_t) (start_time / read->sampling_rate / method->by_window);
+}
+
 void split_thread_func(core_t *core, db_t *db, int32_t i) {
     //
     struct slow5_rec *read = NULL;
@@ -97,6 +435,13 @@ void split_thread_func(core_t *core, db_t *db, int32_t i) {
     }
     slow5_press_free(press_ptr);
     db->read_record[i].len = len;
+    if (db->read_id) { // --index
+        db->read_id[i] = strdup(read->read_id);
+        MALLOC_CHK(db->read_id[i]);
+    }
+    if (core->param) { // --by
+        db->read_group_vector[i] = split_key(read, (const meta_split_method *) core->param);
+    }
     slow5_rec_free(read);
 }
 
@@ -127,6 +472,11 @@ int split_main(int argc, char **argv, struct program_meta *meta){
             {"files",       required_argument, NULL, 'f'}, //9
             {"reads",       required_argument, NULL, 'r'}, //10
             {"batchsize",   required_argument, NULL, 'K'}, //11
+            {"index",       no_argument, NULL, 0},         //12
+            {"writers",     required_argument, NULL, 0}, //13
+            {"bytes",       required_argument, NULL, 0}, //14
+            {"balance",     required_argument, NULL, 0}, //15
+            {"by",          required_argument, NULL, 0}, //16
             {NULL, 0, NULL, 0 }
     };
 
@@ -136,6 +486,10 @@ int split_main(int argc, char **argv, struct program_meta *meta){
 
     opt_t user_opts;
     init_opt(&user_opts);
+    const char *arg_writers = NULL;
+    size_t num_writers = DEFAULT_SPLIT_WRITERS;
+    const char *arg_bytes = NULL;
+    const char *arg_balance = NULL;
 
     int opt;
     int longindex = 0;
@@ -185,6 +539,31 @@ int split_main(int argc, char **argv, struct program_meta *meta){
             case 'K':
                 user_opts.arg_batch = optarg;
                 break;
+            case 0  :
+                switch (longindex) {
+                    case 12:
+                        user_opts.flag_index = 1;
+                        break;
+                    case 13:
+                        arg_writers = optarg;
+                        break;
+                    case 14:
+                        meta_split_method_object.splitMethod = BYTES_SPLIT;
+                        arg_bytes = optarg;
+                        break;
+                    case 15:
+                        arg_balance = optarg;
+                        break;
+                    case 16:
+                        meta_split_method_object.splitMethod = KEY_SPLIT;
+                        if (split_parse_by(optarg, &meta_split_method_object) < 0) {
+                            fprintf(stderr, HELP_SMALL_MSG, argv[0]);
+                            EXIT_MSG(EXIT_FAILURE, argv, meta);
+                            return EXIT_FAILURE;
+                        }
+                        break;
+                }
+                break;
             default: // case '?'
                 fprintf(stderr, HELP_SMALL_MSG, argv[0]);
                 EXIT_MSG(EXIT_FAILURE, argv, meta);
@@ -215,6 +594,43 @@ int split_main(int argc, char **argv, struct program_meta *meta){
         EXIT_MSG(EXIT_FAILURE, argv, meta);
         return EXIT_FAILURE;
     }
+    if (arg_writers) {
+        char *endptr;
+        long ret = strtol(arg_writers, &endptr, 10);
+        if (*endptr != '\0' || ret < 1) {
+            ERROR("invalid number of writers -- '%s'", arg_writers);
+            fprintf(stderr, HELP_SMALL_MSG, argv[0]);
+            EXIT_MSG(EXIT_FAILURE, argv, meta);
+            return EXIT_FAILURE;
+        }
+        num_writers = ret;
+    }
+    if (meta_split_method_object.splitMethod == BYTES_SPLIT) {
+        meta_split_method_object.bytes = parse_size(arg_bytes);
+        if (meta_split_method_object.bytes <= 0) {
+            ERROR("invalid size -- '%s'", arg_bytes);
+            fprintf(stderr, HELP_SMALL_MSG, argv[0]);
+            EXIT_MSG(EXIT_FAILURE, argv, meta);
+            return EXIT_FAILURE;
+        }
+    }
+    if (arg_balance) {
+        if (strcmp(arg_balance, "bytes") == 0) {
+            meta_split_method_object.balance_bytes = 1;
+        } else if (strcmp(arg_balance, "records") == 0) {
+            meta_split_method_object.balance_records = 1;
+        } else {
+            ERROR("Incorrect value for --balance. Only 'records' or 'bytes' are accepted. You entered %s", arg_balance);
+            fprintf(stderr, HELP_SMALL_MSG, argv[0]);
+            EXIT_MSG(EXIT_FAILURE, argv, meta);
+            return EXIT_FAILURE;
+        }
+        if (meta_split_method_object.splitMethod != FILE_SPLIT) {
+            ERROR("--balance can only be used with -f%s", "");
+            EXIT_MSG(EXIT_FAILURE, argv, meta);
+            return EXIT_FAILURE;
+        }
+    }
     if(meta_split_method_object.splitMethod == READS_SPLIT && meta_split_method_object.n == 0){
         ERROR("Default splitting method - reads split is used. Specify the number of reads to include in a slow5 file%s","");
         return EXIT_FAILURE;
@@ -223,6 +639,13 @@ int split_main(int argc, char **argv, struct program_meta *meta){
         ERROR("Splitting method - files split is used. Specify the number of files to create from a slow5 file%s","");
         return EXIT_FAILURE;
     }
+    if (meta_split_method_object.by == SPLIT_BY_HASH && meta_split_method_object.by_n > split_fd_budget()) {
+        // all the output files of --by are open until an input is read
+        ERROR("--by hash:%" PRIu32 " needs more output files open at once than the %zu the limit of open files allows. Raise it (ulimit -n) or use fewer files.",
+              meta_split_method_object.by_n, split_fd_budget());
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
     if(!user_opts.arg_dir_out){
         ERROR("The output directory must be specified %s","");
         return EXIT_FAILURE;
@@ -246,6 +669,10 @@ int split_main(int argc, char **argv, struct program_meta *meta){
         VERBOSE("An input slow5 file will be split such that each output file has %lu reads", meta_split_method_object.n);
     }else if(meta_split_method_object.splitMethod == FILE_SPLIT){
         VERBOSE("An input slow5 file will be split into %lu output files", meta_split_method_object.n);
+    }else if(meta_split_method_object.splitMethod == BYTES_SPLIT){
+        VERBOSE("An input slow5 file will be split into output files of about %" PRId64 " bytes", meta_split_method_object.bytes);
+    }else if(meta_split_method_object.splitMethod == KEY_SPLIT){
+        VERBOSE("An input slow5 file will be split into output files by a key of each read%s", "");
     } else{
         VERBOSE("An input multi read group slow5 files will be split into single read group slow5 files %s","");
     }
@@ -261,7 +688,7 @@ int split_main(int argc, char **argv, struct program_meta *meta){
         return EXIT_FAILURE;
     }
 
-    int ret_split_func = split_func(slow5_files_input, user_opts, meta_split_method_object);
+    int ret_split_func = split_func(slow5_files_input, user_opts, meta_split_method_object, num_writers);
     if(ret_split_func){
         return EXIT_FAILURE;
     }
@@ -271,33 +698,41 @@ int split_main(int argc, char **argv, struct program_meta *meta){
     return EXIT_SUCCESS;
 }
 
-int split_func(std::vector<std::string> slow5_files_input, opt_t user_opts, meta_split_method meta_split_method_object) {
+int split_func(std::vector<std::string> slow5_files_input, opt_t user_opts, meta_split_method meta_split_method_object, size_t num_writers) {
     std::string extension = ".blow5";
     if(user_opts.fmt_out == SLOW5_FORMAT_ASCII){
         extension = ".slow5";
     }
     slow5_press_method_t press_out = {user_opts.record_press_out,user_opts.signal_press_out};
 
-    for(size_t i=0; i < slow5_files_input.size(); i++) {
+    // the outputs are written by a pool of writers while the next records are read and converted
+    split_writers_t writers;
+    split_writers_init(&writers, num_writers, user_opts.fmt_out, user_opts.flag_index);
+    int ret = 0;
+    for(size_t i=0; i < slow5_files_input.size() && ret == 0; i++) {
         slow5_file_t *input_slow5_file_i = slow5_open(slow5_files_input[i].c_str(), "r");
         if (!input_slow5_file_i) {
             ERROR("Cannot open %s. Skipping.\n", slow5_files_input[i].c_str());
-            return -1;
+            ret = -1;
+            break;
         }
         uint32_t read_group_count_i = input_slow5_file_i->header->num_read_groups;
 
         if (read_group_count_i == 1 && meta_split_method_object.splitMethod == GROUP_SPLIT) {
             ERROR("The file %s already has a single read group", slow5_files_input[i].c_str());
-            return -1;
+            ret = -1;
+            break;
         }
         if (read_group_count_i > 1 && meta_split_method_object.splitMethod != GROUP_SPLIT) {
             ERROR("The file %s contains multiple read groups. You must first separate the read groups using -g. See https://slow5.page.link/faq for more info.", slow5_files_input[i].c_str());
-            return -1;
+            ret = -1;
+            break;
         }
         if(user_opts.flag_lossy==0 && input_slow5_file_i->header->aux_meta == NULL){
             ERROR("%s has no auxiliary fields. Specify -l false to merge files with no auxiliary fields.", slow5_files_input[i].c_str());
             slow5_close(input_slow5_file_i);
-            return -1;
+            ret = -1;
+            break;
         }
         int flag_single_threaded_execution = 0;
         int flag_auxiliary_data_available = (input_slow5_file_i->header->aux_meta==NULL)?0:1;
@@ -310,110 +745,330 @@ int split_func(std::vector<std::string> slow5_files_input, opt_t user_opts, meta
         if(user_opts.flag_lossy==flag_auxiliary_data_available){
             flag_single_threaded_execution = 0;
         }
-        if (meta_split_method_object.splitMethod == READS_SPLIT || meta_split_method_object.splitMethod == FILE_SPLIT) {
-            int ret_read_file_split_func = read_file_split_func(slow5_files_input[i], input_slow5_file_i, user_opts, extension, press_out, meta_split_method_object, flag_single_threaded_execution);
+        if (meta_split_method_object.splitMethod == READS_SPLIT || meta_split_method_object.splitMethod == FILE_SPLIT || meta_split_method_object.splitMethod == BYTES_SPLIT) {
+            int ret_read_file_split_func = read_file_split_func(slow5_files_input[i], input_slow5_file_i, user_opts, extension, press_out, meta_split_method_object, flag_single_threaded_execution, &writers);
             if(ret_read_file_split_func){
-                return -1;
+                ret = -1;
+                break;
+            }
+        }
+        else if (meta_split_method_object.splitMethod == KEY_SPLIT) {
+            int ret_key_split_func = key_split_func(slow5_files_input[i], input_slow5_file_i, user_opts, extension, press_out, meta_split_method_object, &writers);
+            if(ret_key_split_func){
+                ret = -1;
+                break;
             }
         }
         else if (meta_split_method_object.splitMethod == GROUP_SPLIT) {
-            int ret_group_split_func = group_split_func(slow5_files_input[i], input_slow5_file_i, user_opts, extension, press_out, meta_split_method_object, flag_single_threaded_execution);
+            int ret_group_split_func = group_split_func(slow5_files_input[i], input_slow5_file_i, user_opts, extension, press_out, meta_split_method_object, flag_single_threaded_execution, &writers);
             if(ret_group_split_func){
-                return -1;
+                ret = -1;
+                break;
             }
         }
         slow5_close(input_slow5_file_i); //todo-implement a method to fseek() to the first record of the slow5File_i
     }
-    return 0;
+    if (split_writers_destroy(&writers) < 0) {
+        ret = -1;
+    }
+    return ret;
+}
+
+typedef struct {
+    int fd_in;
+    std::vector<off_t> src;  // input offset of the records of each output
+    std::vector<off_t> dest; // where they go in the output, after its header
+    std::vector<size_t> len;
+    std::vector<int> fd_out;
+    std::vector<int> ret;
+    std::vector<int> err;    // errno of a failed copy
+} split_slice_param_t;
+
+static void split_slice_copy(core_t *core, db_t *db, int32_t i) {
+    split_slice_param_t *param = (split_slice_param_t *) core->param;
+    if (copy_range(param->fd_in, param->src[i], param->fd_out[i], param->dest[i], param->len[i]) < 0) {
+        param->ret[i] = -1;
+        param->err[i] = errno;
+    }
+}
+
+// with an index, the records of every output are a known contiguous range of the input that is copied as it is
+// after the header of the output, up to num_threads outputs at once
+// returns 1 if the input was split, 0 if it has no usable index and -1 on error
+static int split_slice(std::basic_string<char> &input_slow5_path, slow5_file_t *input_slow5_file_i, opt_t user_opts, std::string extension,
+                       slow5_press_method_t press_out, meta_split_method meta_split_method_object) {
+    if (!idx_is_fresh(input_slow5_path.c_str())) {
+        return 0;
+    }
+    std::vector<idx_rec_t> entries;
+    if (idx_read(idx_get_path(input_slow5_path.c_str()).c_str(), entries, NULL) < 0) {
+        idx_entries_free(entries);
+        return -1;
+    }
+    std::sort(entries.begin(), entries.end(), [](const idx_rec_t &a, const idx_rec_t &b) { return a.offset < b.offset; });
+    for (size_t k = 1; k < entries.size(); k++) {
+        if (entries[k - 1].offset + entries[k - 1].size != entries[k].offset) {
+            VERBOSE("The records in the index of %s are not contiguous. Reading the records instead", input_slow5_path.c_str());
+            idx_entries_free(entries);
+            return 0;
+        }
+    }
+    // an index written in the same second as the input was appended to passes idx_is_fresh, so the entries
+    // must also span exactly the records of the input or the records after the last entry would be lost
+    off_t records_start = ftello(input_slow5_file_i->fp);
+    off_t records_end = idx_records_end(input_slow5_file_i);
+    off_t entries_start = entries.empty() ? records_start : (off_t) entries[0].offset;
+    off_t entries_end = entries.empty() ? records_start : (off_t) (entries.back().offset + entries.back().size);
+    if (records_start < 0 || records_end < 0 || entries_start != records_start || entries_end != records_end) {
+        VERBOSE("The index of %s does not cover all its records. Reading the records instead", input_slow5_path.c_str());
+        idx_entries_free(entries);
+        return 0;
+    }
+
+    // the first record of each output, followed by the end of the last output
+    std::vector<size_t> first;
+    if (!entries.empty() && (meta_split_method_object.splitMethod == BYTES_SPLIT || meta_split_method_object.balance_bytes)) {
+        // the same cuts as when reading the records: a new output starts with the first record at or after the
+        // boundary of the current one
+        off_t bytes_per_file = meta_split_method_object.bytes;
+        size_t max_outputs = SIZE_MAX;
+        if (meta_split_method_object.splitMethod == FILE_SPLIT) {
+            bytes_per_file = (records_end - records_start) / (off_t) meta_split_method_object.n;
+            if (bytes_per_file < 1) {
+                bytes_per_file = 1;
+            }
+            max_outputs = meta_split_method_object.n;
+        }
+        int64_t boundary = 0;
+        first.push_back(0);
+        for (size_t k = 1; k < entries.size() && first.size() < max_outputs; k++) {
+            if ((off_t) entries[k].offset >= records_start + (off_t) (boundary + 1) * bytes_per_file) {
+                first.push_back(k);
+                while (records_start + (off_t) (boundary + 1) * bytes_per_file <= (off_t) entries[k].offset) {
+                    boundary++;
+                }
+            }
+        }
+    } else if (meta_split_method_object.splitMethod == READS_SPLIT) {
+        for (size_t k = 0; k < entries.size(); k += meta_split_method_object.n) {
+            first.push_back(k);
+        }
+    } else {
+        size_t limit = entries.size() / meta_split_method_object.n;
+        size_t rem = entries.size() % meta_split_method_object.n;
+        size_t k = 0;
+        for (size_t f = 0; f < meta_split_method_object.n && k < entries.size(); f++) {
+            first.push_back(k);
+            k += limit + (f < rem ? 1 : 0);
+        }
+    }
+    first.push_back(entries.size());
+    size_t num_outputs = first.size() - 1;
+    VERBOSE("Copying %zu records of %s to %zu files using its index", entries.size(), input_slow5_path.c_str(), num_outputs);
+
+    split_slice_param_t param;
+    param.fd_in = fileno(input_slow5_file_i->fp);
+    size_t batch = user_opts.num_threads > 0 ? user_opts.num_threads : 1;
+    int ret = 1;
+    for (size_t b = 0; b < num_outputs && ret == 1; b += batch) {
+        size_t n = num_outputs - b < batch ? num_outputs - b : batch;
+        std::vector<slow5_file_t *> outputs(n, NULL);
+        std::vector<std::string> paths(n);
+        param.src.assign(n, 0);
+        param.dest.assign(n, 0);
+        param.len.assign(n, 0);
+        param.fd_out.assign(n, -1);
+        param.ret.assign(n, 0);
+        param.err.assign(n, 0);
+        size_t num_created = 0;
+        for (size_t j = 0; j < n; j++) {
+            char *slow5_path_out = NULL;
+            int ret_create_output_slow5 = create_output_slow5(input_slow5_file_i, outputs[j], user_opts, input_slow5_path, &slow5_path_out, press_out, extension, b + j, 0);
+            if (slow5_path_out) {
+                paths[j] = slow5_path_out;
+                free(slow5_path_out);
+            }
+            if (ret_create_output_slow5 || fflush(outputs[j]->fp) == EOF) {
+                ret = -1;
+                break;
+            }
+            num_created++;
+            const idx_rec_t &head = entries[first[b + j]];
+            const idx_rec_t &tail = entries[first[b + j + 1] - 1];
+            param.src[j] = head.offset;
+            param.dest[j] = ftello(outputs[j]->fp);
+            param.len[j] = tail.offset + tail.size - head.offset;
+            param.fd_out[j] = fileno(outputs[j]->fp);
+        }
+        if (ret == 1) {
+            core_t core;
+            core.num_thread = n;
+            core.param = &param;
+            db_t db = { 0 };
+            db.n_batch = n;
+            work_db(&core, &db, split_slice_copy);
+        }
+        for (size_t j = 0; j < num_created; j++) {
+            if (ret == 1 && param.ret[j] < 0) {
+                ERROR("Could not copy the records of %s to %s - %s.", input_slow5_path.c_str(), paths[j].c_str(), strerror(param.err[j]));
+                ret = -1;
+            }
+            if (ret == 1 && fseeko(outputs[j]->fp, param.dest[j] + param.len[j], SEEK_SET) != 0) {
+                ERROR("Could not seek in %s - %s.", paths[j].c_str(), strerror(errno));
+                ret = -1;
+            }
+            if (ret == 1 && user_opts.fmt_out == SLOW5_FORMAT_BINARY) {
+                slow5_eof_fwrite(outputs[j]->fp);
+            }
+            if (slow5_close(outputs[j]) == EOF && ret == 1) {
+                ERROR("Could not write %s - %s.", paths[j].c_str(), strerror(errno));
+                ret = -1;
+            }
+            if (ret == 1 && user_opts.flag_index) {
+                // the entries of the output are those of its records shifted to after its header
+                std::vector<idx_rec_t> idx_entries;
+                for (size_t k = first[b + j]; k < first[b + j + 1]; k++) {
+                    idx_add(idx_entries, entries[k].read_id, entries[k].offset - param.src[j] + param.dest[j], entries[k].size);
+                }
+                if (idx_finish(paths[j].c_str(), idx_entries) < 0) {
+                    ret = -1;
+                }
+            }
+        }
+    }
+    idx_entries_free(entries);
+    return ret;
 }
 
 int read_file_split_func(std::basic_string<char> &input_slow5_path, slow5_file_t * input_slow5_file_i, opt_t user_opts, std::string extension,
                     slow5_press_method_t press_out, meta_split_method meta_split_method_object,
-                    int flag_single_threaded_execution) {
+                    int flag_single_threaded_execution, split_writers_t *writers) {
     int flag_EOF = 0;
+    if (flag_single_threaded_execution) {
+        int ret_split_slice = split_slice(input_slow5_path, input_slow5_file_i, user_opts, extension, press_out, meta_split_method_object);
+        if (ret_split_slice != 0) {
+            return ret_split_slice < 0 ? -1 : 0;
+        }
+    }
     int64_t rem = 0;
     int64_t limit = 0;
-    if(meta_split_method_object.splitMethod==FILE_SPLIT){
-        long current_pos = ftell(input_slow5_file_i->fp);
-        int64_t number_of_records = 0;
-        size_t bytes;
-        char *mem;
-        while ((mem = (char *) slow5_get_next_mem(&bytes, input_slow5_file_i))) {
-            free(mem);
-            number_of_records++;
+    off_t records_start = ftello(input_slow5_file_i->fp);
+    off_t bytes_per_file = -1; // set if the files are split by size
+    if(meta_split_method_object.splitMethod==BYTES_SPLIT){
+        bytes_per_file = meta_split_method_object.bytes;
+    } else if(meta_split_method_object.splitMethod==FILE_SPLIT){
+        // the number of records is taken from the index so that the file is read only once
+        int64_t number_of_records = meta_split_method_object.balance_bytes ? -1 : idx_num_records(input_slow5_file_i);
+        if (number_of_records >= 0) {
+            VERBOSE("%" PRId64 " records in %s according to its index", number_of_records, input_slow5_path.c_str());
+        } else if (meta_split_method_object.balance_records) {
+            // without an index, the records are counted from their boundaries before they are split
+            number_of_records = idx_count_records(input_slow5_file_i);
+            if (number_of_records < 0) {
+                ERROR("Could not count the records in %s. Use --balance bytes or index the file first.", input_slow5_path.c_str());
+                return -1;
+            }
+            VERBOSE("%" PRId64 " records counted in %s", number_of_records, input_slow5_path.c_str());
+        }
+        if (number_of_records >= 0) {
+            limit = number_of_records/meta_split_method_object.n;
+            rem = number_of_records%meta_split_method_object.n;
+        } else {
+            // with --balance bytes or, by default, without an index, each file gets the records of an equal share of the bytes
+            struct stat st;
+            if (fstat(fileno(input_slow5_file_i->fp), &st) != 0) {
+                ERROR("Could not stat %s - %s.", input_slow5_path.c_str(), strerror(errno));
+                return -1;
+            }
+            const char eof[] = SLOW5_BINARY_EOF;
+            off_t records_end = st.st_size - (input_slow5_file_i->format == SLOW5_FORMAT_BINARY ? sizeof eof : 0);
+            bytes_per_file = (records_end - records_start) / (off_t) meta_split_method_object.n;
+            if (bytes_per_file < 1) {
+                bytes_per_file = 1;
+            }
+            VERBOSE("Splitting %s by size into files of about %" PRId64 " bytes", input_slow5_path.c_str(), (int64_t) bytes_per_file);
         }
-        fseek(input_slow5_file_i->fp, current_pos, SEEK_SET);
-
-        limit = number_of_records/meta_split_method_object.n;
-        rem = number_of_records%meta_split_method_object.n;
     };
     int64_t number_of_records_per_file = meta_split_method_object.n;
+    off_t input_limit = -1;
+    int64_t boundary = 0;
     size_t file_count = 0;
     while (1) {
-        if(meta_split_method_object.splitMethod==FILE_SPLIT){
+        if(bytes_per_file > 0){
+            number_of_records_per_file = INT64_MAX;
+            // a file ends with the record that crosses its boundary; the boundaries a large record spans are skipped
+            // so that no file is left empty
+            off_t position = ftello(input_slow5_file_i->fp);
+            while (records_start + (off_t) (boundary + 1) * bytes_per_file <= position) {
+                boundary++;
+            }
+            input_limit = records_start + (off_t) (boundary + 1) * bytes_per_file;
+            if (meta_split_method_object.splitMethod==FILE_SPLIT && file_count + 1 >= meta_split_method_object.n) {
+                input_limit = -1; // the last file takes whatever is left
+            }
+        } else if(meta_split_method_object.splitMethod==FILE_SPLIT){
             number_of_records_per_file = (rem > 0) ? 1 : 0;
             number_of_records_per_file += limit;
             rem--;
+            if (file_count + 1 >= meta_split_method_object.n) { // in case the index is short of records
+                number_of_records_per_file = INT64_MAX;
+            }
         }
-        uint32_t read_group_count_i = input_slow5_file_i->header->num_read_groups;
-        std::vector<slow5_file_t*> output_slow5_files(read_group_count_i);
+        // the previous files are still being written while this one is filled
+        split_writers_wait_open(writers);
+        slow5_file_t *slow5_file_out = NULL;
         char* slow5_path_out = NULL;
-        int ret_create_output_slow5 = create_output_slow5(input_slow5_file_i, output_slow5_files[0], user_opts, input_slow5_path, &slow5_path_out, press_out, extension, file_count, 0);
+        int ret_create_output_slow5 = create_output_slow5(input_slow5_file_i, slow5_file_out, user_opts, input_slow5_path, &slow5_path_out, press_out, extension, file_count, 0);
         if(ret_create_output_slow5){
+            free(slow5_path_out);
             return -1;
         }
+        std::vector<split_output_t*> outputs(1, split_writers_open(writers, slow5_file_out, slow5_path_out));
+        free(slow5_path_out);
         int64_t record_count = 0;
         if(flag_single_threaded_execution){
             int ret_single_threaded_split_execution = single_threaded_split_execution(input_slow5_path,
                                                                                                 user_opts, extension,
                                                                                                 press_out,
-                                                                                                number_of_records_per_file,
-                                                                                                &record_count, &flag_EOF, input_slow5_file_i, output_slow5_files[0]);
+                                                                                                number_of_records_per_file, input_limit,
+                                                                                                &record_count, &flag_EOF, input_slow5_file_i, outputs[0],
+                                                                                                writers);
             if(ret_single_threaded_split_execution){
+                split_writers_close(writers, outputs[0], 0);
                 return -1;
             }
         }else{
             int ret_multi_threaded_split_execution = multi_threaded_split_execution(input_slow5_path,
                                                                                               user_opts, extension,
                                                                                               press_out,
-                                                                                              number_of_records_per_file,
-                                                                                              &record_count, &flag_EOF, input_slow5_file_i, output_slow5_files);
+                                                                                              number_of_records_per_file, input_limit,
+                                                                                              &record_count, &flag_EOF, input_slow5_file_i, outputs,
+                                                                                              writers, NULL);
             if(ret_multi_threaded_split_execution){
+                split_writers_close(writers, outputs[0], 0);
                 return -1;
             }
         }
-        if (user_opts.fmt_out == SLOW5_FORMAT_BINARY) {
-            slow5_eof_fwrite(output_slow5_files[0]->fp);
-        }
-        slow5_close(output_slow5_files[0]);
+        // an additional file opened when the input had no records left is removed
+        split_writers_close(writers, outputs[0], flag_EOF);
         if (flag_EOF) {
-            if (record_count == 0) {
-                int del = remove(slow5_path_out);
-                if (del) {
-                    WARNING("Deleting additional file %s failed\n", slow5_path_out);
-                    perror("");
-                }
-            }
-            if(slow5_path_out){
-                free(slow5_path_out);
-            }
             break;
         }
-        if(slow5_path_out){
-            free(slow5_path_out);
-        }
         file_count++;
     }
     return 0;
 }
 
+// read_limit records are written, or fewer if the input reaches input_limit (-1 for no limit) or its end
 int multi_threaded_split_execution(std::basic_string<char> &input_slow5_path, opt_t user_opts, std::string extension,
-                                    slow5_press_method_t press_out, int64_t read_limit,
-                                    int64_t *record_count_ptr, int* flag_EOF_ptr, slow5_file_t * input_slow5_file_i, std::vector<slow5_file_t*> output_slow5_files) {
+                                    slow5_press_method_t press_out, int64_t read_limit, off_t input_limit,
+                                    int64_t *record_count_ptr, int* flag_EOF_ptr, slow5_file_t * input_slow5_file_i, std::vector<split_output_t*> &outputs,
+                                    split_writers_t *writers, split_keyed_t *keyed) {
 
     int64_t record_count = *record_count_ptr;
     int flag_EOF = *flag_EOF_ptr;
-    while(record_count<read_limit){
+    int flag_input_limit = 0;
+    while(record_count<read_limit && !flag_input_limit){
         int64_t batch_size = (user_opts.read_id_batch_capacity<read_limit)?user_opts.read_id_batch_capacity:read_limit;
         db_t db = {0};
         db.mem_records = (char **) malloc(batch_size * sizeof(char *));
@@ -423,7 +1078,11 @@ int multi_threaded_split_execution(std::basic_string<char> &input_slow5_path, op
         int64_t record_count_local = 0;
         size_t bytes;
         char *mem;
-        while (record_count_local < batch_size) {
+        while (record_count_local < batch_size && record_count < read_limit) {
+            if (input_limit >= 0 && ftello(input_slow5_file_i->fp) >= input_limit) {
+                flag_input_limit = 1;
+                break;
+            }
             if (!(mem = (char *) slow5_get_next_mem(&bytes, input_slow5_file_i))) {
                 if (slow5_errno != SLOW5_ERR_EOF) {
                     ERROR("Could not read file %s", input_slow5_path.c_str());
@@ -444,7 +1103,8 @@ int multi_threaded_split_execution(std::basic_string<char> &input_slow5_path, op
         core_t core;
         core.num_thread = user_opts.num_threads;
         core.fp = input_slow5_file_i;
-        core.aux_meta = output_slow5_files[0]->header->aux_meta;
+        core.aux_meta = input_slow5_file_i->header->aux_meta; // the outputs have the same auxiliary fields
+        core.param = keyed ? (void *) keyed->method : NULL;
         core.format_out = user_opts.fmt_out;
         core.press_method = press_out;
         core.lossy = user_opts.flag_lossy;
@@ -454,17 +1114,59 @@ int multi_threaded_split_execution(std::basic_string<char> &input_slow5_path, op
         db.n_batch = record_count_local;
         db.read_record = (raw_record_t *) malloc(record_count_local * sizeof *db.read_record);
         MALLOC_CHK(db.read_record);
+        if (user_opts.flag_index) {
+            db.read_id = (char **) malloc(record_count_local * sizeof *db.read_id);
+            MALLOC_CHK(db.read_id);
+        }
         work_db(&core, &db, split_thread_func);
 
+        // the writers take over the records and their read ids
+        // read_group_vector holds the output of each record: its read group, or its key for --by
         for (int64_t i = 0; i < record_count_local; i++) {
-            fwrite(db.read_record[i].buffer, 1, db.read_record[i].len, output_slow5_files[db.read_group_vector[i]]->fp);
-            free(db.read_record[i].buffer);
+            split_output_t *output;
+            if (keyed) {
+                std::map<uint32_t, split_output_t*>::iterator it = keyed->outputs.find(db.read_group_vector[i]);
+                if (it == keyed->outputs.end()) {
+                    slow5_file_t *slow5_file_out = NULL;
+                    char *slow5_path_out = NULL;
+                    int ret_create_output_slow5 = -1;
+                    if (keyed->outputs.size() >= keyed->max_outputs) {
+                        ERROR("%s has more keys than the %zu output files that can be open at once. Raise the limit of open files (ulimit -n) or use --by hash:N with fewer files.",
+                              input_slow5_path.c_str(), keyed->max_outputs);
+                    } else {
+                        ret_create_output_slow5 = create_output_slow5(input_slow5_file_i, slow5_file_out, user_opts, input_slow5_path, &slow5_path_out, press_out, extension, db.read_group_vector[i], 0);
+                    }
+                    if (ret_create_output_slow5) {
+                        free(slow5_path_out);
+                        for (int64_t j = i; j < record_count_local; j++) {
+                            free(db.read_record[j].buffer);
+                            if (db.read_id) {
+                                free(db.read_id[j]);
+                            }
+                        }
+                        free(db.mem_bytes);
+                        free(db.mem_records);
+                        free(db.read_record);
+                        free(db.read_group_vector);
+                        free(db.read_id);
+                        return -1;
+                    }
+                    it = keyed->outputs.insert(std::make_pair(db.read_group_vector[i], split_writers_open(writers, slow5_file_out, slow5_path_out))).first;
+                    free(slow5_path_out);
+                }
+                output = it->second;
+            } else {
+                output = outputs[db.read_group_vector[i]];
+            }
+            split_writers_write(writers, output, (char *) db.read_record[i].buffer, db.read_record[i].len,
+                                db.read_id ? db.read_id[i] : NULL, SPLIT_FRAME_NONE);
         }
         // Free everything
         free(db.mem_bytes);
         free(db.mem_records);
         free(db.read_record);
         free(db.read_group_vector);
+        free(db.read_id);
 
         if(flag_EOF){
             break;
@@ -477,14 +1179,18 @@ int multi_threaded_split_execution(std::basic_string<char> &input_slow5_path, op
 }
 
 int single_threaded_split_execution(std::basic_string<char> &input_slow5_path, opt_t user_opts, std::string extension,
-                                     slow5_press_method_t press_out, int64_t read_limit,
-                                     int64_t *record_count_ptr, int* flag_EOF_ptr, slow5_file_t * input_slow5_file_i, slow5_file_t * slow5_file_out) {
+                                     slow5_press_method_t press_out, int64_t read_limit, off_t input_limit,
+                                     int64_t *record_count_ptr, int* flag_EOF_ptr, slow5_file_t * input_slow5_file_i, split_output_t *output,
+                                     split_writers_t *writers) {
     int64_t record_count = *record_count_ptr;
     int flag_EOF = *flag_EOF_ptr;
     size_t bytes;
-    slow5_rec_size_t record_size;
     char *buffer;
+    int framing = user_opts.fmt_out == SLOW5_FORMAT_BINARY ? SPLIT_FRAME_BINARY : SPLIT_FRAME_ASCII;
     while (record_count < read_limit) {
+        if (input_limit >= 0 && ftello(input_slow5_file_i->fp) >= input_limit) {
+            break;
+        }
         if (!(buffer = (char *) slow5_get_next_mem(&bytes, input_slow5_file_i))) {
             if (slow5_errno != SLOW5_ERR_EOF) {
                 ERROR("Could not read file %s", input_slow5_path.c_str());
@@ -494,15 +1200,16 @@ int single_threaded_split_execution(std::basic_string<char> &input_slow5_path, o
                 break;
             }
         }
-        if(user_opts.fmt_out == SLOW5_FORMAT_BINARY){
-            record_size = bytes;
-            fwrite(&record_size, 1, sizeof record_size, slow5_file_out->fp);
-        }
-        fwrite(buffer,1,bytes,slow5_file_out->fp);
-        if(user_opts.fmt_out == SLOW5_FORMAT_ASCII){
-            fwrite("\n",1,1,slow5_file_out->fp);
+        char *read_id = NULL;
+        if (user_opts.flag_index) {
+            read_id = idx_mem_read_id(input_slow5_file_i, buffer, bytes);
+            if (!read_id) {
+                ERROR("Could not decode the read id of a record in %s", input_slow5_path.c_str());
+                free(buffer);
+                return -1;
+            }
         }
-        free(buffer);
+        split_writers_write(writers, output, buffer, bytes, read_id, framing);
         record_count++;
     }
     *flag_EOF_ptr = flag_EOF;
@@ -512,31 +1219,67 @@ int single_threaded_split_execution(std::basic_string<char> &input_slow5_path, o
 
 int group_split_func(std::basic_string<char> &input_slow5_path, slow5_file_t * input_slow5_file_i, opt_t user_opts, std::string extension,
                      slow5_press_method_t press_out, meta_split_method meta_split_method_object,
-                     int flag_single_threaded_execution){
+                     int flag_single_threaded_execution, split_writers_t *writers){
     uint32_t read_group_count_i = input_slow5_file_i->header->num_read_groups;
-    std::vector<slow5_file_t*> output_slow5_files(read_group_count_i);
+    // every read group file stays open until the input is read, spread over the writers
+    std::vector<split_output_t*> outputs;
+    int ret = 0;
     for(uint32_t j=0; j<read_group_count_i; j++){
-        char* slow5_path_out;
-        int ret_create_output_slow5 = create_output_slow5(input_slow5_file_i, output_slow5_files[j], user_opts, input_slow5_path, &slow5_path_out, press_out, extension, j, j);
-        free(slow5_path_out);
+        slow5_file_t *slow5_file_out = NULL;
+        char* slow5_path_out = NULL;
+        int ret_create_output_slow5 = create_output_slow5(input_slow5_file_i, slow5_file_out, user_opts, input_slow5_path, &slow5_path_out, press_out, extension, j, j);
         if(ret_create_output_slow5){
-            return -1;
+            free(slow5_path_out);
+            ret = -1;
+            break;
         }
+        outputs.push_back(split_writers_open(writers, slow5_file_out, slow5_path_out));
+        free(slow5_path_out);
     }
-    int flag_EOF = 0;
-    int64_t record_count = 0;
-    int64_t number_of_records_per_file = INT64_MAX;
-    int ret_multi_threaded_split_execution = multi_threaded_split_execution(input_slow5_path, user_opts, extension, press_out, number_of_records_per_file, &record_count, &flag_EOF, input_slow5_file_i, output_slow5_files);
-    if(ret_multi_threaded_split_execution){
+    if (ret == 0) {
+        int flag_EOF = 0;
+        int64_t record_count = 0;
+        int64_t number_of_records_per_file = INT64_MAX;
+        int ret_multi_threaded_split_execution = multi_threaded_split_execution(input_slow5_path, user_opts, extension, press_out, number_of_records_per_file, -1, &record_count, &flag_EOF, input_slow5_file_i, outputs,
+                                                                                writers, NULL);
+        if(ret_multi_threaded_split_execution){
+            ret = -1;
+        }
+    }
+    for(size_t j=0; j<outputs.size(); j++){
+        split_writers_close(writers, outputs[j], 0);
+    }
+    return ret;
+}
+
+// the records are decoded to compute their keys, so they always go through split_thread_func
+// an output file is created for each key met and all of them stay open until the input is read
+int key_split_func(std::basic_string<char> &input_slow5_path, slow5_file_t * input_slow5_file_i, opt_t user_opts, std::string extension,
+                   slow5_press_method_t press_out, meta_split_method meta_split_method_object, split_writers_t *writers){
+    const char *attr = NULL;
+    if (meta_split_method_object.by == SPLIT_BY_CHANNEL) {
+        attr = "channel_number";
+    } else if (meta_split_method_object.by == SPLIT_BY_START_TIME) {
+        attr = "start_time";
+    }
+    uint32_t index;
+    if (attr && (input_slow5_file_i->header->aux_meta == NULL || check_aux_fields_in_header(input_slow5_file_i->header, attr, 0, &index) < 0)) {
+        ERROR("%s has no auxiliary field '%s' to split by.", input_slow5_path.c_str(), attr);
         return -1;
     }
-    for(uint32_t j=0; j<read_group_count_i; j++){
-        if (user_opts.fmt_out == SLOW5_FORMAT_BINARY) {
-            slow5_eof_fwrite(output_slow5_files[j]->fp);
-        }
-        slow5_close(output_slow5_files[j]);
+    split_keyed_t keyed;
+    keyed.method = &meta_split_method_object;
+    keyed.max_outputs = split_fd_budget();
+    std::vector<split_output_t*> outputs;
+    int flag_EOF = 0;
+    int64_t record_count = 0;
+    int ret = multi_threaded_split_execution(input_slow5_path, user_opts, extension, press_out, INT64_MAX, -1, &record_count, &flag_EOF, input_slow5_file_i, outputs,
+                                             writers, &keyed);
+    for (std::map<uint32_t, split_output_t*>::iterator it = keyed.outputs.begin(); it != keyed.outputs.end(); ++it) {
+        split_writers_close(writers, it->second, 0);
     }
-    return 0;
+    VERBOSE("%" PRId64 " records of %s split into %zu files", record_count, input_slow5_path.c_str(), keyed.outputs.size());
+    return ret ? -1 : 0;
 }
 
 int create_output_slow5(slow5_file_t *input_slow5_file_i, slow5_file_t *&slow5_file_out, opt_t user_opts,
@@ -13,6 +13,7 @@
 #include "slow5_extra.h"
 #include "read_fast5.h"
 #include "misc.h"
+#include "idx_utils.h"
 #include <slow5/slow5_press.h>
 
 
@@ -150,21 +151,20 @@ int stats_main(int argc, char **argv, struct program_meta *meta){
         fprintf(stdout, "auxiliary fields\n");
     }
 
-    VERBOSE("counting number of slow5 records...%s","");
-
-    int64_t record_count = 0;
-    size_t bytes;
-    char *mem;
-    double time_get_to_mem = slow5_realtime();
-    while ((mem = (char *) slow5_get_next_mem(&bytes, slow5File))) {
-        free(mem);
-        record_count++;
-    }
-    if (slow5_errno != SLOW5_ERR_EOF) {
-        ERROR("Error reading the file.%s","");
-        return EXIT_FAILURE;
+    // the number of records is taken from the index if there is one, otherwise the record boundaries are scanned
+    int64_t record_count = idx_num_records(slow5File);
+    if (record_count >= 0) {
+        VERBOSE("number of slow5 records taken from the index%s","");
+    } else {
+        VERBOSE("counting number of slow5 records...%s","");
+        double time_count = slow5_realtime();
+        record_count = idx_count_records(slow5File);
+        if (record_count < 0) {
+            ERROR("Error reading the file.%s","");
+            return EXIT_FAILURE;
+        }
+        DEBUG("time_count\t%.3fs", slow5_realtime()-time_count);
     }
-    DEBUG("time_get_to_mem\t%.3fs", slow5_realtime()-time_get_to_mem);
 
     slow5_close(slow5File);
 
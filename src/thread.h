@@ -63,6 +63,8 @@ typedef struct {
     std::vector<int> slow5_file_indices;
     std::string output_dir;
     slow5_file_t **slow5_file_pointers;
+    uint64_t *start_times;
+    uint8_t *dups;
     //for split
     uint32_t* read_group_vector;
 } db_t;
@@ -11,6 +11,7 @@
 #include "thread.h"
 #include <slow5/slow5.h>
 #include "slow5_extra.h"
+#include "idx_utils.h"
 #include <getopt.h>
 
 #define USAGE_MSG "Usage: %s [OPTIONS] [FILE]\n"
@@ -25,12 +26,13 @@
     HELP_MSG_THREADS \
     HELP_MSG_BATCH \
     "        --from FORMAT             specify input file format [auto]\n" \
+    HELP_MSG_INDEX \
     HELP_MSG_HELP \
     HELP_FORMATS_METHODS
 
 extern int slow5tools_verbosity_level;
 
-int slow5_convert_parallel(struct slow5_file *from, FILE *to_fp, enum slow5_fmt to_format, slow5_press_method_t to_compress, size_t num_threads, int64_t batch_size, struct program_meta *meta);
+int slow5_convert_parallel(struct slow5_file *from, FILE *to_fp, enum slow5_fmt to_format, slow5_press_method_t to_compress, size_t num_threads, int64_t batch_size, struct program_meta *meta, std::vector<idx_rec_t> *idx_entries);
 
 void depress_parse_rec_to_mem(core_t *core, db_t *db, int32_t i) {
     //
@@ -53,6 +55,10 @@ void depress_parse_rec_to_mem(core_t *core, db_t *db, int32_t i) {
     }
     slow5_press_free(press_ptr);
     db->read_record[i].len = len;
+    if (db->read_id) { // --index
+        db->read_id[i] = strdup(read->read_id);
+        MALLOC_CHK(db->read_id[i]);
+    }
     slow5_rec_free(read);
 }
 
@@ -78,6 +84,7 @@ int view_main(int argc, char **argv, struct program_meta *meta) {
         {"to",              required_argument,  NULL, 'b'},
         {"threads",         required_argument,  NULL, 't' },
         {"batchsize",       required_argument, NULL, 'K'},
+        {"index",           no_argument,        NULL, 0},   //8
         {NULL, 0, NULL, 0}
     };
 
@@ -119,6 +126,13 @@ int view_main(int argc, char **argv, struct program_meta *meta) {
             case 't':
                 user_opts.arg_num_threads = optarg;
                 break;
+            case 0  :
+                switch (longindex) {
+                    case 8:
+                        user_opts.flag_index = 1;
+                        break;
+                }
+                break;
             default: // case '?'
                 fprintf(stderr, HELP_SMALL_MSG, argv[0]);
                 EXIT_MSG(EXIT_FAILURE, argv, meta);
@@ -165,6 +179,12 @@ int view_main(int argc, char **argv, struct program_meta *meta) {
         return EXIT_FAILURE;
     }
 
+    if (user_opts.flag_index && user_opts.arg_fname_out == NULL) {
+        ERROR("--index requires an output file (-o)%s", "");
+        EXIT_MSG(EXIT_FAILURE, argv, meta);
+        return EXIT_FAILURE;
+    }
+
     // Parse output argument
     if (user_opts.arg_fname_out != NULL) {
         DEBUG("opening output file%s","");
@@ -185,6 +205,8 @@ int view_main(int argc, char **argv, struct program_meta *meta) {
         }
     }
 
+    std::vector<idx_rec_t> idx_entries;
+
     // Do the conversion
     if ((user_opts.fmt_in == SLOW5_FORMAT_ASCII || user_opts.fmt_in == SLOW5_FORMAT_BINARY) &&
             (user_opts.fmt_out == SLOW5_FORMAT_ASCII || user_opts.fmt_out == SLOW5_FORMAT_BINARY)) {
@@ -199,7 +221,7 @@ int view_main(int argc, char **argv, struct program_meta *meta) {
 
         // TODO if output is the same format just duplicate file
         slow5_press_method_t press_out = {user_opts.record_press_out,user_opts.signal_press_out};
-        if (slow5_convert_parallel(s5p, user_opts.f_out, (enum slow5_fmt) user_opts.fmt_out, press_out, user_opts.num_threads, user_opts.read_id_batch_capacity, meta) != 0) {
+        if (slow5_convert_parallel(s5p, user_opts.f_out, (enum slow5_fmt) user_opts.fmt_out, press_out, user_opts.num_threads, user_opts.read_id_batch_capacity, meta, user_opts.flag_index ? &idx_entries : NULL) != 0) {
             ERROR("File conversion failed.%s", "");
             view_ret = EXIT_FAILURE;
         }
@@ -232,13 +254,21 @@ int view_main(int argc, char **argv, struct program_meta *meta) {
         }
     }
 
+    if (user_opts.flag_index && view_ret == EXIT_SUCCESS) {
+        if (idx_finish(user_opts.arg_fname_out, idx_entries) < 0) {
+            view_ret = EXIT_FAILURE;
+        }
+    } else {
+        idx_entries_free(idx_entries);
+    }
+
     if (view_ret == EXIT_FAILURE) {
         EXIT_MSG(EXIT_FAILURE, argv, meta);
     }
     return view_ret;
 }
 
-int slow5_convert_parallel(struct slow5_file *from, FILE *to_fp, enum slow5_fmt to_format, slow5_press_method_t to_compress, size_t num_threads, int64_t batch_size, struct program_meta *meta) {
+int slow5_convert_parallel(struct slow5_file *from, FILE *to_fp, enum slow5_fmt to_format, slow5_press_method_t to_compress, size_t num_threads, int64_t batch_size, struct program_meta *meta, std::vector<idx_rec_t> *idx_entries) {
     if (from == NULL || to_fp == NULL || to_format == SLOW5_FORMAT_UNKNOWN) {
         return -1;
     }
@@ -289,11 +319,19 @@ int slow5_convert_parallel(struct slow5_file *from, FILE *to_fp, enum slow5_fmt
         db.n_batch = record_count;
         db.read_record = (raw_record_t*) malloc(record_count * sizeof *db.read_record);
         MALLOC_CHK(db.read_record);
+        if (idx_entries) {
+            db.read_id = (char **) malloc(record_count * sizeof *db.read_id);
+            MALLOC_CHK(db.read_id);
+        }
         work_db(&core,&db,depress_parse_rec_to_mem);
         time_thread_execution += slow5_realtime() - realtime;
 
         realtime = slow5_realtime();
         for (int64_t i = 0; i < record_count; i++) {
+            if (idx_entries) {
+                idx_add(*idx_entries, db.read_id[i], ftello(to_fp), db.read_record[i].len);
+                free(db.read_id[i]);
+            }
             fwrite(db.read_record[i].buffer,1,db.read_record[i].len,to_fp);
             free(db.read_record[i].buffer);
         }
@@ -303,6 +341,7 @@ int slow5_convert_parallel(struct slow5_file *from, FILE *to_fp, enum slow5_fmt
         free(db.mem_bytes);
         free(db.mem_records);
         free(db.read_record);
+        free(db.read_id);
 
         if(flag_end_of_file == 1){
             break;
@@ -113,6 +113,37 @@ TESTCASE=10
 info "testcase:$TESTCASE - cat different auxiliary attribute order. $SLOW5TOOLS_ERROR"
 $SLOW5TOOLS cat "$RAW_DIR/different_aux_order/" > "$OUTPUT_DIR/output.slow5" && die "testcase:$TESTCASE slow5tools cat failed"
 
+TESTCASE=11
+info "testcase:$TESTCASE - cat two blow5s with --index. the output index must match slow5tools index"
+mkdir "$OUTPUT_DIR/indexed" || die "testcase:$TESTCASE mkdir failed"
+cp "$RAW_DIR"/blow5s/*.blow5 "$OUTPUT_DIR/indexed/" || die "testcase:$TESTCASE cp failed"
+for file in "$OUTPUT_DIR"/indexed/*.blow5; do
+    $SLOW5TOOLS index "$file" || die "testcase:$TESTCASE slow5tools index failed"
+done
+$SLOW5TOOLS cat --index "$OUTPUT_DIR/indexed/" -o "$OUTPUT_DIR/output_indexed.blow5" || die "testcase:$TESTCASE slow5tools cat failed"
+mv "$OUTPUT_DIR/output_indexed.blow5.idx" "$OUTPUT_DIR/output_indexed.blow5.idx.cat" || die "testcase:$TESTCASE mv failed"
+$SLOW5TOOLS index "$OUTPUT_DIR/output_indexed.blow5" || die "testcase:$TESTCASE slow5tools index failed"
+cmp "$OUTPUT_DIR/output_indexed.blow5.idx" "$OUTPUT_DIR/output_indexed.blow5.idx.cat" || die "testcase:$TESTCASE index diff failed"
+# inputs without an index are indexed on the fly
+$SLOW5TOOLS cat --index "$RAW_DIR/slow5s/" -o "$OUTPUT_DIR/output_indexed.slow5" || die "testcase:$TESTCASE slow5tools cat failed"
+mv "$OUTPUT_DIR/output_indexed.slow5.idx" "$OUTPUT_DIR/output_indexed.slow5.idx.cat" || die "testcase:$TESTCASE mv failed"
+$SLOW5TOOLS index "$OUTPUT_DIR/output_indexed.slow5" || die "testcase:$TESTCASE slow5tools index failed"
+cmp "$OUTPUT_DIR/output_indexed.slow5.idx" "$OUTPUT_DIR/output_indexed.slow5.idx.cat" || die "testcase:$TESTCASE index diff failed"
+
+TESTCASE=12
+info "testcase:$TESTCASE - cat two blow5s. output-pipe must match output-file"
+$SLOW5TOOLS cat "$RAW_DIR/blow5s/" -o "$OUTPUT_DIR/output_file.blow5" || die "testcase:$TESTCASE slow5tools cat failed"
+$SLOW5TOOLS cat "$RAW_DIR/blow5s/" | cat > "$OUTPUT_DIR/output_pipe.blow5" || die "testcase:$TESTCASE slow5tools cat failed"
+cmp "$OUTPUT_DIR/output_file.blow5" "$OUTPUT_DIR/output_pipe.blow5" || die "testcase:$TESTCASE cmp failed"
+
+TESTCASE=13
+info "testcase:$TESTCASE - cat two blow5s in parallel. output must not depend on the number of threads"
+$SLOW5TOOLS cat -t 1 "$RAW_DIR/blow5s/" -o "$OUTPUT_DIR/output_single.blow5" || die "testcase:$TESTCASE slow5tools cat failed"
+cmp "$OUTPUT_DIR/output_file.blow5" "$OUTPUT_DIR/output_single.blow5" || die "testcase:$TESTCASE cmp failed"
+: > "$OUTPUT_DIR/output_append.blow5"
+$SLOW5TOOLS cat "$RAW_DIR/blow5s/" >> "$OUTPUT_DIR/output_append.blow5" || die "testcase:$TESTCASE slow5tools cat failed"
+cmp "$OUTPUT_DIR/output_file.blow5" "$OUTPUT_DIR/output_append.blow5" || die "testcase:$TESTCASE cmp failed"
+
 info "all $TESTCASE cat testcases passed"
 rm -r "$OUTPUT_DIR" || die "could not delete $OUTPUT_DIR"
 exit 0
@@ -650,6 +650,29 @@ echo -e "${GREEN}testcase $TESTCASE_NO passed${NC}" 1>&3 2>&4
 
 TESTCASE_NO=8.15 TEST_FAST5_VERSION single_fast5_v1.0_starttime0
 
+TESTCASE_NO=9.1
+echo "------------------- f2s testcase $TESTCASE_NO: --index writes the same indexes as slow5tools index -------------------"
+# $1: file written with --index
+check_index() {
+    mv $1.idx $1.idx.inline || die "testcase $TESTCASE_NO: moving the index of $1 failed"
+    $SLOW5_EXEC index $1 || die "testcase $TESTCASE_NO: slow5tools index failed"
+    cmp $1.idx $1.idx.inline || die "testcase $TESTCASE_NO: index of $1 differs"
+}
+mkdir $OUTPUT_DIR/indexed || die "testcase $TESTCASE_NO: creating $OUTPUT_DIR/indexed failed"
+$SLOW5_EXEC f2s $FAST5_DIR/multi-fast5/ssm1.fast5 --index -o $OUTPUT_DIR/indexed/ssm1.slow5 || die "testcase $TESTCASE_NO failed"
+check_index $OUTPUT_DIR/indexed/ssm1.slow5
+$SLOW5_EXEC f2s $FAST5_DIR/multi-fast5/ssm1.fast5 --index -o $OUTPUT_DIR/indexed/ssm1.blow5 || die "testcase $TESTCASE_NO failed"
+check_index $OUTPUT_DIR/indexed/ssm1.blow5
+$SLOW5_EXEC f2s $FAST5_DIR/multi-fast5 --index --iop 2 -d $OUTPUT_DIR/indexed/multi-fast5 || die "testcase $TESTCASE_NO failed"
+for file in $OUTPUT_DIR/indexed/multi-fast5/*.blow5; do
+    check_index $file
+done
+$SLOW5_EXEC f2s $FAST5_DIR/single-fast5 --index --iop 2 -d $OUTPUT_DIR/indexed/single-fast5 || die "testcase $TESTCASE_NO failed"
+for file in $OUTPUT_DIR/indexed/single-fast5/*.blow5; do
+    check_index $file
+done
+echo -e "${GREEN}testcase $TESTCASE_NO passed${NC}" 1>&3 2>&4
+
 rm -r $OUTPUT_DIR || die "Removing $OUTPUT_DIR failed"
 
 exit 0
@@ -131,5 +131,124 @@ $SLOW5_EXEC get "$RAW_DIR/example2.slow5" --skip --list "$RAW_DIR/list_with_inva
 slow5tools_quickcheck $OUTPUT_DIR
 info "testcase $TESTCASE passed"
 
+TESTCASE=9
+info "------------------- slow5tools get testcase $TESTCASE -------------------"
+$SLOW5_EXEC index --catalog "$OUTPUT_DIR/reads.s5c" "$RAW_DIR/example2.slow5" || die "testcase $TESTCASE failed"
+$SLOW5_EXEC get --catalog "$OUTPUT_DIR/reads.s5c" -t 2 r1 r5 r3 --to slow5 > "$OUTPUT_DIR/extracted_reads9.slow5" || die "testcase $TESTCASE failed"
+slow5tools_quickcheck $OUTPUT_DIR
+diff -q <(grep -v '^[@#]' "$EXP_DIR/expected_extracted_reads2.slow5") <(grep -v '^[@#]' "$OUTPUT_DIR/extracted_reads9.slow5") &>/dev/null
+if [ $? -ne 0 ]; then
+    info "${RED}ERROR: diff failed for 'slow5tools get testcase $TESTCASE'${NC}"
+    exit 1
+fi
+info "testcase $TESTCASE passed"
+
+TESTCASE=10
+info "------------------- slow5tools get testcase $TESTCASE -------------------"
+$SLOW5_EXEC get --catalog "$OUTPUT_DIR/reads.s5c" --list "$RAW_DIR/list_with_invalid_reads.txt" --to slow5 > "$OUTPUT_DIR/extracted_reads10.slow5" && die "testcase $TESTCASE failed"
+$SLOW5_EXEC get --catalog "$OUTPUT_DIR/reads.s5c" --max-open 1 --skip --list "$RAW_DIR/list_with_invalid_reads.txt" --to slow5 > "$OUTPUT_DIR/extracted_reads10.slow5" || die "testcase $TESTCASE failed"
+slow5tools_quickcheck $OUTPUT_DIR
+info "testcase $TESTCASE passed"
+
+TESTCASE=11
+info "------------------- slow5tools get testcase $TESTCASE -------------------"
+SOCKET="$OUTPUT_DIR/serve.sock"
+$SLOW5_EXEC_WITHOUT_VALGRIND serve --socket "$SOCKET" "$RAW_DIR/example2.slow5" --to slow5 -t 2 &
+SERVE_PID=$!
+for i in $(seq 1 50); do test -S "$SOCKET" && break; sleep 0.1; done
+$SLOW5_EXEC serve --connect "$SOCKET" r1 r5 r3 > "$OUTPUT_DIR/extracted_reads11.slow5"
+RET=$?
+kill $SERVE_PID
+wait $SERVE_PID
+[ $RET -eq 0 ] || die "testcase $TESTCASE failed"
+diff -q "$EXP_DIR/expected_extracted_reads2.slow5" "$OUTPUT_DIR/extracted_reads11.slow5" &>/dev/null
+if [ $? -ne 0 ]; then
+    info "${RED}ERROR: diff failed for 'slow5tools get testcase $TESTCASE'${NC}"
+    exit 1
+fi
+$SLOW5_EXEC_WITHOUT_VALGRIND serve --socket "$SOCKET" "$RAW_DIR/example2.slow5" --to slow5 -t 1 &
+SERVE_PID=$!
+for i in $(seq 1 50); do test -S "$SOCKET" && break; sleep 0.1; done
+# an idle client stays connected while another client is served by the only worker
+sleep 30 | $SLOW5_EXEC_WITHOUT_VALGRIND serve --connect "$SOCKET" > /dev/null &
+IDLE_PID=$!
+sleep 0.5
+timeout 10 $SLOW5_EXEC_WITHOUT_VALGRIND serve --connect "$SOCKET" r1 r5 r3 > "$OUTPUT_DIR/extracted_reads11_idle.slow5"
+RET=$?
+kill -TERM $SERVE_PID
+for i in $(seq 1 50); do kill -0 $SERVE_PID 2>/dev/null || break; sleep 0.1; done
+kill -0 $SERVE_PID 2>/dev/null && { kill -9 $SERVE_PID; kill $IDLE_PID; die "testcase $TESTCASE: serve did not stop on SIGTERM with a client connected"; }
+wait $SERVE_PID
+kill $IDLE_PID 2>/dev/null
+wait $IDLE_PID
+[ $RET -eq 0 ] || die "testcase $TESTCASE: an idle client blocked the worker"
+diff -q "$EXP_DIR/expected_extracted_reads2.slow5" "$OUTPUT_DIR/extracted_reads11_idle.slow5" &>/dev/null || die "testcase $TESTCASE: diff failed with an idle client connected"
+info "testcase $TESTCASE passed"
+
+TESTCASE=12
+info "------------------- slow5tools get testcase $TESTCASE -------------------"
+cp "$RAW_DIR/example2.slow5" "$OUTPUT_DIR/example2.slow5" || die "testcase $TESTCASE failed"
+$SLOW5_EXEC index --bloom "$OUTPUT_DIR/example2.slow5" || die "testcase $TESTCASE failed"
+test -f "$OUTPUT_DIR/example2.slow5.idx.bloom" || die "testcase $TESTCASE failed"
+$SLOW5_EXEC -v 4 get "$OUTPUT_DIR/example2.slow5" --skip --list "$RAW_DIR/list_with_invalid_reads.txt" --to slow5 > "$OUTPUT_DIR/extracted_reads12.slow5" 2> "$OUTPUT_DIR/bloom.log" || die "testcase $TESTCASE failed"
+# the filter must have been loaded and have rejected some of the missing reads
+grep -q "Bloom filter rejected [1-9][0-9]* missing reads, [0-9]* missing reads passed the filter (observed false positive rate [0-9.]*)" "$OUTPUT_DIR/bloom.log" || die "testcase $TESTCASE: the bloom filter did not reject any missing read"
+$SLOW5_EXEC -v 4 get "$OUTPUT_DIR/example2.slow5" --skip --no-bloom --list "$RAW_DIR/list_with_invalid_reads.txt" --to slow5 > "$OUTPUT_DIR/extracted_reads12_no_bloom.slow5" 2> "$OUTPUT_DIR/no_bloom.log" || die "testcase $TESTCASE failed"
+grep -q "Bloom filter rejected" "$OUTPUT_DIR/no_bloom.log" && die "testcase $TESTCASE: the bloom filter was used with --no-bloom"
+diff -q "$OUTPUT_DIR/extracted_reads12_no_bloom.slow5" "$OUTPUT_DIR/extracted_reads12.slow5" &>/dev/null
+if [ $? -ne 0 ]; then
+    info "${RED}ERROR: diff failed for 'slow5tools get testcase $TESTCASE'${NC}"
+    exit 1
+fi
+info "testcase $TESTCASE passed"
+
+TESTCASE=13
+info "------------------- slow5tools get testcase $TESTCASE -------------------"
+# CRLF line ends, an empty line, a duplicate and no final newline must give the same reads as list.txt
+printf 'r1\r\nr3\r\n\nr1\nr4' > "$OUTPUT_DIR/list_crlf.txt" || die "testcase $TESTCASE failed"
+$SLOW5_EXEC -v 4 get "$RAW_DIR/example2.slow5" --list "$OUTPUT_DIR/list_crlf.txt" --to slow5 > "$OUTPUT_DIR/extracted_reads13.slow5" 2> "$OUTPUT_DIR/get13.log" || die "testcase $TESTCASE failed"
+diff -q "$EXP_DIR/expected_extracted_reads3.slow5" "$OUTPUT_DIR/extracted_reads13.slow5" &>/dev/null || die "testcase $TESTCASE: diff failed for the list file"
+grep -q "Loaded 3 read ids (1 duplicates removed)" "$OUTPUT_DIR/get13.log" || die "testcase $TESTCASE: the duplicate was not removed"
+# the standard input is not a regular file, so it is read in blocks
+cat "$OUTPUT_DIR/list_crlf.txt" | $SLOW5_EXEC get "$RAW_DIR/example2.slow5" --to slow5 > "$OUTPUT_DIR/extracted_reads13_stdin.slow5" || die "testcase $TESTCASE failed"
+diff -q "$EXP_DIR/expected_extracted_reads3.slow5" "$OUTPUT_DIR/extracted_reads13_stdin.slow5" &>/dev/null || die "testcase $TESTCASE: diff failed for the standard input"
+info "testcase $TESTCASE passed"
+
+TESTCASE=14
+info "------------------- slow5tools get testcase $TESTCASE -------------------"
+# the throughput and the latency percentiles must be reported and non-zero
+check_benchmark() {
+    for FIELD in "lookups/s" "latency p50 (us)" "latency p99 (us)"; do
+        awk -F '\t' -v field="$FIELD" '$1 == field && $2 > 0 { found = 1 } END { exit !found }' "$1" || die "testcase $TESTCASE: $FIELD is missing or zero in $1"
+    done
+}
+$SLOW5_EXEC get --benchmark "$RAW_DIR/example2.slow5" r1 r5 r3 2> "$OUTPUT_DIR/benchmark_args.log" || die "testcase $TESTCASE failed"
+check_benchmark "$OUTPUT_DIR/benchmark_args.log"
+$SLOW5_EXEC get --benchmark --list "$RAW_DIR/list.txt" "$RAW_DIR/example2.slow5" 2> "$OUTPUT_DIR/benchmark_list.log" || die "testcase $TESTCASE failed"
+check_benchmark "$OUTPUT_DIR/benchmark_list.log"
+$SLOW5_EXEC get --benchmark --random 100 "$RAW_DIR/example2.slow5" < /dev/null 2> "$OUTPUT_DIR/benchmark_random.log" || die "testcase $TESTCASE failed"
+check_benchmark "$OUTPUT_DIR/benchmark_random.log"
+awk -F '\t' '$1 == "lookups" && $2 == 100 { found = 1 } END { exit !found }' "$OUTPUT_DIR/benchmark_random.log" || die "testcase $TESTCASE: --random did not look up 100 read ids"
+$SLOW5_EXEC get --benchmark --catalog "$OUTPUT_DIR/reads.s5c" r1 r5 r3 2> "$OUTPUT_DIR/benchmark_catalog.log" || die "testcase $TESTCASE failed"
+check_benchmark "$OUTPUT_DIR/benchmark_catalog.log"
+$SLOW5_EXEC get --random 100 "$RAW_DIR/example2.slow5" < /dev/null && die "testcase $TESTCASE: --random without --benchmark did not fail"
+info "testcase $TESTCASE passed"
+
+TESTCASE=15
+info "------------------- slow5tools get testcase $TESTCASE -------------------"
+# a catalogued file that is rewritten in place must be refused instead of being read at stale offsets
+cp "$RAW_DIR/example2.slow5" "$OUTPUT_DIR/catalogued.slow5" || die "testcase $TESTCASE: copying failed"
+$SLOW5_EXEC index --catalog "$OUTPUT_DIR/stale.s5c" "$OUTPUT_DIR/catalogued.slow5" || die "testcase $TESTCASE failed"
+$SLOW5_EXEC get --catalog "$OUTPUT_DIR/stale.s5c" r1 --to slow5 > /dev/null || die "testcase $TESTCASE failed"
+touch -d "2000-01-01" "$OUTPUT_DIR/catalogued.slow5" || die "testcase $TESTCASE: touch failed"
+$SLOW5_EXEC get --catalog "$OUTPUT_DIR/stale.s5c" r1 --to slow5 > /dev/null 2> "$OUTPUT_DIR/stale_mtime.log" && die "testcase $TESTCASE: a modified file was read"
+grep -q "changed since it was catalogued" "$OUTPUT_DIR/stale_mtime.log" || die "testcase $TESTCASE: the modified file was not reported"
+$SLOW5_EXEC index --catalog "$OUTPUT_DIR/stale.s5c" "$OUTPUT_DIR/catalogued.slow5" || die "testcase $TESTCASE failed"
+tail -n 1 "$RAW_DIR/example2.slow5" >> "$OUTPUT_DIR/catalogued.slow5" || die "testcase $TESTCASE: appending failed"
+touch -d "2000-01-01" "$OUTPUT_DIR/catalogued.slow5" || die "testcase $TESTCASE: touch failed"
+$SLOW5_EXEC get --catalog "$OUTPUT_DIR/stale.s5c" r1 --to slow5 > /dev/null 2> "$OUTPUT_DIR/stale_size.log" && die "testcase $TESTCASE: a resized file was read"
+grep -q "changed since it was catalogued" "$OUTPUT_DIR/stale_size.log" || die "testcase $TESTCASE: the resized file was not reported"
+info "testcase $TESTCASE passed"
+
 rm -r $OUTPUT_DIR || die "Removing $OUTPUT_DIR failed" 1>&3 2>&4
 exit 0
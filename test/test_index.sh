@@ -83,6 +83,58 @@ echo "------------------- slow5tools index testcase ${TESTCASE_NO} -------------
 $SLOW5_EXEC index $SLOW5_DIR/duplicate_read.blow5 && die "testcase ${TESTCASE_NO} failed"
 echo -e "${GREEN}testcase ${TESTCASE_NO} passed${NC}"  1>&3 2>&4
 
+echo
+TESTCASE_NO=7
+echo "------------------- slow5tools index testcase ${TESTCASE_NO} -------------------"
+$SLOW5_EXEC index --attr len_raw_signal,read_group $SLOW5_DIR/example_multi_rg_v0.2.0.blow5 || die "testcase ${TESTCASE_NO} failed"
+$SLOW5_EXEC query --filter len_raw_signal:: --filter read_group:: $SLOW5_DIR/example_multi_rg_v0.2.0.blow5 --to slow5 -o $OUTPUT_DIR/query_all.slow5 || die "testcase ${TESTCASE_NO} failed"
+$SLOW5_EXEC view $SLOW5_DIR/example_multi_rg_v0.2.0.blow5 --to slow5 -o $OUTPUT_DIR/view_all.slow5 || die "testcase ${TESTCASE_NO} failed"
+diff -q $OUTPUT_DIR/view_all.slow5 $OUTPUT_DIR/query_all.slow5 || die "ERROR: diff failed for testcase ${TESTCASE_NO}"
+[ "$($SLOW5_EXEC query --count --filter read_group:1:1 $SLOW5_DIR/example_multi_rg_v0.2.0.blow5)" = "$(grep -v '^[#@]' $OUTPUT_DIR/view_all.slow5 | awk '$2==1' | wc -l)" ] || die "ERROR: count mismatch for testcase ${TESTCASE_NO}"
+# a corrupt entry count (after the 9-byte magic, the 2-byte name length and the name) must be reported, not allocated
+SIDX=$SLOW5_DIR/example_multi_rg_v0.2.0.blow5.len_raw_signal.sidx
+printf '\377\377\377\377\377\377\377\017' | dd of=$SIDX bs=1 seek=25 conv=notrunc || die "testcase ${TESTCASE_NO}: corrupting $SIDX failed"
+$SLOW5_EXEC query --count --filter len_raw_signal:: $SLOW5_DIR/example_multi_rg_v0.2.0.blow5 2> $OUTPUT_DIR/query_corrupt.log && die "testcase ${TESTCASE_NO}: a corrupt secondary index was accepted"
+grep -q "malformed" $OUTPUT_DIR/query_corrupt.log || die "testcase ${TESTCASE_NO}: a corrupt secondary index was not reported"
+$SLOW5_EXEC index --attr len_raw_signal $SLOW5_DIR/example_multi_rg_v0.2.0.blow5 || die "testcase ${TESTCASE_NO} failed"
+test -e $SIDX.tmp && die "testcase ${TESTCASE_NO}: the temporary secondary index was left behind"
+echo -e "${GREEN}testcase ${TESTCASE_NO} passed${NC}"  1>&3 2>&4
+
+echo
+TESTCASE_NO=8
+echo "------------------- slow5tools index testcase ${TESTCASE_NO} -------------------"
+$SLOW5_EXEC index -t 4 -K 2 $SLOW5_DIR/example_multi_rg_v0.2.0.blow5 || die "testcase ${TESTCASE_NO} failed"
+diff -q $SLOW5_DIR/example_multi_rg_v0.2.0.blow5.idx.exp $SLOW5_DIR/example_multi_rg_v0.2.0.blow5.idx || die "ERROR: diff failed for testcase ${TESTCASE_NO}"
+test -e $SLOW5_DIR/example_multi_rg_v0.2.0.blow5.idx.tmp && die "ERROR: temporary index left behind in testcase ${TESTCASE_NO}"
+echo -e "${GREEN}testcase ${TESTCASE_NO} passed${NC}"  1>&3 2>&4
+
+echo
+TESTCASE_NO=9
+echo "------------------- slow5tools index testcase ${TESTCASE_NO} -------------------"
+# simulate a file that is being written: half of it, ending with a partial record, then the rest
+FILE_SIZE=$(stat -c %s $SLOW5_DIR/example_multi_rg_v0.2.0.blow5)
+head -c $((FILE_SIZE/2)) $SLOW5_DIR/example_multi_rg_v0.2.0.blow5 > $OUTPUT_DIR/growing.blow5 || die "testcase ${TESTCASE_NO} failed"
+$SLOW5_EXEC index --update $OUTPUT_DIR/growing.blow5 || die "testcase ${TESTCASE_NO} failed"
+tail -c +$((FILE_SIZE/2+1)) $SLOW5_DIR/example_multi_rg_v0.2.0.blow5 >> $OUTPUT_DIR/growing.blow5 || die "testcase ${TESTCASE_NO} failed"
+$SLOW5_EXEC index --update --follow $OUTPUT_DIR/growing.blow5 || die "testcase ${TESTCASE_NO} failed"
+diff -q $SLOW5_DIR/example_multi_rg_v0.2.0.blow5.idx.exp $OUTPUT_DIR/growing.blow5.idx || die "ERROR: diff failed for testcase ${TESTCASE_NO}"
+echo -e "${GREEN}testcase ${TESTCASE_NO} passed${NC}"  1>&3 2>&4
+
+echo
+TESTCASE_NO=10
+echo "------------------- slow5tools index testcase ${TESTCASE_NO} -------------------"
+# many zlib records decompressed by several threads at once must give the same index as a single thread
+INPUT=$REL_PATH/data/raw/split/single_group_slow5s/11reads.slow5
+{ grep '^[#@]' $INPUT; for k in $(seq 1 200); do grep -v '^[#@]' $INPUT | awk -v k=$k 'BEGIN{OFS=FS="\t"} {$1=$1"_"k; print}'; done; } > $OUTPUT_DIR/many.slow5 || die "testcase ${TESTCASE_NO} failed"
+$SLOW5_EXEC_WITHOUT_VALGRIND view $OUTPUT_DIR/many.slow5 -c zlib -s svb-zd -o $OUTPUT_DIR/many.blow5 || die "testcase ${TESTCASE_NO} failed"
+$SLOW5_EXEC index -t 1 $OUTPUT_DIR/many.blow5 || die "testcase ${TESTCASE_NO} failed"
+mv $OUTPUT_DIR/many.blow5.idx $OUTPUT_DIR/many.blow5.idx.single || die "testcase ${TESTCASE_NO} failed"
+for i in 1 2 3; do
+    $SLOW5_EXEC index -t 8 -K 64 $OUTPUT_DIR/many.blow5 || die "testcase ${TESTCASE_NO} failed"
+    cmp $OUTPUT_DIR/many.blow5.idx.single $OUTPUT_DIR/many.blow5.idx || die "ERROR: multi-threaded index differs for testcase ${TESTCASE_NO}"
+    rm $OUTPUT_DIR/many.blow5.idx
+done
+echo -e "${GREEN}testcase ${TESTCASE_NO} passed${NC}"  1>&3 2>&4
 
 rm -r $OUTPUT_DIR || die "Removing $OUTPUT_DIR failed"
 
@@ -322,6 +322,122 @@ $SLOW5_EXEC merge $INPUT_FILES -o $OUTPUT_DIR/diff_rg_diff_aux_field.slow5 2> $O
 diff -q $REL_PATH/data/exp/merge/diff_rg_diff_aux_field.slow5  $OUTPUT_DIR/diff_rg_diff_aux_field.slow5 || die "testcase $TESTCASE: diff for $TESTNAME"
 echo -e "${GREEN}testcase $TESTCASE passed${NC}" 1>&3 2>&4
 
+TESTCASE=5.1
+TESTNAME="number of readers does not change the output"
+info "-------------------testcase $TESTCASE: $TESTNAME-------------------"
+INPUT_FILES="$RAW_DIR/rg0.slow5 $RAW_DIR/rg1.slow5 $RAW_DIR/rg2.slow5 $RAW_DIR/rg3.slow5"
+OUTPUT_FILE=merged_different_rg.slow5
+$SLOW5_EXEC merge $INPUT_FILES -o $OUTPUT_DIR/$OUTPUT_FILE --readers 1 -K 3 || die "testcase $TESTCASE: $TESTNAME failed"
+diff -q $REL_PATH/data/exp/merge/$OUTPUT_FILE $OUTPUT_DIR/$OUTPUT_FILE || die "testcase $TESTCASE: diff for $TESTNAME failed"
+$SLOW5_EXEC merge $INPUT_FILES -o $OUTPUT_DIR/$OUTPUT_FILE --readers 3 -K 1 || die "testcase $TESTCASE: $TESTNAME failed"
+diff -q $REL_PATH/data/exp/merge/$OUTPUT_FILE $OUTPUT_DIR/$OUTPUT_FILE || die "testcase $TESTCASE: diff for $TESTNAME failed"
+$SLOW5_EXEC merge $INPUT_FILES -o $OUTPUT_DIR/$OUTPUT_FILE --readers 0 && die "testcase $TESTCASE: $TESTNAME failed"
+echo -e "${GREEN}testcase $TESTCASE passed${NC}" 1>&3 2>&4
+
+TESTCASE=5.2
+TESTNAME="sort by read id in memory and through sorted runs"
+info "-------------------testcase $TESTCASE: $TESTNAME-------------------"
+INPUT_FILES="$RAW_DIR/rg0.slow5 $RAW_DIR/rg1.slow5 $RAW_DIR/rg2.slow5 $RAW_DIR/rg3.slow5"
+$SLOW5_EXEC merge $INPUT_FILES -o $OUTPUT_DIR/sorted_mem.slow5 --sort-by read_id -K 3 || die "testcase $TESTCASE: $TESTNAME failed"
+grep -v '^[#@]' $OUTPUT_DIR/sorted_mem.slow5 | cut -f1 | LC_ALL=C sort -c || die "testcase $TESTCASE: $TESTNAME output is not sorted"
+$SLOW5_EXEC merge $INPUT_FILES -o $OUTPUT_DIR/sorted_runs.slow5 --sort-by read_id --sort-mem 1K -K 3 || die "testcase $TESTCASE: $TESTNAME failed"
+diff -q $OUTPUT_DIR/sorted_mem.slow5 $OUTPUT_DIR/sorted_runs.slow5 || die "testcase $TESTCASE: diff for $TESTNAME failed"
+$SLOW5_EXEC merge $INPUT_FILES -o $OUTPUT_DIR/sorted_runs.slow5 --sort-by name && die "testcase $TESTCASE: $TESTNAME failed"
+# a run per record: more runs than are merged at once, so they are folded while spilling
+MANY_FILES=""
+for i in 1 2 3 4 5 6 7 8; do
+    mkdir -p $OUTPUT_DIR/sort_copies/$i || die "testcase $TESTCASE: creating $OUTPUT_DIR/sort_copies/$i failed"
+    cp $INPUT_FILES $OUTPUT_DIR/sort_copies/$i/ || die "testcase $TESTCASE: copying the inputs failed"
+    MANY_FILES="$MANY_FILES $OUTPUT_DIR/sort_copies/$i"
+done
+$SLOW5_EXEC merge $MANY_FILES -o $OUTPUT_DIR/sorted_many_mem.slow5 --sort-by read_id || die "testcase $TESTCASE: $TESTNAME failed"
+$SLOW5_EXEC merge $MANY_FILES -o $OUTPUT_DIR/sorted_many_runs.slow5 --sort-by read_id --sort-mem 1K -K 3 || die "testcase $TESTCASE: $TESTNAME failed"
+diff -q $OUTPUT_DIR/sorted_many_mem.slow5 $OUTPUT_DIR/sorted_many_runs.slow5 || die "testcase $TESTCASE: diff for $TESTNAME with folded runs failed"
+echo -e "${GREEN}testcase $TESTCASE passed${NC}" 1>&3 2>&4
+
+TESTCASE=5.3
+TESTNAME="duplicate read ids are dropped or reported"
+info "-------------------testcase $TESTCASE: $TESTNAME-------------------"
+$SLOW5_EXEC merge $RAW_DIR/rg0.slow5 -o $OUTPUT_DIR/single.slow5 || die "testcase $TESTCASE: $TESTNAME failed"
+$SLOW5_EXEC merge $RAW_DIR/rg0.slow5 $RAW_DIR/rg0.slow5 -o $OUTPUT_DIR/dedup.slow5 --dedup -K 1 || die "testcase $TESTCASE: $TESTNAME failed"
+diff -q $OUTPUT_DIR/single.slow5 $OUTPUT_DIR/dedup.slow5 || die "testcase $TESTCASE: diff for $TESTNAME failed"
+$SLOW5_EXEC merge $RAW_DIR/rg0.slow5 $RAW_DIR/rg0.slow5 -o $OUTPUT_DIR/dedup.slow5 --dedup=report 2> $OUTPUT_DIR/err.log || die "testcase $TESTCASE: $TESTNAME failed"
+grep -q "Duplicate read id" $OUTPUT_DIR/err.log || die "testcase $TESTCASE: $TESTNAME duplicates not reported"
+NUM_SINGLE=$(grep -v -c '^[#@]' $OUTPUT_DIR/single.slow5)
+NUM_REPORT=$(grep -v -c '^[#@]' $OUTPUT_DIR/dedup.slow5)
+[ "$NUM_REPORT" -eq $((NUM_SINGLE * 2)) ] || die "testcase $TESTCASE: $TESTNAME report mode dropped records"
+awk 'BEGIN{FS=OFS="\t"} /^[#@]/{print; next} {$1=toupper($1); print}' $RAW_DIR/rg0.slow5 > $OUTPUT_DIR/rg0_upper.slow5 || die "testcase $TESTCASE: $TESTNAME creating uppercase read ids failed"
+$SLOW5_EXEC merge $RAW_DIR/rg0.slow5 $OUTPUT_DIR/rg0_upper.slow5 -o $OUTPUT_DIR/dedup.slow5 --dedup 2> $OUTPUT_DIR/err.log || die "testcase $TESTCASE: $TESTNAME failed"
+NUM_CASE=$(grep -v -c '^[#@]' $OUTPUT_DIR/dedup.slow5)
+[ "$NUM_CASE" -eq $((NUM_SINGLE * 2)) ] || die "testcase $TESTCASE: $TESTNAME read ids differing in case were dropped"
+echo -e "${GREEN}testcase $TESTCASE passed${NC}" 1>&3 2>&4
+
+TESTCASE=5.4
+TESTNAME="records copied in parallel to their output offsets"
+info "-------------------testcase $TESTCASE: $TESTNAME-------------------"
+$SLOW5_EXEC merge $RAW_DIR/rg0.slow5 $RAW_DIR/rg0.slow5 -o $OUTPUT_DIR/pwrite.slow5 --pwrite -t 2 2> $OUTPUT_DIR/err.log || die "testcase $TESTCASE: $TESTNAME failed"
+grep -q "Falling back" $OUTPUT_DIR/err.log && die "testcase $TESTCASE: $TESTNAME records were converted"
+$SLOW5_EXEC merge $OUTPUT_DIR/pwrite.slow5 -o $OUTPUT_DIR/pwrite_converted.slow5 || die "testcase $TESTCASE: $TESTNAME failed"
+$SLOW5_EXEC merge $RAW_DIR/rg0.slow5 $RAW_DIR/rg0.slow5 -o $OUTPUT_DIR/converted.slow5 || die "testcase $TESTCASE: $TESTNAME failed"
+diff -q $OUTPUT_DIR/converted.slow5 $OUTPUT_DIR/pwrite_converted.slow5 || die "testcase $TESTCASE: diff for $TESTNAME failed"
+$SLOW5_EXEC merge $RAW_DIR/rg0.slow5 $RAW_DIR/rg1.slow5 -o $OUTPUT_DIR/pwrite.slow5 --pwrite 2> $OUTPUT_DIR/err.log || die "testcase $TESTCASE: $TESTNAME failed"
+grep -q "Falling back" $OUTPUT_DIR/err.log || die "testcase $TESTCASE: $TESTNAME renumbered read groups were copied"
+echo -e "${GREEN}testcase $TESTCASE passed${NC}" 1>&3 2>&4
+
+TESTCASE=5.5
+TESTNAME="merge through intermediate levels with a small fan-in"
+info "-------------------testcase $TESTCASE: $TESTNAME-------------------"
+INPUT_FILES="$RAW_DIR/rg0.slow5 $RAW_DIR/rg1.slow5 $RAW_DIR/rg2.slow5 $RAW_DIR/rg3.slow5"
+OUTPUT_FILE=merged_different_rg.slow5
+$SLOW5_EXEC merge $INPUT_FILES -o $OUTPUT_DIR/$OUTPUT_FILE --fan-in 2 -p 2 || die "testcase $TESTCASE: $TESTNAME failed"
+diff -q $REL_PATH/data/exp/merge/$OUTPUT_FILE $OUTPUT_DIR/$OUTPUT_FILE || die "testcase $TESTCASE: diff for $TESTNAME failed"
+[ -e $OUTPUT_DIR/$OUTPUT_FILE.merge_tree ] && die "testcase $TESTCASE: $TESTNAME intermediate files were not removed"
+$SLOW5_EXEC merge $INPUT_FILES -o $OUTPUT_DIR/$OUTPUT_FILE --fan-in 1 && die "testcase $TESTCASE: $TESTNAME failed"
+# eight inputs with a fan-in of 2 merge through level0 (4 groups) and level1 (2 groups)
+mkdir -p $OUTPUT_DIR/fan_in_copies || die "testcase $TESTCASE: creating $OUTPUT_DIR/fan_in_copies failed"
+cp $INPUT_FILES $OUTPUT_DIR/fan_in_copies/ || die "testcase $TESTCASE: copying the inputs failed"
+MANY_FILES="$INPUT_FILES $OUTPUT_DIR/fan_in_copies/rg0.slow5 $OUTPUT_DIR/fan_in_copies/rg1.slow5 $OUTPUT_DIR/fan_in_copies/rg2.slow5 $OUTPUT_DIR/fan_in_copies/rg3.slow5"
+$SLOW5_EXEC merge $MANY_FILES -o $OUTPUT_DIR/fan_in_fresh.slow5 --fan-in 2 || die "testcase $TESTCASE: $TESTNAME failed"
+# the output cannot be opened as it is a directory, so the merge fails after the levels are complete and keeps them
+mkdir $OUTPUT_DIR/fan_in_resumed.slow5 || die "testcase $TESTCASE: creating $OUTPUT_DIR/fan_in_resumed.slow5 failed"
+$SLOW5_EXEC merge $MANY_FILES -o $OUTPUT_DIR/fan_in_resumed.slow5 --fan-in 2 && die "testcase $TESTCASE: $TESTNAME writing to a directory did not fail"
+for g in 0 1; do
+    [ -f $OUTPUT_DIR/fan_in_resumed.slow5.merge_tree/level1/$g.blow5 ] || die "testcase $TESTCASE: $TESTNAME group $g of level1 was not kept"
+done
+rmdir $OUTPUT_DIR/fan_in_resumed.slow5 || die "testcase $TESTCASE: removing $OUTPUT_DIR/fan_in_resumed.slow5 failed"
+$SLOW5_EXEC -v 4 merge $MANY_FILES -o $OUTPUT_DIR/fan_in_resumed.slow5 --fan-in 2 2> $OUTPUT_DIR/err.log || die "testcase $TESTCASE: $TESTNAME resuming failed"
+grep -q "Level 0: merging 8 files in 4 groups (4 already merged)" $OUTPUT_DIR/err.log || die "testcase $TESTCASE: $TESTNAME the groups of level0 were merged again"
+grep -q "Level 1: merging 4 files in 2 groups (2 already merged)" $OUTPUT_DIR/err.log || die "testcase $TESTCASE: $TESTNAME the groups of level1 were merged again"
+diff -q $OUTPUT_DIR/fan_in_fresh.slow5 $OUTPUT_DIR/fan_in_resumed.slow5 || die "testcase $TESTCASE: diff for $TESTNAME after resuming failed"
+[ -e $OUTPUT_DIR/fan_in_resumed.slow5.merge_tree ] && die "testcase $TESTCASE: $TESTNAME intermediate files were not removed after resuming"
+# intermediate files of different inputs must not be resumed
+mkdir $OUTPUT_DIR/fan_in_changed.slow5 || die "testcase $TESTCASE: creating $OUTPUT_DIR/fan_in_changed.slow5 failed"
+$SLOW5_EXEC merge $MANY_FILES -o $OUTPUT_DIR/fan_in_changed.slow5 --fan-in 2 && die "testcase $TESTCASE: $TESTNAME writing to a directory did not fail"
+rmdir $OUTPUT_DIR/fan_in_changed.slow5 || die "testcase $TESTCASE: removing $OUTPUT_DIR/fan_in_changed.slow5 failed"
+$SLOW5_EXEC merge $MANY_FILES $RAW_DIR/rg0_1.slow5 -o $OUTPUT_DIR/fan_in_changed.slow5 --fan-in 2 2> $OUTPUT_DIR/err.log && die "testcase $TESTCASE: $TESTNAME intermediate files of different inputs were resumed"
+grep -q "holds intermediate files of a merge of different input files" $OUTPUT_DIR/err.log || die "testcase $TESTCASE: $TESTNAME resuming different inputs was not refused"
+echo -e "${GREEN}testcase $TESTCASE passed${NC}" 1>&3 2>&4
+
+TESTCASE=5.6
+TESTNAME="--index writes the same index as slow5tools index"
+info "-------------------testcase $TESTCASE: $TESTNAME-------------------"
+# $1: output file written with --index
+check_index() {
+    mv $1.idx $1.idx.inline || die "testcase $TESTCASE: $TESTNAME moving the index of $1 failed"
+    $SLOW5_EXEC index $1 || die "testcase $TESTCASE: $TESTNAME slow5tools index failed"
+    cmp $1.idx $1.idx.inline || die "testcase $TESTCASE: $TESTNAME index of $1 differs"
+}
+INPUT_FILES="$RAW_DIR/rg0.slow5 $RAW_DIR/rg1.slow5 $RAW_DIR/rg2.slow5 $RAW_DIR/rg3.slow5"
+$SLOW5_EXEC merge $INPUT_FILES -o $OUTPUT_DIR/indexed.blow5 --index -K 3 || die "testcase $TESTCASE: $TESTNAME failed"
+check_index $OUTPUT_DIR/indexed.blow5
+$SLOW5_EXEC merge $INPUT_FILES -o $OUTPUT_DIR/indexed.slow5 --index -K 3 || die "testcase $TESTCASE: $TESTNAME failed"
+check_index $OUTPUT_DIR/indexed.slow5
+$SLOW5_EXEC merge $INPUT_FILES -o $OUTPUT_DIR/indexed_sorted.blow5 --index --sort-by read_id --sort-mem 1K -K 3 || die "testcase $TESTCASE: $TESTNAME failed"
+check_index $OUTPUT_DIR/indexed_sorted.blow5
+$SLOW5_EXEC merge $RAW_DIR/rg0.slow5 $RAW_DIR/rg0_1.slow5 -o $OUTPUT_DIR/indexed_pwrite.blow5 --index --pwrite -t 2 || die "testcase $TESTCASE: $TESTNAME failed"
+check_index $OUTPUT_DIR/indexed_pwrite.blow5
+echo -e "${GREEN}testcase $TESTCASE passed${NC}" 1>&3 2>&4
+
 rm -r "$OUTPUT_DIR" || die "could not delete $OUTPUT_DIR"
 info "done"
 exit 0
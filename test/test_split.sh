@@ -114,7 +114,11 @@ check "Testcase:$TESTCASE read splitting" $REL_PATH/data/exp/split/expected_spli
 
 TESTCASE=7
 info "-------------------testcase ${TESTCASE}: split to files single file-------------------"
-$SLOW5_EXEC split -f 3 -l false $REL_PATH/data/raw/split/single_group_slow5s/11reads.slow5 -d $OUTPUT_DIR/split_files_slow5s --to slow5 || die "testcase ${TESTCASE}: split to files failed"
+# with an index the records are split evenly by count
+mkdir -p $OUTPUT_DIR/indexed || die "testcase ${TESTCASE}: creating $OUTPUT_DIR/indexed failed"
+cp $REL_PATH/data/raw/split/single_group_slow5s/11reads.slow5 $OUTPUT_DIR/indexed/ || die "testcase ${TESTCASE}: copying the input failed"
+$SLOW5_EXEC index $OUTPUT_DIR/indexed/11reads.slow5 || die "testcase ${TESTCASE}: indexing the input failed"
+$SLOW5_EXEC split -f 3 -l false $OUTPUT_DIR/indexed/11reads.slow5 -d $OUTPUT_DIR/split_files_slow5s --to slow5 || die "testcase ${TESTCASE}: split to files failed"
 info "comparing files split: output and expected"
 check "Testcase:$TESTCASE files splitting" $REL_PATH/data/exp/split/expected_split_files_slow5s $OUTPUT_DIR/split_files_slow5s
 
@@ -172,6 +176,79 @@ info "-------------------testcase ${TESTCASE}: lossy spliting groups------------
 $SLOW5_EXEC split -g -l true $REL_PATH/data/raw/split/multi_group_slow5s/rg.slow5 -d $OUTPUT_DIR/split_groups_blow5s_lossless --to blow5 || die "testcase ${TESTCASE}: lossy splitting groups failed"
 slow5tools_quickcheck $OUTPUT_DIR/split_groups_blow5s_lossless
 
+TESTCASE=17
+info "-------------------testcase ${TESTCASE}: split to files by size without an index-------------------"
+$SLOW5_EXEC split -f 3 -l false $REL_PATH/data/raw/split/single_group_slow5s/11reads.slow5 -d $OUTPUT_DIR/split_files_by_size --to slow5 || die "testcase ${TESTCASE}: split to files failed"
+[ "$(ls $OUTPUT_DIR/split_files_by_size | wc -l)" -eq 3 ] || die "testcase ${TESTCASE}: split to files did not create 3 files"
+[ "$(cat $OUTPUT_DIR/split_files_by_size/*.slow5 | grep -v -c '^[#@]')" -eq 11 ] || die "testcase ${TESTCASE}: split to files lost records"
+slow5tools_quickcheck $OUTPUT_DIR/split_files_by_size
+
+TESTCASE=18
+info "-------------------testcase ${TESTCASE}: split by reads with a single writer-------------------"
+$SLOW5_EXEC split -r 2 -l true --writers 1 $REL_PATH/data/raw/split/single_group_slow5s/11reads.slow5 -d $OUTPUT_DIR/split_reads_one_writer --to blow5 || die "testcase ${TESTCASE}: split by reads failed"
+for file in $OUTPUT_DIR/split_reads_blow5s_lossless/*.blow5; do
+    cmp $file $OUTPUT_DIR/split_reads_one_writer/$(basename $file) || die "testcase ${TESTCASE}: $(basename $file) differs from the one written by several writers"
+done
+
+TESTCASE=19
+info "-------------------testcase ${TESTCASE}: split by reads copying the records using the index-------------------"
+$SLOW5_EXEC split -r 3 $OUTPUT_DIR/indexed/11reads.slow5 -d $OUTPUT_DIR/split_reads_sliced --to slow5 || die "testcase ${TESTCASE}: split by reads failed"
+$SLOW5_EXEC split -r 3 $REL_PATH/data/raw/split/single_group_slow5s/11reads.slow5 -d $OUTPUT_DIR/split_reads_streamed --to slow5 || die "testcase ${TESTCASE}: split by reads failed"
+diff -r $OUTPUT_DIR/split_reads_sliced $OUTPUT_DIR/split_reads_streamed || die "testcase ${TESTCASE}: the files split using the index differ"
+
+TESTCASE=20
+info "-------------------testcase ${TESTCASE}: split by bytes-------------------"
+$SLOW5_EXEC split --bytes 50K $REL_PATH/data/raw/split/single_group_slow5s/11reads.slow5 -d $OUTPUT_DIR/split_bytes --to slow5 || die "testcase ${TESTCASE}: split by bytes failed"
+[ "$(cat $OUTPUT_DIR/split_bytes/*.slow5 | grep -v -c '^[#@]')" -eq 11 ] || die "testcase ${TESTCASE}: split by bytes lost records"
+slow5tools_quickcheck $OUTPUT_DIR/split_bytes
+$SLOW5_EXEC split -f 3 --balance bytes -l false $OUTPUT_DIR/indexed/11reads.slow5 -d $OUTPUT_DIR/split_files_balanced --to slow5 || die "testcase ${TESTCASE}: split to files balanced by bytes failed"
+diff -r $OUTPUT_DIR/split_files_balanced $OUTPUT_DIR/split_files_by_size || die "testcase ${TESTCASE}: split to files balanced by bytes differs from splitting without an index"
+$SLOW5_EXEC split -f 3 --balance records -l false $REL_PATH/data/raw/split/single_group_slow5s/11reads.slow5 -d $OUTPUT_DIR/split_files_counted --to slow5 || die "testcase ${TESTCASE}: split to files balanced by records failed"
+diff -r $OUTPUT_DIR/split_files_counted $OUTPUT_DIR/split_files_slow5s || die "testcase ${TESTCASE}: split to files balanced by records without an index differs from splitting with an index"
+
+TESTCASE=21
+info "-------------------testcase ${TESTCASE}: split by a key-------------------"
+$SLOW5_EXEC split --by hash:4 $REL_PATH/data/raw/split/single_group_slow5s/11reads.slow5 -d $OUTPUT_DIR/split_by_hash --to slow5 || die "testcase ${TESTCASE}: split by hash failed"
+[ "$(cat $OUTPUT_DIR/split_by_hash/*.slow5 | grep -v -c '^[#@]')" -eq 11 ] || die "testcase ${TESTCASE}: split by hash lost records"
+$SLOW5_EXEC split --by hash:4 -t 1 --writers 1 $REL_PATH/data/raw/split/single_group_slow5s/11reads.slow5 -d $OUTPUT_DIR/split_by_hash_single --to slow5 || die "testcase ${TESTCASE}: split by hash failed"
+diff -r $OUTPUT_DIR/split_by_hash $OUTPUT_DIR/split_by_hash_single || die "testcase ${TESTCASE}: split by hash is not stable"
+$SLOW5_EXEC split --by channel $REL_PATH/data/raw/split/single_group_slow5s/11reads.slow5 -d $OUTPUT_DIR/split_by_channel --to slow5 || die "testcase ${TESTCASE}: split by channel failed"
+NUM_CHANNELS=$(grep -v '^[#@]' $REL_PATH/data/raw/split/single_group_slow5s/11reads.slow5 | cut -f 9 | sort -u | wc -l)
+[ "$(ls $OUTPUT_DIR/split_by_channel | wc -l)" -eq "$NUM_CHANNELS" ] || die "testcase ${TESTCASE}: split by channel did not create a file per channel"
+$SLOW5_EXEC split --by start_time:1h $REL_PATH/data/raw/split/single_group_slow5s/11reads.slow5 -d $OUTPUT_DIR/split_by_start_time --to slow5 || die "testcase ${TESTCASE}: split by start_time failed"
+slow5tools_quickcheck $OUTPUT_DIR/split_by_start_time
+(ulimit -n 128 && $SLOW5_EXEC split --by hash:1000 $REL_PATH/data/raw/split/single_group_slow5s/11reads.slow5 -d $OUTPUT_DIR/split_by_hash_many --to slow5) && die "testcase ${TESTCASE}: split by hash above the limit of open files did not fail"
+
+TESTCASE=22
+info "-------------------testcase ${TESTCASE}: split by reads with an index that misses the last records-------------------"
+# the index is of the first records only, but not older than the input as when records are appended in the same second
+mkdir -p $OUTPUT_DIR/appended || die "testcase ${TESTCASE}: creating $OUTPUT_DIR/appended failed"
+INPUT=$REL_PATH/data/raw/split/single_group_slow5s/11reads.slow5
+(grep '^[#@]' $INPUT; grep -v '^[#@]' $INPUT | head -n 5) > $OUTPUT_DIR/appended/11reads.slow5 || die "testcase ${TESTCASE}: writing the first records failed"
+$SLOW5_EXEC index $OUTPUT_DIR/appended/11reads.slow5 || die "testcase ${TESTCASE}: indexing the first records failed"
+cp $INPUT $OUTPUT_DIR/appended/11reads.slow5 || die "testcase ${TESTCASE}: copying the input failed"
+touch -r $OUTPUT_DIR/appended/11reads.slow5.idx $OUTPUT_DIR/appended/11reads.slow5 || die "testcase ${TESTCASE}: touch failed"
+$SLOW5_EXEC split -r 3 $OUTPUT_DIR/appended/11reads.slow5 -d $OUTPUT_DIR/split_reads_appended --to slow5 || die "testcase ${TESTCASE}: split by reads failed"
+diff -r $OUTPUT_DIR/split_reads_appended $OUTPUT_DIR/split_reads_streamed || die "testcase ${TESTCASE}: records after the last index entry were lost"
+
+TESTCASE=23
+info "-------------------testcase ${TESTCASE}: --index writes the same indexes as slow5tools index-------------------"
+# $1: directory of files written with --index
+check_index() {
+    for file in $1/*.[bs]low5; do
+        mv $file.idx $file.idx.inline || die "testcase ${TESTCASE}: moving the index of $file failed"
+        $SLOW5_EXEC index $file || die "testcase ${TESTCASE}: slow5tools index failed"
+        cmp $file.idx $file.idx.inline || die "testcase ${TESTCASE}: index of $file differs"
+    done
+}
+$SLOW5_EXEC split -r 3 --index $REL_PATH/data/raw/split/single_group_slow5s/11reads.slow5 -d $OUTPUT_DIR/split_reads_streamed_indexed --to blow5 || die "testcase ${TESTCASE}: split by reads failed"
+check_index $OUTPUT_DIR/split_reads_streamed_indexed
+$SLOW5_EXEC -v 4 split -r 3 --index $OUTPUT_DIR/indexed/11reads.slow5 -d $OUTPUT_DIR/split_reads_sliced_indexed --to slow5 2> $OUTPUT_DIR/sliced_indexed.log || die "testcase ${TESTCASE}: split by reads failed"
+grep -q "using its index" $OUTPUT_DIR/sliced_indexed.log || die "testcase ${TESTCASE}: the records were not copied using the index"
+check_index $OUTPUT_DIR/split_reads_sliced_indexed
+$SLOW5_EXEC split --by hash:4 --index $REL_PATH/data/raw/split/single_group_slow5s/11reads.slow5 -d $OUTPUT_DIR/split_by_hash_indexed --to blow5 || die "testcase ${TESTCASE}: split by hash failed"
+check_index $OUTPUT_DIR/split_by_hash_indexed
+
 rm -r $OUTPUT_DIR || die "Removing $OUTPUT_DIR failed"
 
 exit 0
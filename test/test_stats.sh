@@ -29,7 +29,16 @@ REL_PATH="$(dirname $0)/"
 RAW_DIR=test/data/raw/stats
 EXP_DIR=test/data/exp/stats
 OUTPUT_DIR=test/data/out/stats
-test -d "$OUTPUT_DIR" && rm -r "$OUTPUT_DIR"
+test -d "$OUTPUT_DIR" && TESTCASE=9
+info "testcase$TESTCASE: an index of the same second that does not cover all the records is ignored"
+cp $RAW_DIR/zlib_svb-zd_multi_rg_v1.0.0.blow5 $OUTPUT_DIR/other.blow5 || die "testcase$TESTCASE: cp failed"
+$SLOW5TOOLS_WITHOUT_VALGRIND index $OUTPUT_DIR/other.blow5 || die "testcase$TESTCASE: index failed"
+cp $OUTPUT_DIR/other.blow5.idx $OUTPUT_DIR/indexed.blow5.idx || die "testcase$TESTCASE: cp failed"
+touch -r $OUTPUT_DIR/indexed.blow5 $OUTPUT_DIR/indexed.blow5.idx || die "testcase$TESTCASE: touch failed"
+$SLOW5TOOLS stats $OUTPUT_DIR/indexed.blow5 > $OUTPUT_DIR/output.log || die "testcase$TESTCASE: stats failed"
+diff <(tail -n +2 $OUTPUT_DIR/output.log) <(tail -n +2 "$EXP_DIR/exp_1_lossy.stdout") > /dev/null || die "testcase$TESTCASE: diff failed"
+
+rm -r "$OUTPUT_DIR"
 mkdir "$OUTPUT_DIR" || die "Failed creating $OUTPUT_DIR"
 
 SLOW5TOOLS_WITHOUT_VALGRIND=$REL_PATH/../slow5tools
@@ -71,6 +80,13 @@ TESTCASE=7
 info "testcase$TESTCASE"
 $SLOW5TOOLS stats $RAW_DIR/zlib_svb-zd_multi_rg_v1.1.0.blow5> $OUTPUT_DIR/output.log && die "testcase$TESTCASE: stats failed"
 
+TESTCASE=8
+info "testcase$TESTCASE: number of records taken from the index"
+cp $RAW_DIR/exp_1_lossy.blow5 $OUTPUT_DIR/indexed.blow5 || die "testcase$TESTCASE: cp failed"
+$SLOW5TOOLS_WITHOUT_VALGRIND index $OUTPUT_DIR/indexed.blow5 || die "testcase$TESTCASE: index failed"
+$SLOW5TOOLS stats $OUTPUT_DIR/indexed.blow5 > $OUTPUT_DIR/output.log || die "testcase$TESTCASE: stats failed"
+diff <(tail -n +2 $OUTPUT_DIR/output.log) <(tail -n +2 "$EXP_DIR/exp_1_lossy.stdout") > /dev/null || die "testcase$TESTCASE: diff failed"
+
 rm -r "$OUTPUT_DIR" || die "could not delete $OUTPUT_DIR"
 info "all $TESTCASE testcases passed"
 exit 0
@@ -180,8 +180,20 @@ do
     fi
 done
 
+# --index must write the same index as slow5tools index
+ex "$S5T" view "$EXP/one_fast5/exp_1_lossless_v0.2.0.slow5" --to blow5 --index -o "$OUT/one_fast5/out_1_index.blow5"
+ex mv "$OUT/one_fast5/out_1_index.blow5.idx" "$OUT/one_fast5/out_1_index.blow5.idx.inline"
+ex "$S5T" index "$OUT/one_fast5/out_1_index.blow5"
+my_diff "$OUT/one_fast5/out_1_index.blow5.idx" "$OUT/one_fast5/out_1_index.blow5.idx.inline" -q
+ex "$S5T" view "$EXP/one_fast5/exp_1_lossless_v0.2.0.blow5" --to slow5 --index -o "$OUT/one_fast5/out_1_index.slow5"
+ex mv "$OUT/one_fast5/out_1_index.slow5.idx" "$OUT/one_fast5/out_1_index.slow5.idx.inline"
+ex "$S5T" index "$OUT/one_fast5/out_1_index.slow5"
+my_diff "$OUT/one_fast5/out_1_index.slow5.idx" "$OUT/one_fast5/out_1_index.slow5.idx.inline" -q
+
 # the following should exit with error
 
+#--index without an output file
+ex_fail "$S5T" view "$EXP/one_fast5/exp_1_lossless.slow5" --to blow5 --index
 #conflict in --to format and -o format
 ex_fail "$S5T" view "$EXP/one_fast5/exp_1_lossless.slow5" --to slow5 -o $OUT/one_fast5/fail.blow5
 #if the requested compression does not exist, must exit with error